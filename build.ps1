@@ -51,7 +51,7 @@ if ($Embedded) {
 }
 
 Write-Host ">>> Compilation du SERVEUR..." -ForegroundColor Yellow
-$serverResult = & gcc -std=c99 server/server_main.c -o bin/blockblast_server.exe -lws2_32 2>&1
+$serverResult = & gcc -std=c99 server/server_main.c common/pieces.c common/rules.c common/deal.c common/scoring.c common/solver.c common/thread_pool.c common/bot.c -o bin/blockblast_server.exe -lws2_32 2>&1
 
 if ($LASTEXITCODE -eq 0) {
     Write-Host "[OK] Serveur compile avec succes !" -ForegroundColor Green
@@ -63,6 +63,32 @@ if ($LASTEXITCODE -eq 0) {
 
 Write-Host ""
 
+Write-Host ">>> Compilation du BENCHMARK moteur..." -ForegroundColor Yellow
+$benchResult = & gcc -std=c99 -O2 tools/engine_bench.c client/game.c common/pieces.c common/rules.c common/deal.c common/scoring.c common/solver.c common/thread_pool.c -o bin/blockblast_bench.exe -lm 2>&1
+
+if ($LASTEXITCODE -eq 0) {
+    Write-Host "[OK] Benchmark compile avec succes !" -ForegroundColor Green
+} else {
+    Write-Host "[ERREUR] Echec de la compilation du benchmark :" -ForegroundColor Red
+    Write-Host $benchResult
+    exit 1
+}
+
+Write-Host ""
+
+Write-Host ">>> Compilation du SIMULATEUR d'auto-parties..." -ForegroundColor Yellow
+$simResult = & gcc -std=c99 -O2 tools/selfplay_sim.c client/game.c common/pieces.c common/rules.c common/deal.c common/scoring.c common/solver.c common/thread_pool.c common/bot.c -o bin/blockblast_sim.exe -lm 2>&1
+
+if ($LASTEXITCODE -eq 0) {
+    Write-Host "[OK] Simulateur compile avec succes !" -ForegroundColor Green
+} else {
+    Write-Host "[ERREUR] Echec de la compilation du simulateur :" -ForegroundColor Red
+    Write-Host $simResult
+    exit 1
+}
+
+Write-Host ""
+
 Write-Host ">>> Compilation du CLIENT..." -ForegroundColor Yellow
 
 $clientSources = @(
@@ -71,11 +97,21 @@ $clientSources = @(
     "client/save_system.c"
     "client/audio.c"
     "client/graphics.c"
+    "client/raster.c"
     "client/ui_components.c"
+    "client/widgets.c"
     "client/screens.c"
     "client/input_handlers.c"
     "client/game.c"
     "client/net_client.c"
+    "client/profiler.c"
+    "common/pieces.c"
+    "common/rules.c"
+    "common/deal.c"
+    "common/scoring.c"
+    "common/solver.c"
+    "common/thread_pool.c"
+    "common/bot.c"
 )
 
 if ($Embedded) {
@@ -127,6 +163,8 @@ Write-Host ""
 Write-Host "Executables crees dans le dossier bin/ :"
 Write-Host "  - blockblast_server.exe"
 Write-Host "  - blockblast.exe"
+Write-Host "  - blockblast_bench.exe"
+Write-Host "  - blockblast_sim.exe"
 Write-Host ""
 
 if ($Embedded) {
@@ -39,6 +39,7 @@ if [[ "$OSTYPE" == "msys" ]] || [[ "$OSTYPE" == "mingw"* ]] || [[ "$OSTYPE" == "
     OS="windows"
     EXE_EXT=".exe"
     SOCKET_LIB="-lws2_32"
+    THREAD_LIB=""
     SDL_FLAGS="-lmingw32 -lSDLmain -lSDL -lSDL_ttf -lSDL_image -lSDL_mixer"
     if [ -d "/mingw64/include/SDL" ]; then
         SDL_INCLUDE="-I/mingw64/include/SDL"
@@ -54,6 +55,7 @@ else
     OS="linux"
     EXE_EXT=""
     SOCKET_LIB=""
+    THREAD_LIB="-pthread"
     SDL_FLAGS="-lSDL -lSDL_ttf -lSDL_image -lSDL_mixer -lm"
     SDL_INCLUDE="$(sdl-config --cflags 2>/dev/null || echo '')"
     SDL_LIBPATH=""
@@ -83,8 +85,15 @@ fi
 echo ">>> Compilation du SERVEUR..."
 SERVER_OUTPUT=$(gcc -std=c99 -Wall -Wextra \
     server/server_main.c \
+    common/pieces.c \
+    common/rules.c \
+    common/deal.c \
+    common/scoring.c \
+    common/solver.c \
+    common/thread_pool.c \
+    common/bot.c \
     -o bin/blockblast_server${EXE_EXT} \
-    $SOCKET_LIB 2>&1)
+    $SOCKET_LIB $THREAD_LIB 2>&1)
 SERVER_RESULT=$?
 
 if [ $SERVER_RESULT -eq 0 ]; then
@@ -103,6 +112,67 @@ fi
 
 echo ""
 
+echo ">>> Compilation du BENCHMARK moteur..."
+BENCH_OUTPUT=$(gcc -std=c99 -Wall -Wextra -O2 \
+    tools/engine_bench.c \
+    client/game.c \
+    common/pieces.c \
+    common/rules.c \
+    common/deal.c \
+    common/scoring.c \
+    common/solver.c \
+    common/thread_pool.c \
+    -o bin/blockblast_bench${EXE_EXT} \
+    -lm $THREAD_LIB 2>&1)
+BENCH_RESULT=$?
+
+if [ $BENCH_RESULT -eq 0 ]; then
+    echo "[OK] Benchmark compile avec succes !"
+    if [ -n "$BENCH_OUTPUT" ]; then
+        echo "Avertissements :"
+        echo "$BENCH_OUTPUT"
+    fi
+else
+    echo "[ERREUR] Echec de la compilation du benchmark."
+    echo "----------------------------------------"
+    echo "$BENCH_OUTPUT"
+    echo "----------------------------------------"
+    exit 1
+fi
+
+echo ""
+
+echo ">>> Compilation du SIMULATEUR d'auto-parties..."
+SIM_OUTPUT=$(gcc -std=c99 -Wall -Wextra -O2 \
+    tools/selfplay_sim.c \
+    client/game.c \
+    common/pieces.c \
+    common/rules.c \
+    common/deal.c \
+    common/scoring.c \
+    common/solver.c \
+    common/thread_pool.c \
+    common/bot.c \
+    -o bin/blockblast_sim${EXE_EXT} \
+    -lm $THREAD_LIB 2>&1)
+SIM_RESULT=$?
+
+if [ $SIM_RESULT -eq 0 ]; then
+    echo "[OK] Simulateur compile avec succes !"
+    if [ -n "$SIM_OUTPUT" ]; then
+        echo "Avertissements :"
+        echo "$SIM_OUTPUT"
+    fi
+else
+    echo "[ERREUR] Echec de la compilation du simulateur."
+    echo "----------------------------------------"
+    echo "$SIM_OUTPUT"
+    echo "----------------------------------------"
+    exit 1
+fi
+
+echo ""
+
 echo ">>> Compilation du CLIENT..."
 
 CLIENT_CMD="gcc -std=c99 -Wall -Wextra"
@@ -125,11 +195,21 @@ CLIENT_CMD="$CLIENT_CMD \
     client/save_system.c \
     client/audio.c \
     client/graphics.c \
+    client/raster.c \
     client/ui_components.c \
+    client/widgets.c \
     client/screens.c \
     client/input_handlers.c \
     client/game.c \
-    client/net_client.c"
+    client/net_client.c \
+    client/profiler.c \
+    common/pieces.c \
+    common/rules.c \
+    common/deal.c \
+    common/scoring.c \
+    common/solver.c \
+    common/thread_pool.c \
+    common/bot.c"
 
 if [ "$EMBEDDED" = true ]; then
     CLIENT_CMD="$CLIENT_CMD client/embedded_assets.c"
@@ -143,7 +223,7 @@ if [ -n "$SOCKET_LIB" ]; then
     CLIENT_CMD="$CLIENT_CMD $SOCKET_LIB"
 fi
 
-CLIENT_CMD="$CLIENT_CMD -lm"
+CLIENT_CMD="$CLIENT_CMD -lm $THREAD_LIB"
 
 CLIENT_OUTPUT=$(eval "$CLIENT_CMD" 2>&1)
 CLIENT_RESULT=$?
@@ -170,6 +250,8 @@ echo ""
 echo "Executables crees dans le dossier bin/ :"
 echo "  - blockblast_server${EXE_EXT}"
 echo "  - blockblast${EXE_EXT}"
+echo "  - blockblast_bench${EXE_EXT}"
+echo "  - blockblast_sim${EXE_EXT}"
 echo ""
 
 if [ "$EMBEDDED" = true ]; then
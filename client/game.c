@@ -1,184 +1,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "game.h"
 
-static Piece piece_templates[] = {
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 1, .h = 4,
-        .color = 0x9966CC
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 3,
-        .color = 0x4466AA
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 1, .h = 3,
-        .color = 0x44AACC
-    },
-    {
-        .data = {{1, 1, 0, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 2,
-        .color = 0x4466AA
-    },
-    {
-        .data = {{1, 1, 1, 0, 0},
-                 {1, 1, 1, 0, 0},
-                 {1, 1, 1, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 3, .h = 3,
-        .color = 0xAA3344
-    },
-    {
-        .data = {{1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 1,
-        .color = 0xAA3344
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 1, .h = 2,
-        .color = 0xDD7722
-    },
-    {
-        .data = {{1, 1, 0, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 3,
-        .color = 0x4466AA
-    },
-    {
-        .data = {{1, 1, 1, 1, 1},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 5, .h = 1,
-        .color = 0x44AA44
-    },
-    {
-        .data = {{1, 1, 0, 0, 0},
-                 {0, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 2,
-        .color = 0x44AACC
-    },
-    {
-        .data = {{0, 1, 1, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 3, .h = 2,
-        .color = 0x44AACC
-    },
-    {
-        .data = {{1, 1, 0, 0, 0},
-                 {0, 1, 1, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 3, .h = 2,
-        .color = 0x4466AA
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 1, 1, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 3, .h = 3,
-        .color = 0x44AA44
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0}},
-        .w = 1, .h = 5,
-        .color = 0xCCAA22
-    },
-    {
-        .data = {{1, 1, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 3,
-        .color = 0xCCAA22
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 0, 0, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 3,
-        .color = 0xDD7722
-    },
-    {
-        .data = {{1, 1, 1, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 3, .h = 1,
-        .color = 0x4466AA
-    },
-    {
-        .data = {{1, 0, 0, 0, 0},
-                 {1, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 2, .h = 2,
-        .color = 0x4466AA
-    },
-    {
-        .data = {{1, 1, 1, 0, 0},
-                 {0, 1, 0, 0, 0},
-                 {0, 1, 0, 0, 0},
-                 {0, 0, 0, 0, 0},
-                 {0, 0, 0, 0, 0}},
-        .w = 3, .h = 3,
-        .color = 0x9966CC
-    }
-};
-
-#define NUM_TEMPLATES 19
-
 void init_effects(EffectsManager *em) {
     int i;
     memset(em, 0, sizeof(EffectsManager));
@@ -330,7 +155,45 @@ void trigger_screen_shake(EffectsManager *em, float intensity) {
 }
 
 void init_game(GameState *gs) {
+    unsigned int seed = (unsigned int)time(NULL) ^ ((unsigned int)rand() << 12) ^ (unsigned int)rand();
+    init_game_seeded(gs, seed);
+}
+
+static void refresh_playable(GameState *gs) {
+    BitBoard bb;
+    int i;
+    
+    bb_from_grid(&bb, gs->grid, gs->grid_size);
+    gs->playable = 0;
+    for (i = 0; i < 3; i++) {
+        if (bb_has_any_anchor(&bb, &piece_info(&gs->current_pieces[i])->bb)) {
+            gs->playable |= (unsigned char)(1u << i);
+        }
+    }
+}
+
+/* For code that writes gs->grid or the hand directly */
+void game_sync_board(GameState *gs) {
+    gs->hash = zobrist_grid(gs->grid, gs->grid_size);
+    refresh_playable(gs);
+}
+
+void reset_game_seed(GameState *gs, unsigned int seed, int ruleset) {
+    gs->seed = seed;
+    gs->ruleset = ruleset >= 0 && ruleset < NUM_RULESETS ? ruleset : RULESET_CLASSIC;
+    gs->streak = 0;
+    dealer_init(&gs->dealer, seed, DEAL_FAIR);
+}
+
+void game_set_size(GameState *gs, int size) {
+    if (size < GRID_MIN || size > GRID_MAX) size = GRID_DEFAULT;
+    gs->grid_size = size;
     memset(gs->grid, 0, sizeof(gs->grid));
+    gs->hash = 0;
+}
+
+void init_game_seeded(GameState *gs, unsigned int seed) {
+    game_set_size(gs, GRID_DEFAULT);
     
     gs->score = 0;
     gs->game_over = 0;
@@ -342,142 +205,207 @@ void init_game(GameState *gs) {
     
     init_effects(&gs->effects);
     
+    reset_game_seed(gs, seed, RULESET_CLASSIC);
     generate_pieces(gs);
 }
 
 void generate_pieces(GameState *gs) {
+    BitBoard bb;
+    int ids[3];
     int i;
+    
+    bb_from_grid(&bb, gs->grid, gs->grid_size);
+    dealer_deal(&gs->dealer, &bb, ids);
     for (i = 0; i < 3; i++) {
-        int r = rand() % NUM_TEMPLATES;
-        gs->current_pieces[i] = piece_templates[r];
+        set_piece_from_template(&gs->current_pieces[i], ids[i]);
         gs->pieces_available[i] = 1;
     }
+    refresh_playable(gs);
+}
+
+void set_piece_from_template(Piece *p, int template_idx) {
+    *p = piece_make(template_idx);
 }
 
 int can_place(GameState *gs, int row, int col, Piece *p) {
-    int i, j;
-    
-    for (i = 0; i < p->h; i++) {
-        for (j = 0; j < p->w; j++) {
-            if (p->data[i][j]) {
-                int gr = row + i;
-                int gc = col + j;
-                
-                if (gr < 0 || gr >= GRID_H || gc < 0 || gc >= GRID_W) {
-                    return 0;
-                }
-                
-                if (gs->grid[gr][gc] != 0) {
-                    return 0;
-                }
-            }
-        }
-    }
-    
-    return 1;
+    return rules_can_place(gs->grid, gs->grid_size, p, row, col);
 }
 
 void place_piece_logic(GameState *gs, int row, int col, Piece *p) {
-    int i, j;
+    int i, j, k;
     int lines_cleared = 0;
+    RulesLines full;
     
     gs->num_cleared_rows = 0;
     gs->num_cleared_cols = 0;
     
-    for (i = 0; i < p->h; i++) {
-        for (j = 0; j < p->w; j++) {
-            if (p->data[i][j]) {
-                gs->grid[row + i][col + j] = p->color;
-                spawn_place_effect(&gs->effects, row + i, col + j, p->color);
+    rules_stamp(gs->grid, p, row, col, &gs->hash);
+    for (i = 0; i < piece_h(p); i++) {
+        for (j = 0; j < piece_w(p); j++) {
+            if (piece_cell(p, i, j)) {
+                spawn_place_effect(&gs->effects, row + i, col + j, piece_color(p));
             }
         }
     }
     
-    gs->score += 10;
+    rules_full_lines(gs->grid, gs->grid_size, &full);
+    for (i = 0; i < gs->grid_size; i++) {
+        if (full.rows & (1u << i)) gs->cleared_rows[gs->num_cleared_rows++] = i;
+    }
+    for (j = 0; j < gs->grid_size; j++) {
+        if (full.cols & (1u << j)) gs->cleared_cols[gs->num_cleared_cols++] = j;
+    }
     
-    for (i = 0; i < GRID_H; i++) {
-        int full = 1;
-        for (j = 0; j < GRID_W; j++) {
-            if (gs->grid[i][j] == 0) {
-                full = 0;
-                break;
-            }
-        }
-        if (full) {
-            gs->cleared_rows[gs->num_cleared_rows++] = i;
-            
-            spawn_line_clear_effect(&gs->effects, i, -1, 1);
-            
-            for (j = 0; j < GRID_W; j++) {
-                int px = GRID_OFFSET_X + j * BLOCK_SIZE + BLOCK_SIZE / 2;
-                int py = GRID_OFFSET_Y + i * BLOCK_SIZE + BLOCK_SIZE / 2;
-                spawn_particles(&gs->effects, px, py, gs->grid[i][j], 5);
-            }
-            
-            for (j = 0; j < GRID_W; j++) {
-                gs->grid[i][j] = 0;
-            }
-            gs->score += 100;
-            lines_cleared++;
+    for (k = 0; k < gs->num_cleared_rows; k++) {
+        i = gs->cleared_rows[k];
+        spawn_line_clear_effect(&gs->effects, i, -1, 1);
+        
+        for (j = 0; j < gs->grid_size; j++) {
+            int px = GRID_OFFSET_X + j * BLOCK_SIZE + BLOCK_SIZE / 2;
+            int py = GRID_OFFSET_Y + i * BLOCK_SIZE + BLOCK_SIZE / 2;
+            spawn_particles(&gs->effects, px, py, cell_color(gs->grid[i][j]), 5);
         }
     }
     
-    for (j = 0; j < GRID_W; j++) {
-        int full = 1;
-        for (i = 0; i < GRID_H; i++) {
-            if (gs->grid[i][j] == 0) {
-                full = 0;
-                break;
-            }
-        }
-        if (full) {
-            gs->cleared_cols[gs->num_cleared_cols++] = j;
-            
-            spawn_line_clear_effect(&gs->effects, -1, j, 0);
-            
-            for (i = 0; i < GRID_H; i++) {
-                int px = GRID_OFFSET_X + j * BLOCK_SIZE + BLOCK_SIZE / 2;
-                int py = GRID_OFFSET_Y + i * BLOCK_SIZE + BLOCK_SIZE / 2;
-                spawn_particles(&gs->effects, px, py, gs->grid[i][j], 5);
-            }
-            
-            for (i = 0; i < GRID_H; i++) {
-                gs->grid[i][j] = 0;
-            }
-            gs->score += 100;
-            lines_cleared++;
+    for (k = 0; k < gs->num_cleared_cols; k++) {
+        j = gs->cleared_cols[k];
+        spawn_line_clear_effect(&gs->effects, -1, j, 0);
+        
+        for (i = 0; i < gs->grid_size; i++) {
+            int px = GRID_OFFSET_X + j * BLOCK_SIZE + BLOCK_SIZE / 2;
+            int py = GRID_OFFSET_Y + i * BLOCK_SIZE + BLOCK_SIZE / 2;
+            spawn_particles(&gs->effects, px, py, cell_color(gs->grid[i][j]), 5);
         }
     }
     
+    rules_clear_lines(gs->grid, gs->grid_size, full.rows, full.cols, &gs->hash);
+    
+    lines_cleared = full.lines;
+    gs->score += score_move(score_rules(gs->ruleset), piece_info(p)->bb.cells, lines_cleared,
+                            full.board_clear, &gs->streak);
+    
     if (lines_cleared > 0) {
         trigger_screen_shake(&gs->effects, (float)lines_cleared * 0.5f);
         
         if (lines_cleared >= 2) {
-            int center_x = GRID_OFFSET_X + (GRID_W * BLOCK_SIZE) / 2;
-            int center_y = GRID_OFFSET_Y + (GRID_H * BLOCK_SIZE) / 2;
+            int center_x = GRID_OFFSET_X + (gs->grid_size * BLOCK_SIZE) / 2;
+            int center_y = GRID_OFFSET_Y + (gs->grid_size * BLOCK_SIZE) / 2;
             spawn_celebration_particles(&gs->effects, center_x, center_y, lines_cleared * 15);
         }
     }
+    
+    refresh_playable(gs);
+}
+
+int game_move_points(const GameState *gs, const Piece *p, int lines, int board_clear) {
+    return score_points(score_rules(gs->ruleset), piece_info(p)->bb.cells, lines, board_clear, gs->streak);
+}
+
+int game_slot_playable(const GameState *gs, int slot) {
+    return gs->pieces_available[slot] && ((gs->playable >> slot) & 1u);
 }
 
 int check_valid_moves_exist(GameState *gs) {
-    int i, r, c;
+    return game_slot_playable(gs, 0) || game_slot_playable(gs, 1) || game_slot_playable(gs, 2);
+}
+
+void game_to_bitboard(const GameState *gs, BitBoard *bb, BBPiece pieces[3]) {
+    int i;
+    
+    bb_from_grid(bb, gs->grid, gs->grid_size);
     
     for (i = 0; i < 3; i++) {
-        if (!gs->pieces_available[i]) {
-            continue;
-        }
-        
-        Piece *p = &gs->current_pieces[i];
-        
-        for (r = 0; r < GRID_H; r++) {
-            for (c = 0; c < GRID_W; c++) {
-                if (can_place(gs, r, c, p)) {
-                    return 1;
-                }
-            }
-        }
+        pieces[i] = piece_info(&gs->current_pieces[i])->bb;
+    }
+}
+
+void game_move_map(const GameState *gs, int slot, BBMoveMap *map) {
+    BitBoard bb;
+    
+    bb_from_grid(&bb, gs->grid, gs->grid_size);
+    bb_move_map(&bb, &piece_info(&gs->current_pieces[slot])->bb, map);
+}
+
+int game_solve(const GameState *gs, ThreadPool *pool, SolverResult *result) {
+    BitBoard bb;
+    BBPiece pieces[3];
+    
+    game_to_bitboard(gs, &bb, pieces);
+    
+    return solver_solve(&bb, pieces, gs->pieces_available, NULL, pool, result);
+}
+
+void game_snapshot(const GameState *gs, GameSnapshot *snap) {
+    int i;
+    
+    memcpy(snap->grid, gs->grid, sizeof(snap->grid));
+    snap->available = 0;
+    for (i = 0; i < 3; i++) {
+        snap->piece_ids[i] = (unsigned char)gs->current_pieces[i].id;
+        if (gs->pieces_available[i]) snap->available |= (unsigned char)(1u << i);
     }
+    snap->game_over = (unsigned char)gs->game_over;
+    snap->score = gs->score;
+    snap->streak = gs->streak;
+    snap->hash = gs->hash;
+    snap->dealer = gs->dealer;
+}
+
+void game_restore(GameState *gs, const GameSnapshot *snap) {
+    int i;
     
-    return 0;
+    memcpy(gs->grid, snap->grid, sizeof(gs->grid));
+    for (i = 0; i < 3; i++) {
+        gs->current_pieces[i] = piece_make(snap->piece_ids[i]);
+        gs->pieces_available[i] = (snap->available >> i) & 1u;
+    }
+    gs->game_over = snap->game_over;
+    gs->score = snap->score;
+    gs->streak = snap->streak;
+    gs->hash = snap->hash;
+    gs->dealer = snap->dealer;
+    gs->num_cleared_rows = 0;
+    gs->num_cleared_cols = 0;
+    refresh_playable(gs);
+}
+
+void undo_reset(UndoHistory *h, const GameState *gs) {
+    h->first = 0;
+    h->count = 1;
+    h->current = 0;
+    game_snapshot(gs, &h->slots[0]);
+}
+
+/* Drops any redo states, and the oldest snapshot once the ring is full */
+void undo_push(UndoHistory *h, const GameState *gs) {
+    h->count = h->current + 1;
+    if (h->count == UNDO_HISTORY_SIZE) {
+        h->first = (h->first + 1) % UNDO_HISTORY_SIZE;
+        h->count--;
+    }
+    h->current = h->count;
+    h->count++;
+    game_snapshot(gs, &h->slots[(h->first + h->current) % UNDO_HISTORY_SIZE]);
+}
+
+int undo_can_undo(const UndoHistory *h) {
+    return h->current > 0;
+}
+
+int undo_can_redo(const UndoHistory *h) {
+    return h->current + 1 < h->count;
+}
+
+int undo_step(UndoHistory *h, GameState *gs) {
+    if (!undo_can_undo(h)) return 0;
+    h->current--;
+    game_restore(gs, &h->slots[(h->first + h->current) % UNDO_HISTORY_SIZE]);
+    return 1;
+}
+
+int redo_step(UndoHistory *h, GameState *gs) {
+    if (!undo_can_redo(h)) return 0;
+    h->current++;
+    game_restore(gs, &h->slots[(h->first + h->current) % UNDO_HISTORY_SIZE]);
+    return 1;
 }
@@ -2,12 +2,13 @@
 #define GAME_H
 
 #include "../common/config.h"
-
-typedef struct {
-    int data[5][5];
-    int w, h;
-    int color;
-} Piece;
+#include "../common/deal.h"
+#include "../common/bitboard.h"
+#include "../common/pieces.h"
+#include "../common/rules.h"
+#include "../common/scoring.h"
+#include "../common/zobrist.h"
+#include "../common/solver.h"
 
 typedef struct {
     float x, y;
@@ -45,28 +46,80 @@ typedef struct {
 } EffectsManager;
 
 typedef struct {
-    int grid[GRID_H][GRID_W];
+    int grid_size;
+    Cell grid[GRID_MAX][GRID_MAX];
     int score;
     int game_over;
     Piece current_pieces[3];
     int pieces_available[3];
     EffectsManager effects;
-    int cleared_rows[GRID_H];
-    int cleared_cols[GRID_W];
+    int cleared_rows[GRID_MAX];
+    int cleared_cols[GRID_MAX];
     int num_cleared_rows;
     int num_cleared_cols;
+    unsigned int seed;
+    int ruleset;
+    int streak;
+    PieceDealer dealer;
+    uint64_t hash;
+    unsigned char playable;
 } GameState;
 
+/* Engine state only, no effects: what undo needs to put a solo game back. The size never changes within a game. */
+typedef struct {
+    Cell grid[GRID_MAX][GRID_MAX];
+    unsigned char piece_ids[3];
+    unsigned char available;
+    unsigned char game_over;
+    int score;
+    int streak;
+    uint64_t hash;
+    PieceDealer dealer;
+} GameSnapshot;
+
+typedef struct {
+    GameSnapshot slots[UNDO_HISTORY_SIZE];
+    int first;
+    int count;
+    int current;
+} UndoHistory;
+
 void init_game(GameState *gs);
+void init_game_seeded(GameState *gs, unsigned int seed);
+/* The seed and the scoring ruleset together fix how a game plays out */
+void reset_game_seed(GameState *gs, unsigned int seed, int ruleset);
+/* Empties the board and resizes it, out-of-range sizes fall back to GRID_DEFAULT */
+void game_set_size(GameState *gs, int size);
+void game_sync_board(GameState *gs);
 
 void generate_pieces(GameState *gs);
+void set_piece_from_template(Piece *p, int template_idx);
 
 int can_place(GameState *gs, int row, int col, Piece *p);
 
 void place_piece_logic(GameState *gs, int row, int col, Piece *p);
+/* Points place_piece_logic() would add for a placement clearing `lines` lines */
+int game_move_points(const GameState *gs, const Piece *p, int lines, int board_clear);
 
+/* Bit i of gs->playable is set while hand slot i has a legal anchor, available or not */
+int game_slot_playable(const GameState *gs, int slot);
 int check_valid_moves_exist(GameState *gs);
 
+void game_to_bitboard(const GameState *gs, BitBoard *bb, BBPiece pieces[3]);
+/* Every anchor of one hand slot with the lines it clears; score delta is game_move_points() */
+void game_move_map(const GameState *gs, int slot, BBMoveMap *map);
+int game_solve(const GameState *gs, ThreadPool *pool, SolverResult *result);
+
+void game_snapshot(const GameState *gs, GameSnapshot *snap);
+void game_restore(GameState *gs, const GameSnapshot *snap);
+
+void undo_reset(UndoHistory *h, const GameState *gs);
+void undo_push(UndoHistory *h, const GameState *gs);
+int undo_step(UndoHistory *h, GameState *gs);
+int redo_step(UndoHistory *h, GameState *gs);
+int undo_can_undo(const UndoHistory *h);
+int undo_can_redo(const UndoHistory *h);
+
 void init_effects(EffectsManager *em);
 void update_effects(EffectsManager *em, float dt);
 void spawn_place_effect(EffectsManager *em, int row, int col, int color);
@@ -1,4 +1,5 @@
 #include "globals.h"
+#include "graphics.h"
 #include <string.h>
 
 float global_time = 0.0f;
@@ -16,6 +17,8 @@ int piece_area_y = 0;
 int score_area_x = 0;
 int score_area_y = 0;
 int block_size = BLOCK_SIZE;
+int layout_grid_size = 0;
+int layout_generation = 0;
 
 SDL_Surface *screen = NULL;
 TTF_Font *font_L = NULL;
@@ -28,6 +31,11 @@ int mouse_x = 0, mouse_y = 0;
 int selected_piece_idx = -1;
 int solo_high_score = 0;
 
+ThreadPool *solver_pool = NULL;
+int hint_visible = 0;
+SolverResult hint_result;
+UndoHistory solo_history;
+
 char online_ip[32] = "127.0.0.1";
 int online_port = PORT;
 char edit_ip[32] = "127.0.0.1";
@@ -45,14 +53,22 @@ ServerListData server_list;
 int browser_scroll_offset = 0;
 int selected_game_mode = GAME_MODE_CLASSIC;
 int selected_timer_minutes = 3;
+int selected_bot_level = BOT_MEDIUM;
 int is_spectator = 0;
 int spectate_view_idx = 0;
 
 RushPlayerState rush_states[4];
+Cell rush_grids[4][GRID_MAX][GRID_MAX];
 int rush_player_count = 0;
 int rush_time_remaining = 0;
 Uint32 last_time_update = 0;
 
+int duel_active = 0;
+GameState duel_game;
+Bot duel_bot;
+int duel_thinking = 0;
+Uint32 duel_next_move = 0;
+
 int multi_game_over = 0;
 char multi_winner_name[32] = "";
 
@@ -69,6 +85,11 @@ int settings_tab = 0;
 
 void recalculate_layout(void) {
     float aspect_ratio = (float)window_w / (float)window_h;
+    int n = (game.grid_size >= GRID_MIN && game.grid_size <= GRID_MAX) ? game.grid_size : GRID_DEFAULT;
+    int old_block_size = block_size;
+    
+    layout_grid_size = game.grid_size;
+    layout_generation++;
     
     layout_horizontal = (aspect_ratio > 1.2f) ? 1 : 0;
     
@@ -76,14 +97,14 @@ void recalculate_layout(void) {
         int available_h = window_h - 40;
         int available_w = (window_w / 2) - 40;
         
-        int size_from_h = available_h / GRID_H;
-        int size_from_w = available_w / GRID_W;
+        int size_from_h = available_h / n;
+        int size_from_w = available_w / n;
         block_size = (size_from_h < size_from_w) ? size_from_h : size_from_w;
         if (block_size < 20) block_size = 20;
         if (block_size > 50) block_size = 50;
         
-        int grid_total_w = GRID_W * block_size;
-        int grid_total_h = GRID_H * block_size;
+        int grid_total_w = n * block_size;
+        int grid_total_h = n * block_size;
         grid_offset_x = (window_w / 2 - grid_total_w) / 2;
         grid_offset_y = (window_h - grid_total_h) / 2;
         
@@ -96,13 +117,13 @@ void recalculate_layout(void) {
         int available_h = window_h - 300;
         int available_w = window_w - 40;
         
-        int size_from_h = available_h / GRID_H;
-        int size_from_w = available_w / GRID_W;
+        int size_from_h = available_h / n;
+        int size_from_w = available_w / n;
         block_size = (size_from_h < size_from_w) ? size_from_h : size_from_w;
         if (block_size < 20) block_size = 20;
         if (block_size > 50) block_size = 50;
         
-        int grid_total_w = GRID_W * block_size;
+        int grid_total_w = n * block_size;
         grid_offset_x = (window_w - grid_total_w) / 2;
         grid_offset_y = 100;
         
@@ -110,7 +131,11 @@ void recalculate_layout(void) {
         score_area_y = 30;
         
         piece_area_x = 30;
-        piece_area_y = grid_offset_y + GRID_H * block_size + 30;
+        piece_area_y = grid_offset_y + n * block_size + 30;
+    }
+    
+    if (block_size != old_block_size) {
+        invalidate_block_sprites();
     }
 }
 
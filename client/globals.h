@@ -7,6 +7,7 @@
 #include "game.h"
 #include "../common/config.h"
 #include "../common/net_protocol.h"
+#include "../common/bot.h"
 
 enum GameScreenState {
     ST_MENU,
@@ -25,7 +26,7 @@ enum GameScreenState {
 #define SAVE_MAGIC 0xBB5A7E01
 #define SAVE_KEY "N30N_BL0CK_BL4ST_K3Y_2024!"
 #define GAME_SAVE_FILE "game_session.arthur"
-#define GAME_SAVE_MAGIC 0xBB5E5510
+#define GAME_SAVE_MAGIC 0xBB5E5516
 
 #define DEFAULT_PIECE_AREA_Y 680
 #define PIECE_SLOT_W 160
@@ -46,6 +47,9 @@ extern int piece_area_y;
 extern int score_area_x;
 extern int score_area_y;
 extern int block_size;
+extern int layout_grid_size;
+/* Counts the recalculate_layout() calls, whatever was laid out against an older one is stale */
+extern int layout_generation;
 
 extern SDL_Surface *screen;
 extern TTF_Font *font_L;
@@ -58,6 +62,12 @@ extern int mouse_x, mouse_y;
 extern int selected_piece_idx;
 extern int solo_high_score;
 
+/* Shared by the solver, the duel bot and the frame replay, all on the main thread */
+extern ThreadPool *solver_pool;
+extern int hint_visible;
+extern SolverResult hint_result;
+extern UndoHistory solo_history;
+
 extern char online_ip[32];
 extern int online_port;
 extern char edit_ip[32];
@@ -75,14 +85,23 @@ extern ServerListData server_list;
 extern int browser_scroll_offset;
 extern int selected_game_mode;
 extern int selected_timer_minutes;
+extern int selected_bot_level;
 extern int is_spectator;
 extern int spectate_view_idx;
 
 extern RushPlayerState rush_states[4];
+extern Cell rush_grids[4][GRID_MAX][GRID_MAX];
 extern int rush_player_count;
 extern int rush_time_remaining;
 extern Uint32 last_time_update;
 
+/* Offline duel against a bot, played on the Rush screen */
+extern int duel_active;
+extern GameState duel_game;
+extern Bot duel_bot;
+extern int duel_thinking;
+extern Uint32 duel_next_move;
+
 extern int multi_game_over;
 extern char multi_winner_name[32];
 
@@ -1,78 +1,829 @@
 #include "graphics.h"
 #include "globals.h"
+#include "raster.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Frame damage tracking. Between gfx_begin_frame() and gfx_end_frame() the draw calls are
+ * recorded instead of drawn, and each one is hashed into the screen tiles it covers. The tiles
+ * whose hash differs from the previous frame are the dirty area: only the recorded calls that
+ * touch it are replayed there, clipped, and only it is presented. */
+#define DRAW_TILE 32
+#define DRAW_MAX_OPS 16384
+#define DRAW_TEXT_ARENA 65536
+
+typedef enum {
+    DRAW_FILL,
+    DRAW_TEXT_CENTER,
+    DRAW_TEXT_LEFT,
+    DRAW_IMAGE,
+    /* Drawn by the pixel kernels */
+    DRAW_GRADIENT_V,
+    DRAW_GRADIENT_H,
+    DRAW_BLEND,
+    DRAW_ADD
+} DrawKind;
+
+typedef struct {
+    int kind;
+    /* Screen area the call covers, clipped to the screen */
+    SDL_Rect area;
+    /* Rectangles: the top left corner and the size before clipping. Text: the anchor point */
+    int x, y, w, h;
+    /* Rectangles: the mapped pixel, the first one of a gradient. Text: the RGB colour.
+     * Image: the ID it was given when drawn, pointers can be reused by a new image */
+    Uint32 color;
+    /* Gradient: the last pixel. Blend: the amount out of 256 */
+    Uint32 color2;
+    TTF_Font *font;
+    int text;
+    SDL_Surface *image;
+} DrawOp;
+
+static DrawOp draw_ops[DRAW_MAX_OPS];
+static int num_draw_ops = 0;
+static char draw_text_arena[DRAW_TEXT_ARENA];
+static int draw_text_used = 0;
+static int recording = 0;
+static int full_redraw = 1;
+
+/* Recorded calls kept past their frame. The text offsets point into the block's own text. */
+struct GfxBlock {
+    DrawOp *ops;
+    int num_ops, max_ops;
+    char *text;
+    int text_used, text_size;
+    int complete;
+};
+
+static GfxBlock *capture = NULL;
+
+static Uint32 *tile_hashes[2] = {NULL, NULL};
+static int tile_frame = 0;
+static int tile_cols = 0, tile_rows = 0;
+static SDL_Rect *dirty_rects = NULL;
+
+/* Offscreen copy of the background for the current window size */
+static SDL_Surface *background = NULL;
+static Uint32 next_image_id = 1;
+static Uint32 background_id = 0;
+
+/* Pre-rendered blocks. Scaled blocks are keyed on the integer sizes the scale rounds to,
+ * which is everything their pixels depend on */
+#define SPRITE_CACHE_SIZE 256
+
+typedef enum {
+    SPRITE_NEON,
+    SPRITE_SCALED
+} SpriteStyle;
+
+typedef struct {
+    int style;
+    Uint32 color;
+    int size;
+    int glow;
+    int margin;
+    int dot;
+    SDL_Surface *surface;
+    Uint32 id;
+} BlockSprite;
+
+static BlockSprite sprites[SPRITE_CACHE_SIZE];
+static int num_sprites = 0;
+
+/* Rendered strings, least recently used one replaced first. Longer strings are not kept */
+#define TEXT_CACHE_SIZE 128
+#define TEXT_CACHE_LEN 64
+
+typedef struct {
+    TTF_Font *font;
+    Uint32 color;
+    Uint32 hash;
+    char text[TEXT_CACHE_LEN];
+    SDL_Surface *surface;
+    Uint32 last_used;
+} CachedText;
+
+static CachedText text_cache[TEXT_CACHE_SIZE];
+static Uint32 text_clock = 0;
+/* Entries used after this clock value are not evicted, 0 pins nothing */
+static Uint32 text_pinned = 0;
+
+/* Scores and timers change every few frames: they are put together from glyphs rendered
+ * once per font and colour instead of filling the string cache */
+#define GLYPH_CHARS "0123456789+-:./%x"
+#define NUM_GLYPHS ((int)sizeof(GLYPH_CHARS) - 1)
+#define GLYPH_ATLAS_COUNT 8
+
+typedef struct {
+    TTF_Font *font;
+    Uint32 color;
+    SDL_Surface *glyphs[NUM_GLYPHS];
+    Uint32 last_used;
+} GlyphAtlas;
+
+static GlyphAtlas glyph_atlases[GLYPH_ATLAS_COUNT];
+
+static void draw_op(const DrawOp *op, const SDL_Rect *clips, int num_clips);
+
+/* Mapped pixels, direct-mapped on the RGB value. What is drawn is the COLOR_* and
+ * BLOCK_COLOR_* palette and a few shades of it, so the table holds a whole frame */
+#define PIXEL_CACHE_SIZE 1024
+#define PIXEL_CACHE_EMPTY 0xFFFFFFFFu
+
+typedef struct {
+    Uint32 color;
+    Uint32 pixel;
+} CachedPixel;
+
+static CachedPixel pixel_cache[PIXEL_CACHE_SIZE];
+static int pixel_cache_ready = 0;
+/* Format the cache was built for: bits per pixel and the four masks */
+static Uint32 pixel_format[5];
+
+static const Uint32 palette_colors[] = {
+    COLOR_BG, COLOR_BG_DARK, COLOR_BG_LIGHTER, COLOR_PANEL, COLOR_GRID, COLOR_GRID_BRIGHT,
+    COLOR_GRID_CELL, COLOR_NEON_CYAN, COLOR_NEON_MAGENTA, COLOR_NEON_GREEN, COLOR_NEON_ORANGE,
+    COLOR_NEON_YELLOW, COLOR_NEON_BLUE, COLOR_NEON_RED, COLOR_NEON_PURPLE, COLOR_GLOW_CYAN,
+    COLOR_GLOW_MAGENTA, COLOR_GLOW_GREEN, COLOR_GLOW_ORANGE, COLOR_BUTTON, COLOR_BTN_HOVER,
+    COLOR_BTN_DISABLED, COLOR_WHITE, COLOR_GREY, COLOR_DARK_GREY, COLOR_GOLD, BLOCK_COLOR_LIME
+};
+
+/* Colour math in 1/256 steps: scale_lut[q][v] = v * q / 256 */
+static Uint8 scale_lut[257][256];
+static int scale_lut_ready = 0;
+
+static int pixel_slot(Uint32 color) {
+    return (int)((color * 2654435761u) >> 22) & (PIXEL_CACHE_SIZE - 1);
+}
+
+static Uint32 map_color(Uint32 color) {
+    CachedPixel *c = &pixel_cache[pixel_slot(color)];
+    
+    if (c->color != color) {
+        c->color = color;
+        c->pixel = SDL_MapRGB(screen->format, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+    }
+    return c->pixel;
+}
+
+/* Empties the pixel cache, and what was drawn with it, when the screen format changes */
+static void sync_pixel_format(void) {
+    const SDL_PixelFormat *f = screen->format;
+    Uint32 format[5];
+    const Uint32 palette[] = BLOCK_PALETTE_RGB;
+    int i;
+    
+    format[0] = f->BitsPerPixel;
+    format[1] = f->Rmask;
+    format[2] = f->Gmask;
+    format[3] = f->Bmask;
+    format[4] = f->Amask;
+    if (pixel_cache_ready && memcmp(format, pixel_format, sizeof(format)) == 0) return;
+    
+    if (pixel_cache_ready) {
+        invalidate_block_sprites();
+        invalidate_background();
+    }
+    memcpy(pixel_format, format, sizeof(format));
+    for (i = 0; i < PIXEL_CACHE_SIZE; i++) {
+        pixel_cache[i].color = PIXEL_CACHE_EMPTY;
+    }
+    pixel_cache_ready = 1;
+    
+    for (i = 0; i < (int)(sizeof(palette_colors) / sizeof(palette_colors[0])); i++) {
+        map_color(palette_colors[i]);
+    }
+    for (i = 0; i < BLOCK_PALETTE_SIZE; i++) {
+        map_color(palette[i]);
+    }
+}
 
 Uint32 get_pixel(int r, int g, int b) {
-    return SDL_MapRGB(screen->format, r, g, b);
+    return color_to_pixel(((Uint32)(r & 0xFF) << 16) | ((g & 0xFF) << 8) | (b & 0xFF));
 }
 
 Uint32 color_to_pixel(Uint32 color) {
-    int r = (color >> 16) & 0xFF;
-    int g = (color >> 8) & 0xFF;
-    int b = color & 0xFF;
-    return get_pixel(r, g, b);
+    if (!pixel_cache_ready) sync_pixel_format();
+    return map_color(color & 0xFFFFFF);
+}
+
+static void build_scale_lut(void) {
+    int q, v;
+    for (q = 0; q <= 256; q++) {
+        for (v = 0; v < 256; v++) {
+            scale_lut[q][v] = (Uint8)((v * q) >> 8);
+        }
+    }
+    scale_lut_ready = 1;
+}
+
+static int color_step(float t) {
+    int q = (int)(t * 256.0f + 0.5f);
+    
+    if (!scale_lut_ready) build_scale_lut();
+    if (q < 0) return 0;
+    if (q > 256) return 256;
+    return q;
+}
+
+static int blend_channel(int a, int b, const Uint8 *lut) {
+    return b >= a ? a + lut[b - a] : a - lut[a - b];
 }
 
 Uint32 blend_colors(Uint32 c1, Uint32 c2, float t) {
-    int r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
-    int r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
-    int r = (int)(r1 + (r2 - r1) * t);
-    int g = (int)(g1 + (g2 - g1) * t);
-    int b = (int)(b1 + (b2 - b1) * t);
+    const Uint8 *lut = scale_lut[color_step(t)];
+    int r = blend_channel((c1 >> 16) & 0xFF, (c2 >> 16) & 0xFF, lut);
+    int g = blend_channel((c1 >> 8) & 0xFF, (c2 >> 8) & 0xFF, lut);
+    int b = blend_channel(c1 & 0xFF, c2 & 0xFF, lut);
     return (r << 16) | (g << 8) | b;
 }
 
 Uint32 darken_color(Uint32 color, float factor) {
-    int r = (int)(((color >> 16) & 0xFF) * factor);
-    int g = (int)(((color >> 8) & 0xFF) * factor);
-    int b = (int)((color & 0xFF) * factor);
-    return (r << 16) | (g << 8) | b;
+    const Uint8 *lut = scale_lut[color_step(factor)];
+    return (lut[(color >> 16) & 0xFF] << 16) | (lut[(color >> 8) & 0xFF] << 8) | lut[color & 0xFF];
 }
 
 Uint32 lighten_color(Uint32 color, float factor) {
-    int r = (int)(((color >> 16) & 0xFF) + (255 - ((color >> 16) & 0xFF)) * factor);
-    int g = (int)(((color >> 8) & 0xFF) + (255 - ((color >> 8) & 0xFF)) * factor);
-    int b = (int)((color & 0xFF) + (255 - (color & 0xFF)) * factor);
-    if (r > 255) r = 255;
-    if (g > 255) g = 255;
-    if (b > 255) b = 255;
-    return (r << 16) | (g << 8) | b;
+    const Uint8 *lut = scale_lut[color_step(factor)];
+    int r = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, b = color & 0xFF;
+    return ((r + lut[255 - r]) << 16) | ((g + lut[255 - g]) << 8) | (b + lut[255 - b]);
+}
+
+static Uint32 hash_mix(Uint32 h, Uint32 v) {
+    v *= 0xCC9E2D51u;
+    v = (v << 15) | (v >> 17);
+    v *= 0x1B873593u;
+    h ^= v;
+    h = (h << 13) | (h >> 19);
+    return h * 5u + 0xE6546B64u;
+}
+
+static Uint32 hash_op(const DrawOp *op) {
+    Uint32 h = hash_mix((Uint32)op->kind, (Uint32)op->x);
+    const char *s;
+    
+    h = hash_mix(h, (Uint32)op->y);
+    h = hash_mix(h, ((Uint32)op->area.w << 16) | op->area.h);
+    h = hash_mix(h, ((Uint32)op->w << 16) | (Uint32)op->h);
+    h = hash_mix(h, op->color);
+    h = hash_mix(h, op->color2);
+    if (op->kind == DRAW_TEXT_CENTER || op->kind == DRAW_TEXT_LEFT) {
+        h = hash_mix(h, (Uint32)(size_t)op->font);
+        for (s = draw_text_arena + op->text; *s; s++) {
+            h = hash_mix(h, (Uint32)(unsigned char)*s);
+        }
+    }
+    return h;
+}
+
+/* Out of room for this frame: draw what was recorded and the rest directly, then present it all */
+static void stop_recording(void) {
+    int i;
+    
+    recording = 0;
+    for (i = 0; i < num_draw_ops; i++) {
+        draw_op(&draw_ops[i], NULL, 0);
+    }
+    num_draw_ops = 0;
+}
+
+static void capture_op(const DrawOp *op, const char *txt) {
+    GfxBlock *b = capture;
+    int len = txt ? (int)strlen(txt) + 1 : 0;
+    
+    /* Images can be freed while the block still points at them */
+    if (op->kind == DRAW_IMAGE) b->complete = 0;
+    if (!b->complete) return;
+    
+    if (b->num_ops == b->max_ops) {
+        int max_ops = b->max_ops ? b->max_ops * 2 : 16;
+        DrawOp *ops = (DrawOp*)realloc(b->ops, max_ops * sizeof(DrawOp));
+        if (!ops) {
+            b->complete = 0;
+            return;
+        }
+        b->ops = ops;
+        b->max_ops = max_ops;
+    }
+    if (b->text_used + len > b->text_size) {
+        int text_size = b->text_size ? b->text_size * 2 : 64;
+        char *text;
+        while (b->text_used + len > text_size) text_size *= 2;
+        text = (char*)realloc(b->text, text_size);
+        if (!text) {
+            b->complete = 0;
+            return;
+        }
+        b->text = text;
+        b->text_size = text_size;
+    }
+    
+    b->ops[b->num_ops] = *op;
+    if (txt) {
+        b->ops[b->num_ops].text = b->text_used;
+        memcpy(b->text + b->text_used, txt, len);
+        b->text_used += len;
+    }
+    b->num_ops++;
+}
+
+static void record_op(DrawOp *op, int w, int h, const char *txt) {
+    Uint32 *tiles = tile_hashes[tile_frame];
+    int x0, y0, x1, y1;
+    int tx, ty;
+    Uint32 hash;
+    
+    if (capture) capture_op(op, txt);
+    
+    x0 = op->area.x < 0 ? 0 : op->area.x;
+    y0 = op->area.y < 0 ? 0 : op->area.y;
+    x1 = op->area.x + w > screen->w ? screen->w : op->area.x + w;
+    y1 = op->area.y + h > screen->h ? screen->h : op->area.y + h;
+    if (x1 <= x0 || y1 <= y0) return;
+    
+    if (num_draw_ops == DRAW_MAX_OPS ||
+        (txt && draw_text_used + (int)strlen(txt) + 1 > DRAW_TEXT_ARENA)) {
+        stop_recording();
+        /* The text is not in the arena yet, draw it from the string */
+        if (!txt) {
+            draw_op(op, NULL, 0);
+        } else if (op->kind == DRAW_TEXT_CENTER) {
+            draw_text(op->font, txt, op->x, op->y, op->color);
+        } else {
+            draw_text_left(op->font, txt, op->x, op->y, op->color);
+        }
+        return;
+    }
+    
+    op->area.x = (Sint16)x0;
+    op->area.y = (Sint16)y0;
+    op->area.w = (Uint16)(x1 - x0);
+    op->area.h = (Uint16)(y1 - y0);
+    if (txt) {
+        op->text = draw_text_used;
+        strcpy(draw_text_arena + draw_text_used, txt);
+        draw_text_used += (int)strlen(txt) + 1;
+    }
+    
+    hash = hash_op(op);
+    for (ty = y0 / DRAW_TILE; ty <= (y1 - 1) / DRAW_TILE; ty++) {
+        for (tx = x0 / DRAW_TILE; tx <= (x1 - 1) / DRAW_TILE; tx++) {
+            tiles[ty * tile_cols + tx] = hash_mix(tiles[ty * tile_cols + tx], hash);
+        }
+    }
+    draw_ops[num_draw_ops++] = *op;
+}
+
+static int rects_overlap(const SDL_Rect *a, const SDL_Rect *b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w &&
+           a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+static SDL_Surface *render_text(TTF_Font *f, const char *txt, Uint32 color) {
+    SDL_Color col;
+    col.r = (color >> 16) & 0xFF;
+    col.g = (color >> 8) & 0xFF;
+    col.b = color & 0xFF;
+    return TTF_RenderUTF8_Blended(f, txt, col);
+}
+
+static Uint32 hash_text(const char *txt) {
+    Uint32 h = 2166136261u;
+    for (; *txt; txt++) {
+        h = (h ^ (unsigned char)*txt) * 16777619u;
+    }
+    return h;
+}
+
+/* NULL when the string is too long to keep or cannot be rendered */
+static SDL_Surface *cached_text(TTF_Font *f, const char *txt, Uint32 color) {
+    Uint32 hash = hash_text(txt);
+    CachedText *slot = &text_cache[0];
+    int i;
+    
+    if (strlen(txt) >= TEXT_CACHE_LEN) return NULL;
+    
+    text_clock++;
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        CachedText *c = &text_cache[i];
+        if (c->surface && c->hash == hash && c->font == f && c->color == color && strcmp(c->text, txt) == 0) {
+            c->last_used = text_clock;
+            return c->surface;
+        }
+        if (!c->surface || (slot->surface && c->last_used < slot->last_used)) slot = c;
+    }
+    
+    if (text_pinned && slot->surface && slot->last_used > text_pinned) return NULL;
+    if (slot->surface) SDL_FreeSurface(slot->surface);
+    slot->surface = render_text(f, txt, color);
+    slot->font = f;
+    slot->color = color;
+    slot->hash = hash;
+    strcpy(slot->text, txt);
+    slot->last_used = text_clock;
+    return slot->surface;
+}
+
+static GlyphAtlas *glyph_atlas(TTF_Font *f, Uint32 color) {
+    GlyphAtlas *atlas = &glyph_atlases[0];
+    char glyph[2] = {0, 0};
+    int i;
+    
+    text_clock++;
+    for (i = 0; i < GLYPH_ATLAS_COUNT; i++) {
+        GlyphAtlas *a = &glyph_atlases[i];
+        if (a->font == f && a->color == color) {
+            a->last_used = text_clock;
+            return a;
+        }
+        if (!a->font || (atlas->font && a->last_used < atlas->last_used)) atlas = a;
+    }
+    
+    if (text_pinned && atlas->font && atlas->last_used > text_pinned) return NULL;
+    for (i = 0; i < NUM_GLYPHS; i++) {
+        if (atlas->glyphs[i]) SDL_FreeSurface(atlas->glyphs[i]);
+        glyph[0] = GLYPH_CHARS[i];
+        atlas->glyphs[i] = render_text(f, glyph, color);
+    }
+    atlas->font = f;
+    atlas->color = color;
+    atlas->last_used = text_clock;
+    return atlas;
+}
+
+/* Looks up the glyphs of a string and its width, 0 when one of its characters has none */
+static int glyph_run(TTF_Font *f, const char *txt, Uint32 color, SDL_Surface *glyphs[TEXT_CACHE_LEN], int *w) {
+    GlyphAtlas *atlas;
+    int n;
+    
+    for (n = 0; txt[n]; n++) {
+        if (n == TEXT_CACHE_LEN || !strchr(GLYPH_CHARS, txt[n])) return 0;
+    }
+    
+    atlas = glyph_atlas(f, color);
+    if (!atlas) return 0;
+    *w = 0;
+    for (n = 0; txt[n]; n++) {
+        glyphs[n] = atlas->glyphs[strchr(GLYPH_CHARS, txt[n]) - GLYPH_CHARS];
+        if (!glyphs[n]) return 0;
+        *w += glyphs[n]->w;
+    }
+    return n;
+}
+
+static int blit_glyphs(TTF_Font *f, const char *txt, Uint32 color, int x, int y, int centered) {
+    SDL_Surface *glyphs[TEXT_CACHE_LEN];
+    int n, w;
+    
+    if (!glyph_run(f, txt, color, glyphs, &w)) return 0;
+    
+    if (centered) {
+        x -= w / 2;
+        y -= glyphs[0]->h / 2;
+    }
+    for (n = 0; txt[n]; n++) {
+        SDL_Rect dest;
+        dest.x = (Sint16)x;
+        dest.y = (Sint16)y;
+        SDL_BlitSurface(glyphs[n], NULL, screen, &dest);
+        x += glyphs[n]->w;
+    }
+    return 1;
+}
+
+/* Blits text with its top left corner at x, y or its centre on it */
+static void blit_text(TTF_Font *f, const char *txt, Uint32 color, int x, int y, int centered) {
+    SDL_Surface *surface;
+    SDL_Rect dest;
+    int owned = 0;
+    
+    if (blit_glyphs(f, txt, color, x, y, centered)) return;
+    
+    surface = cached_text(f, txt, color);
+    if (!surface) {
+        surface = render_text(f, txt, color);
+        if (!surface) return;
+        owned = 1;
+    }
+    
+    dest.x = (Sint16)(centered ? x - surface->w / 2 : x);
+    dest.y = (Sint16)(centered ? y - surface->h / 2 : y);
+    SDL_BlitSurface(surface, NULL, screen, &dest);
+    if (owned) SDL_FreeSurface(surface);
+}
+
+/* What the pixel kernels draw: a rectangle, or an image at x, y */
+typedef enum {
+    RASTER_FILL,
+    RASTER_COPY,
+    RASTER_ALPHA,
+    RASTER_GRADIENT_V,
+    RASTER_GRADIENT_H,
+    RASTER_BLEND,
+    RASTER_ADD
+} RasterKind;
+
+typedef struct {
+    int kind;
+    int x, y, w, h;
+    Uint32 pixel;
+    /* Gradient: the last pixel. Blend: the amount out of 256 */
+    Uint32 pixel2;
+    SDL_Surface *src;
+} RasterCmd;
+
+/* The kernels need 32 bpp with whole byte channels */
+static int raster_format_ok(const SDL_PixelFormat *f) {
+    return f->BytesPerPixel == 4 && f->Rloss == 0 && f->Gloss == 0 && f->Bloss == 0 &&
+           f->Rshift % 8 == 0 && f->Gshift % 8 == 0 && f->Bshift % 8 == 0;
+}
+
+/* Rectangle calls only, text goes through the glyph and string surfaces */
+static void op_raster_cmd(const DrawOp *op, RasterCmd *c) {
+    static const int kinds[] = {
+        RASTER_FILL, RASTER_FILL, RASTER_FILL, RASTER_COPY,
+        RASTER_GRADIENT_V, RASTER_GRADIENT_H, RASTER_BLEND, RASTER_ADD
+    };
+    
+    c->kind = kinds[op->kind];
+    c->x = op->x;
+    c->y = op->y;
+    c->w = op->w;
+    c->h = op->h;
+    c->pixel = op->color;
+    c->pixel2 = op->color2;
+    c->src = op->image;
+    if (op->kind == DRAW_FILL) {
+        c->x = op->area.x;
+        c->y = op->area.y;
+        c->w = op->area.w;
+        c->h = op->area.h;
+    }
+}
+
+/* Runs one command on the locked target, clipped to [x0, x1) x [y0, y1) */
+static void raster_cmd(const RasterCmd *c, int x0, int y0, int x1, int y1) {
+    Uint8 *dst;
+    const Uint8 *src = NULL;
+    int pitch = screen->pitch;
+    int w, h;
+    
+    if (c->x > x0) x0 = c->x;
+    if (c->y > y0) y0 = c->y;
+    if (c->x + c->w < x1) x1 = c->x + c->w;
+    if (c->y + c->h < y1) y1 = c->y + c->h;
+    if (x0 >= x1 || y0 >= y1) return;
+    
+    w = x1 - x0;
+    h = y1 - y0;
+    dst = (Uint8 *)screen->pixels + y0 * pitch + x0 * 4;
+    if (c->src) src = (const Uint8 *)c->src->pixels + (y0 - c->y) * c->src->pitch + (x0 - c->x) * 4;
+    
+    if (c->kind == RASTER_FILL) {
+        raster_fill(dst, pitch, w, h, c->pixel);
+    } else if (c->kind == RASTER_COPY) {
+        raster_copy(dst, pitch, src, c->src->pitch, w, h);
+    } else if (c->kind == RASTER_ALPHA) {
+        raster_blend_alpha(dst, pitch, src, c->src->pitch, w, h, c->src->format->Ashift);
+    } else if (c->kind == RASTER_GRADIENT_V) {
+        raster_gradient_v(dst, pitch, w, h, c->pixel, c->pixel2, y0 - c->y, c->h);
+    } else if (c->kind == RASTER_GRADIENT_H) {
+        raster_gradient_h(dst, pitch, w, h, c->pixel, c->pixel2, x0 - c->x, c->w);
+    } else if (c->kind == RASTER_BLEND) {
+        raster_blend(dst, pitch, w, h, c->pixel, (int)c->pixel2);
+    } else {
+        raster_add(dst, pitch, w, h, c->pixel);
+    }
+}
+
+/* Other formats get the opaque approximation: the colour as if over black */
+static void draw_kernel_fallback(const DrawOp *op) {
+    SDL_Rect rect;
+    Uint8 r, g, b;
+    int i;
+    
+    if (op->kind == DRAW_ADD) {
+        rect = op->area;
+        SDL_FillRect(screen, &rect, op->color);
+        return;
+    }
+    
+    SDL_GetRGB(op->color, screen->format, &r, &g, &b);
+    if (op->kind == DRAW_BLEND) {
+        rect = op->area;
+        SDL_FillRect(screen, &rect, color_to_pixel(darken_color((r << 16) | (g << 8) | b, op->color2 / 256.0f)));
+        return;
+    }
+    
+    {
+        Uint32 first = (r << 16) | (g << 8) | b;
+        Uint32 last;
+        int length = op->kind == DRAW_GRADIENT_V ? op->h : op->w;
+        
+        SDL_GetRGB(op->color2, screen->format, &r, &g, &b);
+        last = (r << 16) | (g << 8) | b;
+        for (i = 0; i < length; i++) {
+            rect.x = (Sint16)(op->kind == DRAW_GRADIENT_V ? op->x : op->x + i);
+            rect.y = (Sint16)(op->kind == DRAW_GRADIENT_V ? op->y + i : op->y);
+            rect.w = (Uint16)(op->kind == DRAW_GRADIENT_V ? op->w : 1);
+            rect.h = (Uint16)(op->kind == DRAW_GRADIENT_V ? 1 : op->h);
+            SDL_FillRect(screen, &rect, color_to_pixel(blend_colors(first, last, (float)i / (float)length)));
+        }
+    }
+}
+
+static void draw_kernel_op(const DrawOp *op, const SDL_Rect *clip) {
+    RasterCmd cmd;
+    int x0 = 0, y0 = 0, x1 = screen->w, y1 = screen->h;
+    
+    if (!raster_format_ok(screen->format)) {
+        draw_kernel_fallback(op);
+        return;
+    }
+    if (clip) {
+        if (clip->x > x0) x0 = clip->x;
+        if (clip->y > y0) y0 = clip->y;
+        if (clip->x + clip->w < x1) x1 = clip->x + clip->w;
+        if (clip->y + clip->h < y1) y1 = clip->y + clip->h;
+    }
+    
+    op_raster_cmd(op, &cmd);
+    if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) != 0) return;
+    raster_cmd(&cmd, x0, y0, x1, y1);
+    if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+}
+
+/* Draws one call, once per clip rectangle it touches, or unclipped when there are none */
+static void draw_op(const DrawOp *op, const SDL_Rect *clips, int num_clips) {
+    int i;
+    
+    for (i = 0; i < (num_clips > 0 ? num_clips : 1); i++) {
+        SDL_Rect dest;
+        
+        if (num_clips > 0) {
+            if (!rects_overlap(&op->area, &clips[i])) continue;
+            SDL_SetClipRect(screen, &clips[i]);
+        }
+        
+        if (op->kind == DRAW_FILL) {
+            dest = op->area;
+            SDL_FillRect(screen, &dest, op->color);
+            continue;
+        }
+        
+        if (op->kind == DRAW_IMAGE) {
+            dest.x = (Sint16)op->x;
+            dest.y = (Sint16)op->y;
+            SDL_BlitSurface(op->image, NULL, screen, &dest);
+            continue;
+        }
+        
+        if (op->kind >= DRAW_GRADIENT_V) {
+            draw_kernel_op(op, num_clips > 0 ? &clips[i] : NULL);
+            continue;
+        }
+        
+        blit_text(op->font, draw_text_arena + op->text, op->color, op->x, op->y, op->kind == DRAW_TEXT_CENTER);
+    }
+    
+    if (num_clips > 0) SDL_SetClipRect(screen, NULL);
+}
+
+static void init_op(DrawOp *op, int kind, int x, int y, int w, int h) {
+    op->kind = kind;
+    op->area.x = (Sint16)x;
+    op->area.y = (Sint16)y;
+    op->area.w = (Uint16)w;
+    op->area.h = (Uint16)h;
+    op->x = x;
+    op->y = y;
+    op->w = w;
+    op->h = h;
+    op->color = 0;
+    op->color2 = 0;
+    op->font = NULL;
+    op->text = 0;
+    op->image = NULL;
+}
+
+/* Rectangles and images are recorded, or drawn right away outside of a frame */
+static void submit_op(DrawOp *op) {
+    if (recording) {
+        record_op(op, op->w, op->h, NULL);
+    } else {
+        draw_op(op, NULL, 0);
+    }
+}
+
+static void draw_image(SDL_Surface *image, Uint32 id, int x, int y) {
+    DrawOp op;
+    
+    init_op(&op, DRAW_IMAGE, x, y, image->w, image->h);
+    op.color = id;
+    op.image = image;
+    submit_op(&op);
+}
+
+/* The text is only measured here, rendering waits until it is known to be visible */
+static void record_text(int kind, TTF_Font *f, const char *txt, int x, int y, Uint32 color) {
+    DrawOp op;
+    SDL_Surface *glyphs[TEXT_CACHE_LEN];
+    int w = 0, h = 0;
+    
+    if (glyph_run(f, txt, color, glyphs, &w)) {
+        h = glyphs[0]->h;
+    } else if (TTF_SizeUTF8(f, txt, &w, &h) != 0) {
+        return;
+    }
+    if (TTF_FontHeight(f) > h) h = TTF_FontHeight(f);
+    
+    init_op(&op, kind, x, y, w, h);
+    op.color = color;
+    op.font = f;
+    /* Glyphs can overhang the measured box by a pixel or two */
+    if (kind == DRAW_TEXT_CENTER) {
+        op.area.x = (Sint16)(x - w / 2 - 2);
+        op.area.y = (Sint16)(y - h / 2 - 2);
+    } else {
+        op.area.x = (Sint16)(x - 2);
+        op.area.y = (Sint16)(y - 2);
+    }
+    record_op(&op, w + 4, h + 4, txt);
 }
 
 void fill_rect(int x, int y, int w, int h, Uint32 color) {
     SDL_Rect rect = {x, y, w, h};
+    
+    if (recording) {
+        DrawOp op;
+        init_op(&op, DRAW_FILL, rect.x, rect.y, rect.w, rect.h);
+        op.color = color_to_pixel(color);
+        record_op(&op, rect.w, rect.h, NULL);
+        return;
+    }
+    
     SDL_FillRect(screen, &rect, color_to_pixel(color));
 }
 
 void draw_gradient_v(int x, int y, int w, int h, Uint32 color_top, Uint32 color_bottom) {
-    int i;
-    for (i = 0; i < h; i++) {
-        float t = (float)i / (float)h;
-        Uint32 color = blend_colors(color_top, color_bottom, t);
-        fill_rect(x, y + i, w, 1, color);
-    }
+    DrawOp op;
+    
+    if (w <= 0 || h <= 0) return;
+    init_op(&op, DRAW_GRADIENT_V, x, y, w, h);
+    op.color = color_to_pixel(color_top);
+    op.color2 = color_to_pixel(color_bottom);
+    submit_op(&op);
 }
 
 void draw_gradient_h(int x, int y, int w, int h, Uint32 color_left, Uint32 color_right) {
-    int i;
-    for (i = 0; i < w; i++) {
-        float t = (float)i / (float)w;
-        Uint32 color = blend_colors(color_left, color_right, t);
-        fill_rect(x + i, y, 1, h, color);
-    }
+    DrawOp op;
+    
+    if (w <= 0 || h <= 0) return;
+    init_op(&op, DRAW_GRADIENT_H, x, y, w, h);
+    op.color = color_to_pixel(color_left);
+    op.color2 = color_to_pixel(color_right);
+    submit_op(&op);
 }
 
-void draw_neon_border(int x, int y, int w, int h, Uint32 color, int glow_size) {
+void blend_rect(int x, int y, int w, int h, Uint32 color, float alpha) {
+    DrawOp op;
+    int amount = color_step(alpha);
+    
+    if (w <= 0 || h <= 0 || amount == 0) return;
+    init_op(&op, DRAW_BLEND, x, y, w, h);
+    op.color = color_to_pixel(color);
+    op.color2 = (Uint32)amount;
+    submit_op(&op);
+}
+
+void add_rect(int x, int y, int w, int h, Uint32 color, float amount) {
+    DrawOp op;
+    Uint32 scaled = darken_color(color, amount);
+    
+    if (w <= 0 || h <= 0 || scaled == 0) return;
+    init_op(&op, DRAW_ADD, x, y, w, h);
+    op.color = color_to_pixel(scaled);
+    submit_op(&op);
+}
+
+/* Rings around the rectangle, the nearest one the most opaque. The sides stop short of the
+ * top and bottom rows so that no pixel is blended twice. */
+void draw_glow(int x, int y, int w, int h, Uint32 color, int size, float strength) {
     int i;
     
-    for (i = glow_size; i > 0; i--) {
-        float alpha = (float)(glow_size - i + 1) / (float)(glow_size + 1) * 0.3f;
-        Uint32 glow_color = darken_color(color, alpha);
+    for (i = size; i > 0; i--) {
+        float alpha = (float)(size - i + 1) / (float)(size + 1) * strength;
         
-        fill_rect(x - i, y - i, w + i * 2, 1, glow_color);
-        fill_rect(x - i, y + h + i - 1, w + i * 2, 1, glow_color);
-        fill_rect(x - i, y - i, 1, h + i * 2, glow_color);
-        fill_rect(x + w + i - 1, y - i, 1, h + i * 2, glow_color);
+        blend_rect(x - i, y - i, w + i * 2, 1, color, alpha);
+        blend_rect(x - i, y + h + i - 1, w + i * 2, 1, color, alpha);
+        blend_rect(x - i, y - i + 1, 1, h + i * 2 - 2, color, alpha);
+        blend_rect(x + w + i - 1, y - i + 1, 1, h + i * 2 - 2, color, alpha);
     }
+}
+
+void draw_neon_border(int x, int y, int w, int h, Uint32 color, int glow_size) {
+    draw_glow(x, y, w, h, color, glow_size, 0.3f);
     
     fill_rect(x, y, w, 2, color);
     fill_rect(x, y + h - 2, w, 2, color);
@@ -81,12 +832,7 @@ void draw_neon_border(int x, int y, int w, int h, Uint32 color, int glow_size) {
 }
 
 void draw_neon_rect(int x, int y, int w, int h, Uint32 bg_color, Uint32 border_color, int glow_size) {
-    int i;
-    for (i = glow_size; i > 0; i--) {
-        float alpha = (float)(glow_size - i + 1) / (float)(glow_size + 1) * 0.2f;
-        Uint32 glow_color = darken_color(border_color, alpha);
-        fill_rect(x - i, y - i, w + i * 2, h + i * 2, glow_color);
-    }
+    draw_glow(x, y, w, h, border_color, glow_size, 0.2f);
     
     fill_rect(x, y, w, h, bg_color);
     
@@ -96,7 +842,13 @@ void draw_neon_rect(int x, int y, int w, int h, Uint32 bg_color, Uint32 border_c
     fill_rect(x + w - 2, y, 2, h, border_color);
 }
 
-void draw_neon_block(int x, int y, int size, Uint32 color) {
+static SDL_Surface *create_screen_surface(int w, int h) {
+    return SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, screen->format->BitsPerPixel,
+                                screen->format->Rmask, screen->format->Gmask,
+                                screen->format->Bmask, screen->format->Amask);
+}
+
+static void render_neon_block(int x, int y, int size, Uint32 color) {
     int glow_size = 3;
     int i;
     Uint32 inner_color = darken_color(color, 0.4f);
@@ -119,21 +871,11 @@ void draw_neon_block(int x, int y, int size, Uint32 color) {
     fill_rect(x + 3, y + 3, 2, 4, 0xFFFFFF);
 }
 
-void draw_styled_block(int x, int y, int size, Uint32 color) {
-    draw_neon_block(x, y, size, color);
-}
-
-void draw_styled_block_scaled(int x, int y, int size, Uint32 color, float scale) {
-    int scaled_size = (int)(size * scale);
-    int offset = (size - scaled_size) / 2;
-    int glow_size = (int)(2 * scale);
+static void render_scaled_block(int bx, int by, int scaled_size, int glow_size, int inner_margin, int dot, Uint32 color) {
     int i;
     Uint32 inner_color = darken_color(color, 0.4f);
     Uint32 highlight = lighten_color(color, 0.4f);
     
-    int bx = x + offset;
-    int by = y + offset;
-    
     for (i = glow_size; i > 0; i--) {
         float alpha = (float)(glow_size - i + 1) / (float)(glow_size + 1) * 0.2f;
         Uint32 glow_color = darken_color(color, alpha);
@@ -142,84 +884,502 @@ void draw_styled_block_scaled(int x, int y, int size, Uint32 color, float scale)
     
     fill_rect(bx, by, scaled_size, scaled_size, color);
     
-    int inner_margin = (int)(3 * scale);
-    if (inner_margin < 1) inner_margin = 1;
     fill_rect(bx + inner_margin, by + inner_margin, 
               scaled_size - inner_margin * 2, scaled_size - inner_margin * 2, inner_color);
     
     fill_rect(bx + 1, by + 1, scaled_size - 2, 1, highlight);
     
-    if (scale > 0.5f) {
+    if (dot) {
         fill_rect(bx + 2, by + 2, 2, 1, 0xFFFFFF);
     }
 }
 
+/* Recorded ops may point at the sprites, so mid-frame the rest of the frame is drawn directly */
+void invalidate_block_sprites(void) {
+    int i;
+    if (num_sprites > 0 && recording) stop_recording();
+    for (i = 0; i < num_sprites; i++) {
+        SDL_FreeSurface(sprites[i].surface);
+    }
+    num_sprites = 0;
+}
+
+/* Finds or renders the sprite of a block, glow included, NULL if it cannot be made */
+static BlockSprite *block_sprite(int style, Uint32 color, int size, int glow, int margin, int dot) {
+    SDL_Surface *target = screen;
+    int was_recording = recording;
+    BlockSprite *sp;
+    int i;
+    
+    for (i = 0; i < num_sprites; i++) {
+        sp = &sprites[i];
+        if (sp->style == style && sp->color == color && sp->size == size &&
+            sp->glow == glow && sp->margin == margin && sp->dot == dot) {
+            return sp;
+        }
+    }
+    
+    /* A full cache is emptied between frames */
+    if (num_sprites == SPRITE_CACHE_SIZE) return NULL;
+    sp = &sprites[num_sprites];
+    sp->surface = create_screen_surface(size + glow * 2, size + glow * 2);
+    if (!sp->surface) return NULL;
+    
+    screen = sp->surface;
+    recording = 0;
+    if (style == SPRITE_NEON) {
+        render_neon_block(glow, glow, size, color);
+    } else {
+        render_scaled_block(glow, glow, size, glow, margin, dot, color);
+    }
+    recording = was_recording;
+    screen = target;
+    
+    sp->style = style;
+    sp->color = color;
+    sp->size = size;
+    sp->glow = glow;
+    sp->margin = margin;
+    sp->dot = dot;
+    sp->id = next_image_id++;
+    num_sprites++;
+    return sp;
+}
+
+void draw_neon_block(int x, int y, int size, Uint32 color) {
+    BlockSprite *sp = NULL;
+    
+    /* Smaller blocks have negative inner sizes, which SDL stretches to the screen edge */
+    if (size >= 12) sp = block_sprite(SPRITE_NEON, color, size, 3, 0, 0);
+    if (!sp) {
+        render_neon_block(x, y, size, color);
+        return;
+    }
+    draw_image(sp->surface, sp->id, x - 3, y - 3);
+}
+
+void draw_styled_block(int x, int y, int size, Uint32 color) {
+    draw_neon_block(x, y, size, color);
+}
+
+void draw_styled_block_scaled(int x, int y, int size, Uint32 color, float scale) {
+    int scaled_size = (int)(size * scale);
+    int offset = (size - scaled_size) / 2;
+    int glow_size = (int)(2 * scale);
+    int inner_margin = (int)(3 * scale);
+    BlockSprite *sp = NULL;
+    
+    if (inner_margin < 1) inner_margin = 1;
+    if (glow_size >= 0 && scaled_size >= inner_margin * 2 + 2) {
+        sp = block_sprite(SPRITE_SCALED, color, scaled_size, glow_size, inner_margin, scale > 0.5f);
+    }
+    if (!sp) {
+        render_scaled_block(x + offset, y + offset, scaled_size, glow_size, inner_margin, scale > 0.5f, color);
+        return;
+    }
+    draw_image(sp->surface, sp->id, x + offset - glow_size, y + offset - glow_size);
+}
+
 void draw_text(TTF_Font *f, const char *txt, int cx, int cy, Uint32 col_val) {
-    SDL_Color col;
-    SDL_Surface *surface;
-    SDL_Rect dest;
+    if (!txt || !txt[0]) return;
+    
+    if (recording) {
+        record_text(DRAW_TEXT_CENTER, f, txt, cx, cy, col_val);
+        return;
+    }
     
+    blit_text(f, txt, col_val, cx, cy, 1);
+}
+
+void draw_text_left(TTF_Font *f, const char *txt, int x, int y, Uint32 col_val) {
     if (!txt || !txt[0]) return;
     
-    col.r = (col_val >> 16) & 0xFF;
-    col.g = (col_val >> 8) & 0xFF;
-    col.b = col_val & 0xFF;
+    if (recording) {
+        record_text(DRAW_TEXT_LEFT, f, txt, x, y, col_val);
+        return;
+    }
     
-    surface = TTF_RenderUTF8_Blended(f, txt, col);
-    if (!surface) return;
+    blit_text(f, txt, col_val, x, y, 0);
+}
+
+GfxBlock *gfx_block_new(void) {
+    return (GfxBlock*)calloc(1, sizeof(GfxBlock));
+}
+
+void gfx_block_free(GfxBlock *b) {
+    if (!b) return;
+    if (capture == b) capture = NULL;
+    free(b->ops);
+    free(b->text);
+    free(b);
+}
+
+void gfx_block_begin(GfxBlock *b) {
+    b->num_ops = 0;
+    b->text_used = 0;
+    b->complete = recording;
+    capture = b;
+}
+
+int gfx_block_end(void) {
+    GfxBlock *b = capture;
     
-    dest.x = cx - surface->w / 2;
-    dest.y = cy - surface->h / 2;
-    dest.w = surface->w;
-    dest.h = surface->h;
+    capture = NULL;
+    if (!b) return 0;
+    /* Recording stopped on the way: the calls after that were drawn, not kept */
+    if (!recording) b->complete = 0;
+    return b->complete;
+}
+
+void gfx_block_submit(const GfxBlock *b) {
+    int i;
     
-    SDL_BlitSurface(surface, NULL, screen, &dest);
-    SDL_FreeSurface(surface);
+    for (i = 0; i < b->num_ops; i++) {
+        DrawOp op = b->ops[i];
+        int is_text = op.kind == DRAW_TEXT_CENTER || op.kind == DRAW_TEXT_LEFT;
+        const char *txt = is_text ? b->text + op.text : NULL;
+        
+        if (recording) {
+            /* Text boxes were recorded with their overhang */
+            record_op(&op, is_text ? op.w + 4 : op.w, is_text ? op.h + 4 : op.h, txt);
+        } else if (is_text) {
+            blit_text(op.font, txt, op.color, op.x, op.y, op.kind == DRAW_TEXT_CENTER);
+        } else {
+            draw_op(&op, NULL, 0);
+        }
+    }
 }
 
-void draw_text_left(TTF_Font *f, const char *txt, int x, int y, Uint32 col_val) {
-    SDL_Color col;
+void cleanup_graphics(void) {
+    int i, j;
+    
+    invalidate_block_sprites();
+    invalidate_background();
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (text_cache[i].surface) SDL_FreeSurface(text_cache[i].surface);
+        text_cache[i].surface = NULL;
+    }
+    for (i = 0; i < GLYPH_ATLAS_COUNT; i++) {
+        for (j = 0; j < NUM_GLYPHS; j++) {
+            if (glyph_atlases[i].glyphs[j]) SDL_FreeSurface(glyph_atlases[i].glyphs[j]);
+            glyph_atlases[i].glyphs[j] = NULL;
+        }
+        glyph_atlases[i].font = NULL;
+    }
+    free(tile_hashes[0]);
+    free(tile_hashes[1]);
+    free(dirty_rects);
+    tile_hashes[0] = tile_hashes[1] = NULL;
+    dirty_rects = NULL;
+    tile_cols = tile_rows = 0;
+}
+
+void gfx_invalidate(void) {
+    full_redraw = 1;
+}
+
+void gfx_begin_frame(void) {
+    int cols = (screen->w + DRAW_TILE - 1) / DRAW_TILE;
+    int rows = (screen->h + DRAW_TILE - 1) / DRAW_TILE;
+    
+    sync_pixel_format();
+    if (num_sprites == SPRITE_CACHE_SIZE) invalidate_block_sprites();
+    
+    if (cols != tile_cols || rows != tile_rows || !tile_hashes[0]) {
+        free(tile_hashes[0]);
+        free(tile_hashes[1]);
+        free(dirty_rects);
+        tile_hashes[0] = (Uint32*)calloc(cols * rows, sizeof(Uint32));
+        tile_hashes[1] = (Uint32*)calloc(cols * rows, sizeof(Uint32));
+        dirty_rects = (SDL_Rect*)malloc(cols * rows * sizeof(SDL_Rect));
+        tile_cols = cols;
+        tile_rows = rows;
+        full_redraw = 1;
+        if (!tile_hashes[0] || !tile_hashes[1] || !dirty_rects) {
+            tile_cols = tile_rows = 0;
+            return;
+        }
+    }
+    
+    memset(tile_hashes[tile_frame], 0, tile_cols * tile_rows * sizeof(Uint32));
+    num_draw_ops = 0;
+    draw_text_used = 0;
+    recording = 1;
+}
+
+/* Groups the dirty tiles into rectangles: runs along each row, then runs of identical rows */
+static int collect_dirty_rects(void) {
+    const Uint32 *cur = tile_hashes[tile_frame];
+    const Uint32 *prev = tile_hashes[!tile_frame];
+    int num_rects = 0, num_dirty = 0;
+    int tx, ty, i;
+    
+    for (ty = 0; ty < tile_rows; ty++) {
+        int row_start = num_rects;
+        tx = 0;
+        while (tx < tile_cols) {
+            int start;
+            SDL_Rect run;
+            
+            if (!full_redraw && cur[ty * tile_cols + tx] == prev[ty * tile_cols + tx]) {
+                tx++;
+                continue;
+            }
+            start = tx;
+            while (tx < tile_cols && (full_redraw || cur[ty * tile_cols + tx] != prev[ty * tile_cols + tx])) {
+                tx++;
+            }
+            num_dirty += tx - start;
+            
+            run.x = (Sint16)(start * DRAW_TILE);
+            run.y = (Sint16)(ty * DRAW_TILE);
+            run.w = (Uint16)((tx * DRAW_TILE > screen->w ? screen->w : tx * DRAW_TILE) - run.x);
+            run.h = (Uint16)((ty * DRAW_TILE + DRAW_TILE > screen->h ? screen->h : ty * DRAW_TILE + DRAW_TILE) - run.y);
+            
+            /* Extend the same run of the row above instead of adding a rectangle */
+            for (i = 0; i < row_start; i++) {
+                if (dirty_rects[i].x == run.x && dirty_rects[i].w == run.w &&
+                    dirty_rects[i].y + dirty_rects[i].h == run.y) {
+                    dirty_rects[i].h += run.h;
+                    break;
+                }
+            }
+            if (i == row_start) dirty_rects[num_rects++] = run;
+        }
+    }
+    
+    /* Past half the screen one full update is cheaper than many small ones */
+    if (num_dirty * 2 > tile_cols * tile_rows) {
+        dirty_rects[0].x = 0;
+        dirty_rects[0].y = 0;
+        dirty_rects[0].w = (Uint16)screen->w;
+        dirty_rects[0].h = (Uint16)screen->h;
+        return 1;
+    }
+    return num_rects;
+}
+
+/* Parallel replay. The dirty area is cut into horizontal bands that the worker pool rasterizes
+ * straight into the locked screen with the pixel kernels. Workers must not touch SDL state or
+ * the text caches, so the text calls are first resolved to the glyph or string surfaces they
+ * blit, on this thread. */
+#define RASTER_MIN_PIXELS (160 * 160)
+#define RASTER_BANDS_PER_THREAD 2
+#define RASTER_MIN_BAND 16
+#define RASTER_MAX_CMDS (DRAW_MAX_OPS * 2)
+#define RASTER_MAX_OWNED 256
+
+static RasterCmd raster_cmds[RASTER_MAX_CMDS];
+static int num_raster_cmds = 0;
+/* Strings too long for the text cache, freed after the pass */
+static SDL_Surface *raster_owned[RASTER_MAX_OWNED];
+static int num_raster_owned = 0;
+static int num_raster_rects = 0;
+static int raster_top = 0, raster_rows = 0, raster_bands = 0;
+
+static int add_raster_cmd(const RasterCmd *cmd) {
+    if (cmd->src) {
+        const SDL_PixelFormat *f = cmd->src->format;
+        const SDL_PixelFormat *target = screen->format;
+        
+        if (!raster_format_ok(f) || f->Rmask != target->Rmask || f->Gmask != target->Gmask ||
+            f->Bmask != target->Bmask) return 0;
+        if (cmd->kind == RASTER_COPY && (cmd->src->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA))) return 0;
+        if (cmd->kind == RASTER_ALPHA && (f->Aloss != 0 || f->Amask == 0 || f->Ashift % 8 != 0)) return 0;
+    }
+    if (num_raster_cmds == RASTER_MAX_CMDS) return 0;
+    
+    raster_cmds[num_raster_cmds++] = *cmd;
+    return 1;
+}
+
+static int add_raster_alpha(SDL_Surface *src, int x, int y) {
+    RasterCmd cmd;
+    
+    cmd.kind = RASTER_ALPHA;
+    cmd.x = x;
+    cmd.y = y;
+    cmd.w = src->w;
+    cmd.h = src->h;
+    cmd.pixel = 0;
+    cmd.pixel2 = 0;
+    cmd.src = src;
+    return add_raster_cmd(&cmd);
+}
+
+static int add_raster_text(const DrawOp *op) {
+    const char *txt = draw_text_arena + op->text;
+    int centered = op->kind == DRAW_TEXT_CENTER;
+    SDL_Surface *glyphs[TEXT_CACHE_LEN];
     SDL_Surface *surface;
-    SDL_Rect dest;
+    int x = op->x, y = op->y;
+    int n, w;
     
-    if (!txt || !txt[0]) return;
+    n = glyph_run(op->font, txt, op->color, glyphs, &w);
+    if (n > 0) {
+        int i;
+        if (centered) {
+            x -= w / 2;
+            y -= glyphs[0]->h / 2;
+        }
+        for (i = 0; i < n; i++) {
+            if (!add_raster_alpha(glyphs[i], x, y)) return 0;
+            x += glyphs[i]->w;
+        }
+        return 1;
+    }
     
-    col.r = (col_val >> 16) & 0xFF;
-    col.g = (col_val >> 8) & 0xFF;
-    col.b = col_val & 0xFF;
+    surface = cached_text(op->font, txt, op->color);
+    if (!surface) {
+        surface = render_text(op->font, txt, op->color);
+        if (!surface) return 1;
+        if (num_raster_owned == RASTER_MAX_OWNED) {
+            SDL_FreeSurface(surface);
+            return 0;
+        }
+        raster_owned[num_raster_owned++] = surface;
+    }
+    if (centered) {
+        x -= surface->w / 2;
+        y -= surface->h / 2;
+    }
+    return add_raster_alpha(surface, x, y);
+}
+
+/* Turns the recorded calls that touch the dirty area into raster commands, 0 if one of them
+ * cannot be rasterized here */
+static int build_raster_cmds(void) {
+    int i, j;
+    
+    num_raster_cmds = 0;
+    for (i = 0; i < num_draw_ops; i++) {
+        const DrawOp *op = &draw_ops[i];
+        RasterCmd cmd;
+        int ok;
+        
+        for (j = 0; j < num_raster_rects; j++) {
+            if (rects_overlap(&op->area, &dirty_rects[j])) break;
+        }
+        if (j == num_raster_rects) continue;
+        
+        if (op->kind == DRAW_TEXT_CENTER || op->kind == DRAW_TEXT_LEFT) {
+            ok = add_raster_text(op);
+        } else {
+            op_raster_cmd(op, &cmd);
+            ok = add_raster_cmd(&cmd);
+        }
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+static void raster_band(void *ctx, int index) {
+    int band_y0 = raster_top + raster_rows * index / raster_bands;
+    int band_y1 = raster_top + raster_rows * (index + 1) / raster_bands;
+    int i, j;
+    (void)ctx;
+    
+    for (i = 0; i < num_raster_rects; i++) {
+        const SDL_Rect *r = &dirty_rects[i];
+        int y0 = r->y > band_y0 ? r->y : band_y0;
+        int y1 = r->y + r->h < band_y1 ? r->y + r->h : band_y1;
+        
+        if (y0 >= y1) continue;
+        raster_fill((Uint8 *)screen->pixels + y0 * screen->pitch + r->x * 4, screen->pitch, r->w, y1 - y0, 0);
+        for (j = 0; j < num_raster_cmds; j++) {
+            raster_cmd(&raster_cmds[j], r->x, y0, r->x + r->w, y1);
+        }
+    }
+}
+
+/* Replays the frame on the worker pool, 0 when it has to be done the serial way */
+static int replay_parallel(int num_rects) {
+    int threads = solver_pool ? thread_pool_size(solver_pool) : 1;
+    int pixels = 0, bottom = 0;
+    int i, ok;
+    
+    if (threads < 2 || !raster_format_ok(screen->format)) return 0;
     
-    surface = TTF_RenderUTF8_Blended(f, txt, col);
-    if (!surface) return;
+    raster_top = screen->h;
+    for (i = 0; i < num_rects; i++) {
+        pixels += dirty_rects[i].w * dirty_rects[i].h;
+        if (dirty_rects[i].y < raster_top) raster_top = dirty_rects[i].y;
+        if (dirty_rects[i].y + dirty_rects[i].h > bottom) bottom = dirty_rects[i].y + dirty_rects[i].h;
+    }
+    if (pixels < RASTER_MIN_PIXELS) return 0;
     
-    dest.x = x;
-    dest.y = y;
-    dest.w = surface->w;
-    dest.h = surface->h;
+    num_raster_rects = num_rects;
+    num_raster_owned = 0;
+    text_pinned = text_clock;
+    ok = build_raster_cmds();
+    text_pinned = 0;
     
-    SDL_BlitSurface(surface, NULL, screen, &dest);
-    SDL_FreeSurface(surface);
+    if (ok && SDL_LockSurface(screen) == 0) {
+        raster_rows = bottom - raster_top;
+        raster_bands = threads * RASTER_BANDS_PER_THREAD;
+        if (raster_bands > raster_rows / RASTER_MIN_BAND) raster_bands = raster_rows / RASTER_MIN_BAND;
+        if (raster_bands < 1) raster_bands = 1;
+        thread_pool_run(solver_pool, raster_band, NULL, raster_bands);
+        SDL_UnlockSurface(screen);
+    } else {
+        ok = 0;
+    }
+    
+    for (i = 0; i < num_raster_owned; i++) {
+        SDL_FreeSurface(raster_owned[i]);
+    }
+    num_raster_owned = 0;
+    return ok;
 }
 
-void draw_cyberpunk_background_responsive(void) {
+int gfx_end_frame(void) {
+    int num_rects, i;
+    
+    if (!recording) {
+        SDL_Flip(screen);
+        full_redraw = 1;
+        return 1;
+    }
+    recording = 0;
+    
+    num_rects = collect_dirty_rects();
+    if (num_rects > 0) {
+        if (!replay_parallel(num_rects)) {
+            for (i = 0; i < num_rects; i++) {
+                SDL_FillRect(screen, &dirty_rects[i], 0);
+            }
+            for (i = 0; i < num_draw_ops; i++) {
+                draw_op(&draw_ops[i], dirty_rects, num_rects);
+            }
+        }
+        SDL_UpdateRects(screen, num_rects, dirty_rects);
+    }
+    
+    full_redraw = 0;
+    tile_frame = !tile_frame;
+    return num_rects;
+}
+
+static void render_background(void) {
     int i, j;
     int grid_spacing = 60;
     
     draw_gradient_v(0, 0, window_w, window_h, COLOR_BG, COLOR_BG_DARK);
     
     for (i = 0; i < window_h; i += 3) {
-        fill_rect(0, i, window_w, 1, darken_color(COLOR_BG, 0.8f));
+        blend_rect(0, i, window_w, 1, 0x000000, 0.2f);
     }
     
     for (i = 0; i < window_w; i += grid_spacing) {
-        fill_rect(i - 1, 0, 1, window_h, darken_color(COLOR_NEON_CYAN, 0.05f));
-        fill_rect(i + 1, 0, 1, window_h, darken_color(COLOR_NEON_CYAN, 0.05f));
-        fill_rect(i, 0, 1, window_h, darken_color(COLOR_NEON_CYAN, 0.15f));
+        add_rect(i - 1, 0, 1, window_h, COLOR_NEON_CYAN, 0.05f);
+        add_rect(i + 1, 0, 1, window_h, COLOR_NEON_CYAN, 0.05f);
+        add_rect(i, 0, 1, window_h, COLOR_NEON_CYAN, 0.15f);
     }
     
     for (j = 0; j < window_h; j += grid_spacing) {
-        fill_rect(0, j - 1, window_w, 1, darken_color(COLOR_NEON_MAGENTA, 0.05f));
-        fill_rect(0, j + 1, window_w, 1, darken_color(COLOR_NEON_MAGENTA, 0.05f));
-        fill_rect(0, j, window_w, 1, darken_color(COLOR_NEON_MAGENTA, 0.15f));
+        add_rect(0, j - 1, window_w, 1, COLOR_NEON_MAGENTA, 0.05f);
+        add_rect(0, j + 1, window_w, 1, COLOR_NEON_MAGENTA, 0.05f);
+        add_rect(0, j, window_w, 1, COLOR_NEON_MAGENTA, 0.15f);
     }
     
     fill_rect(10, 10, 50, 2, COLOR_NEON_CYAN);
@@ -235,7 +1395,37 @@ void draw_cyberpunk_background_responsive(void) {
     fill_rect(window_w - 12, window_h - 40, 2, 30, COLOR_NEON_MAGENTA);
 }
 
-void render_effects(EffectsManager *em, int offset_x, int offset_y) {
+void invalidate_background(void) {
+    if (background && recording) stop_recording();
+    if (background) SDL_FreeSurface(background);
+    background = NULL;
+}
+
+void draw_cyberpunk_background_responsive(void) {
+    if (!background || background->w != window_w || background->h != window_h) {
+        SDL_Surface *target = screen;
+        int was_recording;
+        
+        invalidate_background();
+        was_recording = recording;
+        background = create_screen_surface(window_w, window_h);
+        if (!background) {
+            render_background();
+            return;
+        }
+        
+        screen = background;
+        recording = 0;
+        render_background();
+        recording = was_recording;
+        screen = target;
+        background_id = next_image_id++;
+    }
+    
+    draw_image(background, background_id, 0, 0);
+}
+
+void render_effects(EffectsManager *em, int grid_size, int offset_x, int offset_y) {
     int i;
     
     for (i = 0; i < MAX_PARTICLES; i++) {
@@ -249,15 +1439,8 @@ void render_effects(EffectsManager *em, int offset_x, int offset_y) {
             int px = (int)p->x + offset_x;
             int py = (int)p->y + offset_y;
             
-            Uint32 glow_color = darken_color(color, alpha * 0.3f);
-            fill_rect(px - p->size, py - p->size, p->size * 2, p->size * 2, glow_color);
-            
-            int r = (int)(((color >> 16) & 0xFF) * alpha);
-            int g = (int)(((color >> 8) & 0xFF) * alpha);
-            int b = (int)((color & 0xFF) * alpha);
-            Uint32 core_color = (r << 16) | (g << 8) | b;
-            
-            fill_rect(px - p->size/2, py - p->size/2, p->size, p->size, core_color);
+            add_rect(px - p->size, py - p->size, p->size * 2, p->size * 2, color, alpha * 0.3f);
+            blend_rect(px - p->size/2, py - p->size/2, p->size, p->size, color, alpha);
             
             if (alpha > 0.5f) {
                 int center_size = p->size / 3;
@@ -278,18 +1461,16 @@ void render_effects(EffectsManager *em, int offset_x, int offset_y) {
             Uint32 flash_color = flash_colors[i % 3];
             
             if (lc->row >= 0) {
-                int sweep_pos = (int)(progress * GRID_W * BLOCK_SIZE);
-                int flash_width = (int)(GRID_W * BLOCK_SIZE * (1.0f - progress * 0.5f));
+                int sweep_pos = (int)(progress * grid_size * BLOCK_SIZE);
+                int flash_width = (int)(grid_size * BLOCK_SIZE * (1.0f - progress * 0.5f));
                 
-                Uint32 glow = darken_color(flash_color, intensity * 0.4f);
-                fill_rect(GRID_OFFSET_X + offset_x - 5, 
-                          GRID_OFFSET_Y + lc->row * BLOCK_SIZE + offset_y - 5,
-                          GRID_W * BLOCK_SIZE + 10, BLOCK_SIZE + 10, glow);
+                add_rect(GRID_OFFSET_X + offset_x - 5, 
+                         GRID_OFFSET_Y + lc->row * BLOCK_SIZE + offset_y - 5,
+                         grid_size * BLOCK_SIZE + 10, BLOCK_SIZE + 10, flash_color, intensity * 0.4f);
                 
-                Uint32 main_flash = darken_color(flash_color, intensity * 0.8f);
-                fill_rect(GRID_OFFSET_X + offset_x, 
-                          GRID_OFFSET_Y + lc->row * BLOCK_SIZE + offset_y,
-                          flash_width, BLOCK_SIZE, main_flash);
+                add_rect(GRID_OFFSET_X + offset_x, 
+                         GRID_OFFSET_Y + lc->row * BLOCK_SIZE + offset_y,
+                         flash_width, BLOCK_SIZE, flash_color, intensity * 0.8f);
                 
                 if (progress < 0.8f) {
                     fill_rect(GRID_OFFSET_X + offset_x + sweep_pos - 5, 
@@ -298,18 +1479,16 @@ void render_effects(EffectsManager *em, int offset_x, int offset_y) {
                 }
             }
             if (lc->col >= 0) {
-                int sweep_pos = (int)(progress * GRID_H * BLOCK_SIZE);
-                int flash_height = (int)(GRID_H * BLOCK_SIZE * (1.0f - progress * 0.5f));
+                int sweep_pos = (int)(progress * grid_size * BLOCK_SIZE);
+                int flash_height = (int)(grid_size * BLOCK_SIZE * (1.0f - progress * 0.5f));
                 
-                Uint32 glow = darken_color(flash_color, intensity * 0.4f);
-                fill_rect(GRID_OFFSET_X + lc->col * BLOCK_SIZE + offset_x - 5,
-                          GRID_OFFSET_Y + offset_y - 5,
-                          BLOCK_SIZE + 10, GRID_H * BLOCK_SIZE + 10, glow);
+                add_rect(GRID_OFFSET_X + lc->col * BLOCK_SIZE + offset_x - 5,
+                         GRID_OFFSET_Y + offset_y - 5,
+                         BLOCK_SIZE + 10, grid_size * BLOCK_SIZE + 10, flash_color, intensity * 0.4f);
                 
-                Uint32 main_flash = darken_color(flash_color, intensity * 0.8f);
-                fill_rect(GRID_OFFSET_X + lc->col * BLOCK_SIZE + offset_x,
-                          GRID_OFFSET_Y + offset_y,
-                          BLOCK_SIZE, flash_height, main_flash);
+                add_rect(GRID_OFFSET_X + lc->col * BLOCK_SIZE + offset_x,
+                         GRID_OFFSET_Y + offset_y,
+                         BLOCK_SIZE, flash_height, flash_color, intensity * 0.8f);
                 
                 if (progress < 0.8f) {
                     fill_rect(GRID_OFFSET_X + lc->col * BLOCK_SIZE + offset_x,
@@ -331,13 +1510,14 @@ void render_effects(EffectsManager *em, int offset_x, int offset_y) {
             float ring_alpha = pe->alpha;
             
             if (ring_size > 0 && ring_alpha > 0) {
-                Uint32 ring_color = darken_color(pe->color, ring_alpha * 0.6f);
-                
+                float amount = ring_alpha * 0.6f;
                 int half = ring_size;
-                fill_rect(px - half, py - half, ring_size * 2, 2, ring_color);
-                fill_rect(px - half, py + half - 2, ring_size * 2, 2, ring_color);
-                fill_rect(px - half, py - half, 2, ring_size * 2, ring_color);
-                fill_rect(px + half - 2, py - half, 2, ring_size * 2, ring_color);
+                
+                /* The sides stop short of the corners so that nothing is added twice */
+                add_rect(px - half, py - half, ring_size * 2, 2, pe->color, amount);
+                add_rect(px - half, py + half - 2, ring_size * 2, 2, pe->color, amount);
+                add_rect(px - half, py - half + 2, 2, ring_size * 2 - 4, pe->color, amount);
+                add_rect(px + half - 2, py - half + 2, 2, ring_size * 2 - 4, pe->color, amount);
             }
         }
     }
@@ -5,6 +5,8 @@
 #include <SDL_ttf.h>
 #include "game.h"
 
+/* Pixels are mapped once per screen format and cached; the colour math works in 1/256 steps
+ * through lookup tables */
 Uint32 get_pixel(int r, int g, int b);
 Uint32 color_to_pixel(Uint32 color);
 Uint32 blend_colors(Uint32 c1, Uint32 c2, float t);
@@ -14,19 +16,49 @@ Uint32 lighten_color(Uint32 color, float factor);
 void fill_rect(int x, int y, int w, int h, Uint32 color);
 void draw_gradient_v(int x, int y, int w, int h, Uint32 color_top, Uint32 color_bottom);
 void draw_gradient_h(int x, int y, int w, int h, Uint32 color_left, Uint32 color_right);
+/* Translucency over what is already drawn: alpha blended, or light added with saturation */
+void blend_rect(int x, int y, int w, int h, Uint32 color, float alpha);
+void add_rect(int x, int y, int w, int h, Uint32 color, float amount);
+/* size rings of color around a rectangle, fading out from strength */
+void draw_glow(int x, int y, int w, int h, Uint32 color, int size, float strength);
 
 void draw_neon_border(int x, int y, int w, int h, Uint32 color, int glow_size);
 void draw_neon_rect(int x, int y, int w, int h, Uint32 bg_color, Uint32 border_color, int glow_size);
 void draw_neon_block(int x, int y, int size, Uint32 color);
 void draw_styled_block(int x, int y, int size, Uint32 color);
 void draw_styled_block_scaled(int x, int y, int size, Uint32 color, float scale);
+/* Blocks are drawn from sprites rendered once per colour and size */
+void invalidate_block_sprites(void);
 
 void draw_text(TTF_Font *f, const char *txt, int cx, int cy, Uint32 col_val);
 void draw_text_left(TTF_Font *f, const char *txt, int x, int y, Uint32 col_val);
 
+/* Frees the cached text, sprites and background, before the fonts are closed */
+void cleanup_graphics(void);
+
+/* Drawn once per window size into an offscreen surface, then copied */
 void draw_cyberpunk_background_responsive(void);
+void invalidate_background(void);
+
+/* Frames are drawn between these two: only the screen tiles that differ from the previous
+ * frame are redrawn and presented, gfx_end_frame() returns 0 when there were none.
+ * gfx_invalidate() forces the next frame out in full. */
+void gfx_begin_frame(void);
+int gfx_end_frame(void);
+void gfx_invalidate(void);
+
+/* Draw calls made between gfx_block_begin() and gfx_block_end() are also kept in the block,
+ * and gfx_block_submit() makes them again as they were on a later frame. gfx_block_end()
+ * returns 0 when the block could not keep them all: images, or calls made outside of a frame.
+ * Blocks hold mapped pixels, they are redrawn when the screen changes. */
+typedef struct GfxBlock GfxBlock;
+GfxBlock *gfx_block_new(void);
+void gfx_block_free(GfxBlock *b);
+void gfx_block_begin(GfxBlock *b);
+int gfx_block_end(void);
+void gfx_block_submit(const GfxBlock *b);
 
-void render_effects(EffectsManager *em, int offset_x, int offset_y);
+void render_effects(EffectsManager *em, int grid_size, int offset_x, int offset_y);
 
 int point_in_rect(int px, int py, int x, int y, int w, int h);
 
@@ -5,336 +5,305 @@
 #include "save_system.h"
 #include "ui_components.h"
 #include "net_client.h"
+#include "screens.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#define DUEL_SECONDS 180
+/* Bot search time per frame, so the duel never holds a frame up */
+#define DUEL_SLICE_MS 4
+/* Hint search time per frame: a hint on a large board takes several frames */
+#define HINT_SLICE_MS 4
+
+/* The hint being searched and the position it was asked on */
+static SolverTask *hint_task;
+static GameSnapshot hint_position;
+
+static void open_settings(void) {
+    show_settings_overlay = 1;
+    settings_tab = 0;
+}
+
 void handle_menu_click(void) {
-    int center_x = window_w / 2;
-    int btn_y = 250;
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     
-    if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        return;
-    }
+    if (!w) return;
+    play_click();
     
-    if (has_saved_game) {
-        if (point_in_rect(mouse_x, mouse_y, center_x - 150, btn_y, 300, 55)) {
-            play_click();
-            if (load_current_game()) {
-                current_state = ST_SOLO;
-            } else {
+    switch (w->action) {
+        case ACT_SETTINGS:
+            open_settings();
+            break;
+        case ACT_CONTINUE:
+            hint_visible = 0;
+            if (!load_current_game()) {
                 delete_saved_game();
                 init_game(&game);
-                current_state = ST_SOLO;
             }
-            return;
-        }
-        btn_y += 70;
-    }
-    
-    if (point_in_rect(mouse_x, mouse_y, center_x - 150, btn_y, 300, 55)) {
-        play_click();
-        delete_saved_game();
-        init_game(&game);
-        current_state = ST_SOLO;
-        return;
-    }
-    btn_y += 70;
-    
-    if (point_in_rect(mouse_x, mouse_y, center_x - 150, btn_y, 300, 55)) {
-        play_click();
-        if (net_connect(online_ip, online_port)) {
-            memset(input_buffer, 0, sizeof(input_buffer));
-            current_state = ST_LOGIN;
-        } else {
-            strcpy(popup_msg, "Impossible de se connecter au serveur!");
-        }
-        return;
-    }
-    btn_y += 70;
-    
-    if (point_in_rect(mouse_x, mouse_y, center_x - 150, btn_y, 300, 55)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        strcpy(edit_ip, online_ip);
-        snprintf(edit_port, sizeof(edit_port), "%d", online_port);
-        active_input = 0;
+            undo_reset(&solo_history, &game);
+            current_state = ST_SOLO;
+            break;
+        case ACT_NEW_GAME:
+            delete_saved_game();
+            init_game(&game);
+            undo_reset(&solo_history, &game);
+            hint_visible = 0;
+            current_state = ST_SOLO;
+            break;
+        case ACT_DUEL:
+            start_bot_duel();
+            break;
+        case ACT_BOT_LEVEL:
+            selected_bot_level = (selected_bot_level + 1) % NUM_BOT_LEVELS;
+            break;
+        case ACT_ONLINE:
+            if (net_connect(online_ip, online_port)) {
+                memset(input_buffer, 0, sizeof(input_buffer));
+                current_state = ST_LOGIN;
+            } else {
+                strcpy(popup_msg, "Impossible de se connecter au serveur!");
+            }
+            break;
+        case ACT_OPTIONS:
+            open_settings();
+            strcpy(edit_ip, online_ip);
+            snprintf(edit_port, sizeof(edit_port), "%d", online_port);
+            active_input = 0;
+            break;
     }
 }
 
 void handle_options_click(void) {
-    if (point_in_rect(mouse_x, mouse_y, 70, 210, 400, 50)) {
-        play_click();
-        active_input = 1;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, 70, 330, 400, 50)) {
-        play_click();
-        active_input = 2;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, 70, 480, 180, 50)) {
-        play_click();
-        test_result = perform_connection_test() ? 1 : -1;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, 290, 480, 180, 50) && test_result == 1) {
-        play_click();
-        strcpy(online_ip, edit_ip);
-        online_port = atoi(edit_port);
-        strcpy(popup_msg, "Configuration sauvegardee!");
-    }
-    else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 580, 180, 50)) {
-        play_click();
-        current_state = ST_MENU;
+    const Widget *w = ui_hit(mouse_x, mouse_y);
+    
+    if (!w) return;
+    play_click();
+    
+    switch (w->action) {
+        case ACT_EDIT_IP:
+            active_input = 1;
+            break;
+        case ACT_EDIT_PORT:
+            active_input = 2;
+            break;
+        case ACT_TEST:
+            test_result = perform_connection_test() ? 1 : -1;
+            break;
+        case ACT_SAVE:
+            strcpy(online_ip, edit_ip);
+            online_port = atoi(edit_port);
+            strcpy(popup_msg, "Configuration sauvegardee!");
+            break;
+        case ACT_BACK:
+            current_state = ST_MENU;
+            break;
     }
 }
 
 void handle_login_click(void) {
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     Packet pkt;
     
-    if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        return;
-    }
+    if (!w || w->action == ACT_NONE) return;
+    play_click();
     
-    if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 420, 180, 50) && strlen(input_buffer) > 0) {
-        play_click();
-        strcpy(my_pseudo, input_buffer);
-        
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.type = MSG_LOGIN;
-        strcpy(pkt.text, my_pseudo);
-        net_send(&pkt);
-        
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.type = MSG_LEADERBOARD_REQ;
-        net_send(&pkt);
-        
-        memset(input_buffer, 0, sizeof(input_buffer));
-        current_state = ST_MULTI_CHOICE;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 500, 180, 50)) {
-        play_click();
-        net_close();
-        current_state = ST_MENU;
+    switch (w->action) {
+        case ACT_SETTINGS:
+            open_settings();
+            break;
+        case ACT_VALIDATE:
+            strcpy(my_pseudo, input_buffer);
+            
+            memset(&pkt, 0, sizeof(pkt));
+            pkt.type = MSG_LOGIN;
+            strcpy(pkt.text, my_pseudo);
+            net_send(&pkt);
+            
+            memset(&pkt, 0, sizeof(pkt));
+            pkt.type = MSG_LEADERBOARD_REQ;
+            net_send(&pkt);
+            
+            memset(input_buffer, 0, sizeof(input_buffer));
+            current_state = ST_MULTI_CHOICE;
+            break;
+        case ACT_BACK:
+            net_close();
+            current_state = ST_MENU;
+            break;
     }
 }
 
 void handle_multi_choice_click(void) {
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     Packet pkt;
     
-    if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        return;
-    }
+    if (!w) return;
+    play_click();
     
-    if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 150, 400, 300, 55)) {
-        play_click();
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.type = MSG_CREATE_ROOM;
-        net_send(&pkt);
-        
-        selected_game_mode = GAME_MODE_CLASSIC;
-        selected_timer_minutes = 3;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 150, 475, 300, 55)) {
-        play_click();
-        memset(input_buffer, 0, sizeof(input_buffer));
-        current_state = ST_JOIN_INPUT;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 150, 550, 300, 55)) {
-        play_click();
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.type = MSG_SERVER_LIST_REQ;
-        net_send(&pkt);
-        browser_scroll_offset = 0;
-        current_state = ST_SERVER_BROWSER;
-    }
-    else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 640, 180, 50)) {
-        play_click();
-        net_close();
-        current_state = ST_MENU;
+    switch (w->action) {
+        case ACT_SETTINGS:
+            open_settings();
+            break;
+        case ACT_CREATE_ROOM:
+            memset(&pkt, 0, sizeof(pkt));
+            pkt.type = MSG_CREATE_ROOM;
+            net_send(&pkt);
+            
+            selected_game_mode = GAME_MODE_CLASSIC;
+            selected_timer_minutes = 3;
+            break;
+        case ACT_JOIN_CODE:
+            memset(input_buffer, 0, sizeof(input_buffer));
+            current_state = ST_JOIN_INPUT;
+            break;
+        case ACT_SERVERS:
+            memset(&pkt, 0, sizeof(pkt));
+            pkt.type = MSG_SERVER_LIST_REQ;
+            net_send(&pkt);
+            browser_scroll_offset = 0;
+            current_state = ST_SERVER_BROWSER;
+            break;
+        case ACT_BACK:
+            net_close();
+            current_state = ST_MENU;
+            break;
     }
 }
 
 void handle_join_input_click(void) {
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     Packet pkt;
     
-    if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        return;
-    }
+    if (!w || w->action == ACT_NONE) return;
+    play_click();
     
-    if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 420, 180, 50) && strlen(input_buffer) == 4) {
-        play_click();
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.type = MSG_JOIN_ROOM;
-        strcpy(pkt.text, input_buffer);
-        net_send(&pkt);
-    }
-    else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 500, 180, 50)) {
-        play_click();
-        current_state = ST_MULTI_CHOICE;
+    switch (w->action) {
+        case ACT_SETTINGS:
+            open_settings();
+            break;
+        case ACT_VALIDATE:
+            memset(&pkt, 0, sizeof(pkt));
+            pkt.type = MSG_JOIN_ROOM;
+            strcpy(pkt.text, input_buffer);
+            net_send(&pkt);
+            break;
+        case ACT_BACK:
+            current_state = ST_MULTI_CHOICE;
+            break;
     }
 }
 
 void handle_lobby_click(void) {
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     Packet pkt;
-    int mode_y = 320;
-    int toggle_y = selected_game_mode == GAME_MODE_RUSH ? mode_y + 150 : mode_y + 80;
-    int need_players = current_lobby.player_count < 2 - current_lobby.spectator_count;
-    int start_y = selected_game_mode == GAME_MODE_RUSH ? 530 : 470;
-    if (need_players) start_y += 40;
     
-    if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        return;
-    }
+    if (!w || w->action == ACT_KICK) return;
+    play_click();
+    memset(&pkt, 0, sizeof(pkt));
     
-    if (current_lobby.is_host && !current_lobby.game_started) {
-        if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 160, mode_y + 25, 150, 35)) {
-            play_click();
-            selected_game_mode = GAME_MODE_CLASSIC;
-            memset(&pkt, 0, sizeof(pkt));
+    switch (w->action) {
+        case ACT_SETTINGS:
+            open_settings();
+            break;
+        case ACT_MODE:
+            selected_game_mode = w->arg;
             pkt.type = MSG_SET_GAME_MODE;
-            pkt.game_mode = GAME_MODE_CLASSIC;
+            pkt.game_mode = selected_game_mode;
+            if (selected_game_mode == GAME_MODE_RUSH) {
+                pkt.timer_value = selected_timer_minutes * 60;
+            }
             net_send(&pkt);
-        }
-        else if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 + 10, mode_y + 25, 150, 35)) {
-            play_click();
-            selected_game_mode = GAME_MODE_RUSH;
-            memset(&pkt, 0, sizeof(pkt));
-            pkt.type = MSG_SET_GAME_MODE;
-            pkt.game_mode = GAME_MODE_RUSH;
+            break;
+        case ACT_TIMER:
+            selected_timer_minutes = w->arg;
+            pkt.type = MSG_SET_TIMER;
             pkt.timer_value = selected_timer_minutes * 60;
             net_send(&pkt);
-        }
-        
-        if (selected_game_mode == GAME_MODE_RUSH) {
-            int timer_buttons[] = {1, 2, 3, 5, 10};
-            int timer_x[] = {WINDOW_W / 2 - 200, WINDOW_W / 2 - 130, WINDOW_W / 2 - 60, 
-                            WINDOW_W / 2 + 10, WINDOW_W / 2 + 80};
-            int i;
-            for (i = 0; i < 5; i++) {
-                if (point_in_rect(mouse_x, mouse_y, timer_x[i], mode_y + 100, 55, 30)) {
-                    play_click();
-                    selected_timer_minutes = timer_buttons[i];
-                    memset(&pkt, 0, sizeof(pkt));
-                    pkt.type = MSG_SET_TIMER;
-                    pkt.timer_value = selected_timer_minutes * 60;
-                    net_send(&pkt);
-                    break;
-                }
-            }
-        }
-        
-        if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, toggle_y, 180, 35)) {
-            play_click();
-            memset(&pkt, 0, sizeof(pkt));
+            break;
+        case ACT_VISIBILITY:
             pkt.type = MSG_SET_GAME_MODE;
             pkt.game_mode = selected_game_mode;
             pkt.lobby.is_public = !current_lobby.is_public;
             net_send(&pkt);
-        }
-        
-        if (!need_players && point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 150, start_y, 300, 55)) {
-            play_click();
-            memset(&pkt, 0, sizeof(pkt));
+            break;
+        case ACT_GRID_SMALLER:
+        case ACT_GRID_BIGGER:
+            pkt.type = MSG_SET_GRID_SIZE;
+            pkt.grid_size = current_lobby.grid_size + (w->action == ACT_GRID_BIGGER ? 1 : -1);
+            net_send(&pkt);
+            break;
+        case ACT_RULESET:
+            pkt.type = MSG_SET_RULESET;
+            pkt.ruleset = (current_lobby.ruleset + 1) % NUM_RULESETS;
+            net_send(&pkt);
+            break;
+        case ACT_ADD_BOT:
+            pkt.type = MSG_ADD_BOT;
+            pkt.bot_level = selected_bot_level;
+            net_send(&pkt);
+            break;
+        case ACT_BOT_LEVEL:
+            selected_bot_level = (selected_bot_level + 1) % NUM_BOT_LEVELS;
+            break;
+        case ACT_START:
             pkt.type = MSG_START_GAME;
             pkt.game_mode = selected_game_mode;
             pkt.timer_value = selected_timer_minutes * 60;
             net_send(&pkt);
-        }
-    }
-    
-    if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 660, 180, 50)) {
-        play_click();
-        net_close();
-        current_state = ST_MENU;
-        is_spectator = 0;
+            break;
+        case ACT_BACK:
+            net_close();
+            current_state = ST_MENU;
+            is_spectator = 0;
+            break;
     }
 }
 
 void handle_lobby_right_click(void) {
-    int i;
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     Packet pkt;
     
-    if (!current_lobby.is_host) return;
+    if (!w || w->action != ACT_KICK) return;
     
-    for (i = 1; i < current_lobby.player_count; i++) {
-        if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 100, 190 + i * 40, 200, 30)) {
-            memset(&pkt, 0, sizeof(pkt));
-            pkt.type = MSG_KICK_PLAYER;
-            strcpy(pkt.text, current_lobby.players[i]);
-            net_send(&pkt);
-            break;
-        }
-    }
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.type = MSG_KICK_PLAYER;
+    strcpy(pkt.text, current_lobby.players[w->arg]);
+    net_send(&pkt);
 }
 
 void handle_server_browser_click(void) {
+    const Widget *w = ui_hit(mouse_x, mouse_y);
     Packet pkt;
-    int i;
-    int y_start = 160;
-    int entry_height = 110;
-    
-    if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-        play_click();
-        show_settings_overlay = 1;
-        settings_tab = 0;
-        return;
-    }
     
-    if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 680, 180, 45)) {
-        play_click();
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.type = MSG_SERVER_LIST_REQ;
-        net_send(&pkt);
-        return;
-    }
+    if (!w) return;
+    play_click();
+    memset(&pkt, 0, sizeof(pkt));
     
-    for (i = 0; i < server_list.count && i < 5; i++) {
-        int idx = i + browser_scroll_offset;
-        if (idx >= server_list.count) break;
-        
-        ServerInfo *srv = &server_list.servers[idx];
-        int y = y_start + i * entry_height;
-        
-        if (!srv->game_started && point_in_rect(mouse_x, mouse_y, WINDOW_W - 140, y + 10, 100, 35)) {
-            play_click();
-            memset(&pkt, 0, sizeof(pkt));
+    switch (w->action) {
+        case ACT_SETTINGS:
+            open_settings();
+            break;
+        case ACT_REFRESH:
+            pkt.type = MSG_SERVER_LIST_REQ;
+            net_send(&pkt);
+            break;
+        case ACT_JOIN:
             pkt.type = MSG_JOIN_ROOM;
-            strcpy(pkt.text, srv->room_code);
+            strcpy(pkt.text, server_list.servers[w->arg].room_code);
             is_spectator = 0;
             net_send(&pkt);
-            return;
-        }
-        
-        if (point_in_rect(mouse_x, mouse_y, WINDOW_W - 140, y + 52, 100, 35)) {
-            play_click();
-            memset(&pkt, 0, sizeof(pkt));
+            break;
+        case ACT_WATCH:
             pkt.type = MSG_JOIN_SPECTATE;
-            strcpy(pkt.text, srv->room_code);
+            strcpy(pkt.text, server_list.servers[w->arg].room_code);
             is_spectator = 1;
             spectate_view_idx = 0;
             net_send(&pkt);
-            return;
-        }
-    }
-    
-    if (point_in_rect(mouse_x, mouse_y, WINDOW_W / 2 - 90, 735, 180, 45)) {
-        play_click();
-        current_state = ST_MULTI_CHOICE;
+            break;
+        case ACT_BACK:
+            current_state = ST_MULTI_CHOICE;
+            break;
     }
 }
 
@@ -346,6 +315,12 @@ void handle_server_browser_scroll(int direction) {
     }
 }
 
+/* The grid cell the dragged piece's top-left block would drop on */
+void dragged_piece_anchor(const Piece *p, int *row, int *col) {
+    *col = (mouse_x - grid_offset_x - (piece_w(p) * block_size) / 2 + block_size / 2) / block_size;
+    *row = (mouse_y - grid_offset_y - (piece_h(p) * block_size) / 2 + block_size / 2) / block_size;
+}
+
 void handle_game_click(int is_multi) {
     Packet pkt;
     int grid_x, grid_y;
@@ -356,12 +331,13 @@ void handle_game_click(int is_multi) {
     if (selected_piece_idx >= 0) {
         Piece *p = &game.current_pieces[selected_piece_idx];
         
-        grid_x = (mouse_x - grid_offset_x - (p->w * block_size) / 2 + block_size / 2) / block_size;
-        grid_y = (mouse_y - grid_offset_y - (p->h * block_size) / 2 + block_size / 2) / block_size;
+        dragged_piece_anchor(p, &grid_y, &grid_x);
         
         if (can_place(&game, grid_y, grid_x, p)) {
+            Piece placed = *p;
             place_piece_logic(&game, grid_y, grid_x, p);
             game.pieces_available[selected_piece_idx] = 0;
+            hint_visible = 0;
             
             if (game.num_cleared_rows > 0 || game.num_cleared_cols > 0) {
                 play_clear();
@@ -384,8 +360,11 @@ void handle_game_click(int is_multi) {
             if (is_multi) {
                 memset(&pkt, 0, sizeof(pkt));
                 pkt.type = MSG_PLACE_PIECE;
-                memcpy(pkt.grid_data, game.grid, sizeof(game.grid));
                 pkt.score = game.score;
+                pkt.piece_id = placed.id;
+                pkt.piece_row = grid_y;
+                pkt.piece_col = grid_x;
+                pkt.state_hash = game.hash;
                 net_send(&pkt);
                 
                 if (current_lobby.game_mode == GAME_MODE_CLASSIC && !check_valid_moves_exist(&game)) {
@@ -400,6 +379,7 @@ void handle_game_click(int is_multi) {
                     game.game_over = 1;
                     play_gameover();
                 }
+                undo_push(&solo_history, &game);
             }
         }
         
@@ -407,6 +387,100 @@ void handle_game_click(int is_multi) {
     }
 }
 
+static void cancel_hint(void) {
+    solver_task_free(hint_task);
+    hint_task = NULL;
+}
+
+void request_hint(void) {
+    BitBoard bb;
+    BBPiece pieces[3];
+    
+    if (game.game_over || hint_task) return;
+    
+    hint_visible = 0;
+    game_to_bitboard(&game, &bb, pieces);
+    hint_task = solver_task_new(&bb, pieces, game.pieces_available, NULL);
+    game_snapshot(&game, &hint_position);
+    update_hint();
+}
+
+/* Searches the pending hint for a slice of the frame and shows it once found, as long as
+ * the game is still on the position it was asked on */
+void update_hint(void) {
+    GameSnapshot now;
+    
+    if (!hint_task) return;
+    
+    game_snapshot(&game, &now);
+    if (current_state != ST_SOLO || now.hash != hint_position.hash || now.available != hint_position.available ||
+        memcmp(now.piece_ids, hint_position.piece_ids, sizeof(now.piece_ids)) != 0) {
+        cancel_hint();
+        return;
+    }
+    
+    if (!solver_task_run(hint_task, solver_pool, HINT_SLICE_MS)) return;
+    
+    if (solver_task_result(hint_task, &hint_result) > 0) {
+        hint_visible = 1;
+        play_click();
+    }
+    cancel_hint();
+}
+
+int hint_pending(void) {
+    return hint_task != NULL;
+}
+
+/* The tool bar first, then the board, or back to the menu once the game is over */
+void handle_solo_click(void) {
+    const Widget *w = ui_hit(mouse_x, mouse_y);
+    
+    if (!w) {
+        if (game.game_over) {
+            play_click();
+            delete_saved_game();
+            current_state = ST_MENU;
+            resume_music();
+        } else {
+            handle_game_click(0);
+        }
+        return;
+    }
+    
+    switch (w->action) {
+        case ACT_SETTINGS:
+            play_click();
+            open_settings();
+            break;
+        case ACT_HINT:
+            request_hint();
+            break;
+        case ACT_UNDO:
+            solo_undo();
+            break;
+        case ACT_REDO:
+            solo_redo();
+            break;
+    }
+}
+
+void solo_undo(void) {
+    if (undo_step(&solo_history, &game)) {
+        hint_visible = 0;
+        selected_piece_idx = -1;
+        play_click();
+    }
+}
+
+void solo_redo(void) {
+    if (redo_step(&solo_history, &game)) {
+        hint_visible = 0;
+        selected_piece_idx = -1;
+        play_click();
+    }
+}
+
 void handle_game_mousedown(int is_multi) {
     int i;
     
@@ -475,8 +549,9 @@ void process_network(void) {
                 current_lobby.game_mode = pkt.game_mode;
                 
                 if (pkt.game_mode == GAME_MODE_RUSH) {
-                    memset(game.grid, 0, sizeof(game.grid));
+                    game_set_size(&game, pkt.grid_size);
                     game.score = 0;
+                    reset_game_seed(&game, pkt.seed, pkt.ruleset);
                     generate_pieces(&game);
                     init_effects(&game.effects);
                     
@@ -486,9 +561,12 @@ void process_network(void) {
                     
                     current_state = is_spectator ? ST_SPECTATE : ST_MULTI_GAME;
                 } else {
-                    memcpy(game.grid, pkt.grid_data, sizeof(game.grid));
+                    game_set_size(&game, pkt.grid_size);
+                    packet_get_grid(&pkt, 0, game.grid);
+                    game_sync_board(&game);
                     strcpy(current_turn_pseudo, pkt.turn_pseudo);
                     game.score = 0;
+                    reset_game_seed(&game, pkt.seed, pkt.ruleset);
                     generate_pieces(&game);
                     init_effects(&game.effects);
                     
@@ -497,9 +575,32 @@ void process_network(void) {
                 break;
             
             case MSG_UPDATE_GRID:
-                memcpy(game.grid, pkt.grid_data, sizeof(game.grid));
+                packet_get_grid(&pkt, 0, game.grid);
+                /* Our move was rejected: the server's hand, dealer and score for our seat replace ours */
+                if (pkt.piece_id < 0 && strcmp(pkt.text, my_pseudo) == 0 && dealer_valid(&pkt.dealer)) {
+                    for (i = 0; i < 3; i++) {
+                        game.pieces_available[i] = pkt.hand[i] >= 0;
+                        if (pkt.hand[i] >= 0) game.current_pieces[i] = piece_make(pkt.hand[i]);
+                    }
+                    game.dealer = pkt.dealer;
+                    game.score = pkt.score;
+                }
+                game_sync_board(&game);
                 strcpy(current_turn_pseudo, pkt.turn_pseudo);
                 
+                if (pkt.piece_id >= 0 && pkt.piece_id < NUM_PIECE_TEMPLATES &&
+                    pkt.piece_row >= 0 && pkt.piece_col >= 0 && strcmp(pkt.text, my_pseudo) != 0) {
+                    Piece placed = piece_make(pkt.piece_id);
+                    int r, c;
+                    for (r = 0; r < piece_h(&placed); r++) {
+                        for (c = 0; c < piece_w(&placed); c++) {
+                            if (piece_cell(&placed, r, c) && pkt.piece_row + r < game.grid_size && pkt.piece_col + c < game.grid_size) {
+                                spawn_place_effect(&game.effects, pkt.piece_row + r, pkt.piece_col + c, piece_color(&placed));
+                            }
+                        }
+                    }
+                }
+                
                 if (current_lobby.game_mode == GAME_MODE_CLASSIC && is_my_turn() && !is_spectator) {
                     if (!check_valid_moves_exist(&game)) {
                         Packet game_over_pkt;
@@ -516,8 +617,12 @@ void process_network(void) {
                 rush_time_remaining = pkt.time_remaining;
                 rush_player_count = pkt.rush_player_count;
                 
+                if (pkt.grid_count > 0 && pkt.grid_size != game.grid_size) {
+                    game_set_size(&game, pkt.grid_size);
+                }
                 for (i = 0; i < pkt.rush_player_count && i < 4; i++) {
                     rush_states[i] = pkt.rush_states[i];
+                    packet_get_grid(&pkt, i, rush_grids[i]);
                 }
                 
                 last_time_update = SDL_GetTicks();
@@ -563,3 +668,92 @@ void process_network(void) {
         }
     }
 }
+
+/* Both sides get the same seed, so the same pieces in the same order */
+void start_bot_duel(void) {
+    Uint32 now = SDL_GetTicks();
+    
+    net_close();
+    init_game(&game);
+    init_game_seeded(&duel_game, game.seed);
+    bot_free(&duel_bot);
+    bot_init(&duel_bot, selected_bot_level, game.seed ^ now);
+    duel_thinking = 0;
+    duel_next_move = now + (Uint32)bot_level(selected_bot_level)->move_delay_ms;
+    duel_active = 1;
+    
+    if (!my_pseudo[0]) {
+        strcpy(my_pseudo, "Joueur");
+    }
+    memset(&current_lobby, 0, sizeof(current_lobby));
+    current_lobby.game_mode = GAME_MODE_RUSH;
+    rush_time_remaining = DUEL_SECONDS;
+    last_time_update = now;
+    is_spectator = 0;
+    hint_visible = 0;
+    selected_piece_idx = -1;
+    current_state = ST_MULTI_GAME;
+}
+
+static void play_duel_move(void) {
+    BitBoard bb;
+    BBPiece pieces[3];
+    SolverMove move;
+    int i;
+    
+    if (!duel_thinking) {
+        int ids[3];
+        game_to_bitboard(&duel_game, &bb, pieces);
+        for (i = 0; i < 3; i++) {
+            ids[i] = duel_game.current_pieces[i].id;
+        }
+        bot_begin(&duel_bot, &bb, ids, duel_game.pieces_available);
+        duel_thinking = 1;
+    }
+    
+    if (!bot_think(&duel_bot, solver_pool, DUEL_SLICE_MS, &move)) return;
+    
+    duel_thinking = 0;
+    duel_next_move = SDL_GetTicks() + (Uint32)bot_level(duel_bot.level)->move_delay_ms;
+    
+    if (move.piece_idx < 0) {
+        duel_game.game_over = 1;
+        return;
+    }
+    
+    place_piece_logic(&duel_game, move.row, move.col, &duel_game.current_pieces[move.piece_idx]);
+    duel_game.pieces_available[move.piece_idx] = 0;
+    if (!duel_game.pieces_available[0] && !duel_game.pieces_available[1] && !duel_game.pieces_available[2]) {
+        generate_pieces(&duel_game);
+    }
+}
+
+/* Runs the bot side of the duel and fills the Rush standings with both boards */
+void update_bot_duel(void) {
+    int lead;
+    
+    if (!duel_active) return;
+    if (current_state != ST_MULTI_GAME) {
+        duel_active = 0;
+        bot_free(&duel_bot);
+        return;
+    }
+    
+    if (rush_time_remaining > 0 && !duel_game.game_over && (Sint32)(SDL_GetTicks() - duel_next_move) >= 0) {
+        play_duel_move();
+    }
+    
+    /* Nobody can move any more: no point waiting for the clock */
+    if (duel_game.game_over && !check_valid_moves_exist(&game)) {
+        rush_time_remaining = 0;
+    }
+    
+    lead = duel_game.score > game.score;
+    rush_player_count = 2;
+    strcpy(rush_states[lead].pseudo, my_pseudo);
+    rush_states[lead].score = game.score;
+    memcpy(rush_grids[lead], game.grid, sizeof(game.grid));
+    snprintf(rush_states[!lead].pseudo, sizeof(rush_states[!lead].pseudo), "IA %s", bot_level(duel_bot.level)->name);
+    rush_states[!lead].score = duel_game.score;
+    memcpy(rush_grids[!lead], duel_game.grid, sizeof(duel_game.grid));
+}
@@ -11,9 +11,22 @@ void handle_lobby_right_click(void);
 void handle_server_browser_click(void);
 void handle_server_browser_scroll(int direction);
 
+#include "../common/pieces.h"
+
+void dragged_piece_anchor(const Piece *p, int *row, int *col);
 void handle_game_click(int is_multi);
 void handle_game_mousedown(int is_multi);
+void handle_solo_click(void);
+/* The hint is searched a slice per frame by update_hint() and shown once found */
+void request_hint(void);
+void update_hint(void);
+int hint_pending(void);
+void solo_undo(void);
+void solo_redo(void);
 
 void process_network(void);
 
+void start_bot_duel(void);
+void update_bot_duel(void);
+
 #endif
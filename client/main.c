@@ -17,6 +17,9 @@
 #include "input_handlers.h"
 #include "game.h"
 #include "net_client.h"
+#include "profiler.h"
+#include "raster.h"
+#include "widgets.h"
 #include "embedded_assets.h"
 
 static TTF_Font* load_font_embedded_or_file(const unsigned char *data, size_t size, int ptsize, const char **file_paths) {
@@ -51,15 +54,87 @@ static TTF_Font* load_font_embedded_or_file(const unsigned char *data, size_t si
     return NULL;
 }
 
+/* SDL 1.2 has no SDL_WaitEventTimeout and its SDL_WaitEvent polls every 10 ms anyway, so
+ * waits are made of slices that long, spent in select() on the server socket when there is one */
+#define WAIT_SLICE_MS 10
+
+/* Sleeps until there is input or server data, or the timeout */
+static void wait_for_activity(Uint32 timeout_ms) {
+    Uint32 start = SDL_GetTicks();
+    SDL_Event pending;
+    
+    for (;;) {
+        Uint32 waited;
+        int slice;
+        
+        SDL_PumpEvents();
+        if (SDL_PeepEvents(&pending, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) > 0) return;
+        
+        waited = SDL_GetTicks() - start;
+        if (waited >= timeout_ms) return;
+        slice = timeout_ms - waited < WAIT_SLICE_MS ? (int)(timeout_ms - waited) : WAIT_SLICE_MS;
+        if (net_is_connected()) {
+            if (net_wait(slice)) return;
+        } else {
+            SDL_Delay(slice);
+        }
+    }
+}
+
+/* Paces frames to FRAME_RATE on deadlines, sleeping what is left of the frame once it is drawn.
+ * When frames cost more than their share the rate drops to the next divisor rather than
+ * stuttering. A still screen waits for activity instead. */
+static void schedule_next_frame(Uint32 frame_start, int animating) {
+    static Uint32 deadline = 0;
+    static float avg_cost = 0.0f;
+    Uint32 frame_ms = 1000 / FRAME_RATE;
+    Uint32 now = SDL_GetTicks();
+    Uint32 interval;
+    
+    avg_cost += ((float)(now - frame_start) - avg_cost) * 0.1f;
+    
+    if (!animating) {
+        wait_for_activity(IDLE_WAIT_MS);
+        deadline = SDL_GetTicks();
+        return;
+    }
+    
+    interval = frame_ms * (1 + (Uint32)avg_cost / frame_ms);
+    deadline += interval;
+    if ((Sint32)(deadline - now) <= 0 || deadline - now > interval) {
+        /* Late, or the deadline is stale: start again from now */
+        deadline = now;
+        return;
+    }
+    SDL_Delay(deadline - now);
+}
+
 int main(int argc, char *argv[]) {
     SDL_Event e;
     int running = 1;
     
-    (void)argc;
-    (void)argv;
+    const char *profile_csv = NULL;
+    const char *kernels = NULL;
+    int i;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) {
+            profiler_overlay = 1;
+        } else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+            profile_csv = argv[++i];
+        } else if (strcmp(argv[i], "--kernels") == 0 && i + 1 < argc) {
+            kernels = argv[++i];
+        } else {
+            printf("Usage: %s [--profile] [--profile-csv FILE] [--kernels avx2|sse2|scalar]\n", argv[0]);
+            return 1;
+        }
+    }
     
     srand((unsigned int)time(NULL));
     
+    kernels = raster_init(kernels);
+    printf("Pixel kernels: %s\n", kernels);
+    
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
         printf("SDL init failed: %s\n", SDL_GetError());
         return 1;
@@ -178,14 +253,22 @@ int main(int argc, char *argv[]) {
     }
     
     init_game(&game);
+    undo_reset(&solo_history, &game);
+    solver_pool = thread_pool_create(0);
     memset(&current_lobby, 0, sizeof(current_lobby));
     memset(&leaderboard, 0, sizeof(leaderboard));
     
     start_music();
+    profiler_init(profile_csv);
     
     while (running) {
+        Uint32 frame_start = SDL_GetTicks();
+        int changed;
+        
+        profiler_begin_frame();
         process_network();
         
+        profiler_phase(PHASE_EVENTS);
         while (SDL_PollEvent(&e)) {
             switch (e.type) {
                 case SDL_QUIT:
@@ -199,6 +282,12 @@ int main(int argc, char *argv[]) {
                     if (window_h < 400) window_h = 400;
                     screen = SDL_SetVideoMode(window_w, window_h, 32, SDL_SWSURFACE | SDL_RESIZABLE);
                     recalculate_layout();
+                    invalidate_background();
+                    gfx_invalidate();
+                    break;
+                
+                case SDL_VIDEOEXPOSE:
+                    gfx_invalidate();
                     break;
                 
                 case SDL_KEYDOWN:
@@ -206,11 +295,29 @@ int main(int argc, char *argv[]) {
                         handle_input_char(e.key.keysym.unicode);
                     }
                     
+                    if (e.key.keysym.sym == SDLK_F3) {
+                        profiler_overlay = !profiler_overlay;
+                    }
+                    
                     if (e.key.keysym.sym == SDLK_p) {
                         show_settings_overlay = !show_settings_overlay;
                         play_click();
                     }
                     
+                    if (e.key.keysym.sym == SDLK_h && current_state == ST_SOLO &&
+                        !show_pause_menu && !show_settings_overlay) {
+                        request_hint();
+                    }
+                    
+                    if (current_state == ST_SOLO && !show_pause_menu && !show_settings_overlay &&
+                        (e.key.keysym.mod & KMOD_CTRL)) {
+                        if (e.key.keysym.sym == SDLK_z) {
+                            solo_undo();
+                        } else if (e.key.keysym.sym == SDLK_y) {
+                            solo_redo();
+                        }
+                    }
+                    
                     if (e.key.keysym.sym == SDLK_ESCAPE) {
                         if (show_settings_overlay) {
                             show_settings_overlay = 0;
@@ -318,18 +425,7 @@ int main(int argc, char *argv[]) {
                                 handle_lobby_click();
                                 break;
                             case ST_SOLO:
-                                if (point_in_rect(mouse_x, mouse_y, window_w - 50, 20, 28, 28)) {
-                                    play_click();
-                                    show_settings_overlay = 1;
-                                    settings_tab = 0;
-                                } else if (game.game_over) {
-                                    play_click();
-                                    delete_saved_game();
-                                    current_state = ST_MENU;
-                                    resume_music();
-                                } else {
-                                    handle_game_click(0);
-                                }
+                                handle_solo_click();
                                 break;
                             case ST_MULTI_GAME:
                                 if (multi_game_over > 0) {
@@ -362,7 +458,6 @@ int main(int argc, char *argv[]) {
                                 }
                                 break;
                             case ST_SERVER_BROWSER:
-                                play_click();
                                 handle_server_browser_click();
                                 break;
                             case ST_SPECTATE:
@@ -385,6 +480,7 @@ int main(int argc, char *argv[]) {
             }
         }
         
+        profiler_phase(PHASE_UPDATE);
         {
             Uint32 current_time = SDL_GetTicks();
             if (last_frame_time > 0) {
@@ -405,45 +501,39 @@ int main(int argc, char *argv[]) {
             }
         }
         
+        update_bot_duel();
+        update_hint();
+        
         global_time += delta_time;
         glow_pulse += delta_time;
         if (glow_pulse > 6.28318f) glow_pulse -= 6.28318f;
         
+        /* A room or a save can change the board size */
+        if (layout_grid_size != game.grid_size) {
+            recalculate_layout();
+        }
+        
+        profiler_phase(PHASE_BACKGROUND);
+        gfx_begin_frame();
         draw_cyberpunk_background_responsive();
         
+        profiler_phase(PHASE_SCREEN);
         switch (current_state) {
-            case ST_MENU:
-                render_menu();
-                break;
-            case ST_OPTIONS:
-                render_options();
-                break;
-            case ST_LOGIN:
-                render_login();
-                break;
-            case ST_MULTI_CHOICE:
-                render_multi_choice();
-                break;
-            case ST_JOIN_INPUT:
-                render_join_input();
-                break;
-            case ST_LOBBY:
-                render_lobby();
-                break;
             case ST_SOLO:
                 render_solo();
                 break;
             case ST_MULTI_GAME:
                 render_multi_game();
                 break;
-            case ST_SERVER_BROWSER:
-                render_server_browser();
-                break;
             case ST_SPECTATE:
                 render_spectate();
                 break;
+            default:
+                ui_render();
+                break;
         }
         
+        profiler_phase(PHASE_OVERLAYS);
         draw_popup();
         
         if (show_pause_menu && current_state == ST_SOLO) {
@@ -454,13 +544,22 @@ int main(int argc, char *argv[]) {
             render_settings_overlay();
         }
         
-        SDL_Flip(screen);
+        render_profiler_overlay();
+        
+        profiler_phase(PHASE_PRESENT);
+        changed = gfx_end_frame();
+        profiler_end_frame(changed);
         
-        SDL_Delay(16);
+        /* The duel bot and the hint search in slices taken between frames */
+        schedule_next_frame(frame_start, changed || duel_active || hint_pending());
     }
     
     net_close();
+    thread_pool_destroy(solver_pool);
     cleanup_audio();
+    ui_cleanup();
+    cleanup_graphics();
+    profiler_shutdown();
     if (font_L) TTF_CloseFont(font_L);
     if (font_S) TTF_CloseFont(font_S);
     if (font_XS) TTF_CloseFont(font_XS);
@@ -8,6 +8,7 @@
     #pragma comment(lib, "ws2_32.lib")
 #else
     #include <sys/socket.h>
+    #include <sys/select.h>
     #include <arpa/inet.h>
     #include <unistd.h>
     #include <netdb.h>
@@ -20,6 +21,7 @@
 #endif
 
 static SOCKET sock = INVALID_SOCKET;
+static PacketReader rx;
 
 #ifdef _WIN32
 static int wsa_initialized = 0;
@@ -41,6 +43,7 @@ int net_connect(const char *ip, int port) {
     }
 #endif
     
+    rx.len = 0;
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         printf("Socket creation failed\n");
@@ -83,39 +86,35 @@ void net_send(Packet *pkt) {
         return;
     }
     
-    send(sock, (const char *)pkt, sizeof(Packet), 0);
+    send(sock, (const char *)pkt, packet_wire_size(pkt), 0);
 }
 
 int net_receive(Packet *pkt) {
-    int len;
+    int need, len;
     
     if (sock == INVALID_SOCKET) {
         return 0;
     }
     
-    memset(pkt, 0, sizeof(Packet));
-    
-    len = recv(sock, (char *)pkt, sizeof(Packet), 0);
-    
-    if (len > 0) {
-        return 1;
-    }
-    
-#ifdef _WIN32
-    if (WSAGetLastError() == WSAEWOULDBLOCK) {
-        return 0;
-    }
-#else
-    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        return 0;
+    /* A packet may come in over several reads, rx keeps what already arrived */
+    while ((need = packet_reader_need(&rx)) > 0) {
+        len = recv(sock, (char *)&rx.pkt + rx.len, need, 0);
+        if (len <= 0) {
+            return 0;
+        }
+        rx.len += len;
     }
-#endif
     
-    if (len == 0 || len < 0) {
+    if (need < 0) {
+        printf("Invalid packet from server\n");
+        net_close();
         return 0;
     }
     
-    return 0;
+    memset(pkt, 0, sizeof(Packet));
+    memcpy(pkt, &rx.pkt, (size_t)rx.len);
+    rx.len = 0;
+    return 1;
 }
 
 void net_close(void) {
@@ -135,3 +134,18 @@ void net_close(void) {
 int net_is_connected(void) {
     return sock != INVALID_SOCKET;
 }
+
+int net_wait(int timeout_ms) {
+    fd_set fds;
+    struct timeval tv;
+    
+    if (sock == INVALID_SOCKET) {
+        return 0;
+    }
+    
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    return select((int)sock + 1, &fds, NULL, NULL, &tv) > 0;
+}
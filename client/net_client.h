@@ -13,4 +13,7 @@ void net_close(void);
 
 int net_is_connected(void);
 
+/* Waits up to timeout_ms for data from the server, returns 1 as soon as some is there */
+int net_wait(int timeout_ms);
+
 #endif
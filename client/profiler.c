@@ -0,0 +1,225 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "profiler.h"
+#include "globals.h"
+#include "graphics.h"
+
+/* Stats are sorted again every this many frames while the overlay is up */
+#define PROFILE_REFRESH 30
+
+#define PROFILE_PHASE_LABEL(id, label, column) label,
+static const char *phase_labels[NUM_PROFILE_PHASES] = {
+    PROFILE_PHASE_LIST(PROFILE_PHASE_LABEL)
+};
+
+#define PROFILE_PHASE_COLUMN(id, label, column) "," column
+static const char csv_header[] = "frame,interval_us" PROFILE_PHASE_LIST(PROFILE_PHASE_COLUMN) ",work_us,presented";
+
+typedef struct {
+    unsigned int samples[PROFILE_WINDOW];
+    float avg;
+    unsigned int p50;
+    unsigned int p99;
+} PhaseStats;
+
+int profiler_overlay = 0;
+
+/* One per phase, then the whole frame without the sleep, then the interval between frames */
+static PhaseStats stats[NUM_PROFILE_PHASES + 2];
+static int histogram[PROFILE_BUCKETS];
+static unsigned int frame_us[NUM_PROFILE_PHASES];
+static unsigned long frame_count = 0;
+static int refresh_in = 0;
+
+static unsigned long long frame_start_us = 0;
+static unsigned long long phase_start_us = 0;
+static int current_phase = PHASE_NETWORK;
+
+static FILE *csv = NULL;
+
+static unsigned long long profiler_now_us(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    /* Whole seconds apart, so the product cannot overflow however long the machine has been up */
+    return (unsigned long long)((now.QuadPart / freq.QuadPart) * 1000000 +
+                                (now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ull + (unsigned long long)(ts.tv_nsec / 1000);
+#endif
+}
+
+int profiler_init(const char *csv_path) {
+    if (!csv_path) return 1;
+
+    csv = fopen(csv_path, "w");
+    if (!csv) {
+        printf("Cannot write profile to %s\n", csv_path);
+        return 0;
+    }
+    fprintf(csv, "%s\n", csv_header);
+    return 1;
+}
+
+void profiler_shutdown(void) {
+    if (csv) fclose(csv);
+    csv = NULL;
+}
+
+void profiler_begin_frame(void) {
+    unsigned long long now = profiler_now_us();
+    unsigned int interval = frame_start_us ? (unsigned int)(now - frame_start_us) : 0;
+
+    stats[NUM_PROFILE_PHASES + 1].samples[frame_count % PROFILE_WINDOW] = interval;
+    memset(frame_us, 0, sizeof(frame_us));
+    frame_start_us = now;
+    phase_start_us = now;
+    current_phase = PHASE_NETWORK;
+}
+
+int profiler_phase(int phase) {
+    unsigned long long now = profiler_now_us();
+    int previous = current_phase;
+
+    frame_us[current_phase] += (unsigned int)(now - phase_start_us);
+    phase_start_us = now;
+    current_phase = phase;
+    return previous;
+}
+
+static int compare_uint(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+    return (x > y) - (x < y);
+}
+
+static void refresh_stats(void) {
+    static unsigned int sorted[PROFILE_WINDOW];
+    int n = frame_count < PROFILE_WINDOW ? (int)frame_count : PROFILE_WINDOW;
+    int s, i;
+
+    if (n == 0) return;
+
+    for (s = 0; s < NUM_PROFILE_PHASES + 2; s++) {
+        PhaseStats *st = &stats[s];
+        double sum = 0;
+
+        memcpy(sorted, st->samples, n * sizeof(unsigned int));
+        qsort(sorted, n, sizeof(unsigned int), compare_uint);
+        for (i = 0; i < n; i++) {
+            sum += sorted[i];
+        }
+        st->avg = (float)(sum / n);
+        st->p50 = sorted[n / 2];
+        st->p99 = sorted[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1];
+    }
+
+    memset(histogram, 0, sizeof(histogram));
+    for (i = 0; i < n; i++) {
+        unsigned int ms = stats[NUM_PROFILE_PHASES].samples[i] / 1000;
+        histogram[ms < PROFILE_BUCKETS ? ms : PROFILE_BUCKETS - 1]++;
+    }
+}
+
+void profiler_end_frame(int presented) {
+    int slot = (int)(frame_count % PROFILE_WINDOW);
+    unsigned int work = 0;
+    int i;
+
+    profiler_phase(current_phase);
+    for (i = 0; i < NUM_PROFILE_PHASES; i++) {
+        stats[i].samples[slot] = frame_us[i];
+        work += frame_us[i];
+    }
+    stats[NUM_PROFILE_PHASES].samples[slot] = work;
+
+    if (csv) {
+        fprintf(csv, "%lu,%u", frame_count, stats[NUM_PROFILE_PHASES + 1].samples[slot]);
+        for (i = 0; i < NUM_PROFILE_PHASES; i++) {
+            fprintf(csv, ",%u", frame_us[i]);
+        }
+        fprintf(csv, ",%u,%d\n", work, presented > 0);
+    }
+
+    frame_count++;
+    if (profiler_overlay && --refresh_in <= 0) {
+        refresh_stats();
+        refresh_in = PROFILE_REFRESH;
+    }
+}
+
+static void draw_ms(float us, int x, int y) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%.2f", us / 1000.0f);
+    draw_text_left(font_XS, buf, x, y, COLOR_WHITE);
+}
+
+static void draw_stats_row(const char *label, const PhaseStats *st, int x, int y) {
+    draw_text_left(font_XS, label, x + 10, y, COLOR_GREY);
+    draw_ms(st->avg, x + 130, y);
+    draw_ms((float)st->p50, x + 200, y);
+    draw_ms((float)st->p99, x + 270, y);
+}
+
+void render_profiler_overlay(void) {
+    int x = 10, y = 60, w = 340;
+    int row_h = 18;
+    int h = 70 + (NUM_PROFILE_PHASES + 2) * row_h + 60;
+    int max_bucket = 1;
+    char buf[32];
+    int i;
+
+    if (!profiler_overlay || !font_XS) return;
+    if (frame_count > 0 && stats[NUM_PROFILE_PHASES + 1].avg <= 0.0f) refresh_stats();
+
+    fill_rect(x, y, w, h, COLOR_PANEL);
+    draw_neon_border(x, y, w, h, COLOR_NEON_CYAN, 0);
+
+    draw_text_left(font_XS, "PROFIL (F3)", x + 10, y + 8, COLOR_NEON_CYAN);
+    if (stats[NUM_PROFILE_PHASES + 1].avg > 0.0f) {
+        snprintf(buf, sizeof(buf), "%.0f", 1000000.0f / stats[NUM_PROFILE_PHASES + 1].avg);
+        draw_text_left(font_XS, buf, x + 200, y + 8, COLOR_NEON_GREEN);
+        draw_text_left(font_XS, "img/s", x + 240, y + 8, COLOR_GREY);
+    }
+
+    y += 30;
+    draw_text_left(font_XS, "ms", x + 10, y, COLOR_GREY);
+    draw_text_left(font_XS, "moy", x + 130, y, COLOR_GREY);
+    draw_text_left(font_XS, "p50", x + 200, y, COLOR_GREY);
+    draw_text_left(font_XS, "p99", x + 270, y, COLOR_GREY);
+    y += row_h + 4;
+
+    for (i = 0; i < NUM_PROFILE_PHASES; i++) {
+        draw_stats_row(phase_labels[i], &stats[i], x, y);
+        y += row_h;
+    }
+    draw_stats_row("Image", &stats[NUM_PROFILE_PHASES], x, y);
+    y += row_h;
+    draw_stats_row("Intervalle", &stats[NUM_PROFILE_PHASES + 1], x, y);
+    y += row_h + 8;
+
+    /* Frame time histogram, 1 ms per bar */
+    for (i = 0; i < PROFILE_BUCKETS; i++) {
+        if (histogram[i] > max_bucket) max_bucket = histogram[i];
+    }
+    for (i = 0; i < PROFILE_BUCKETS; i++) {
+        int bar_h = histogram[i] * 40 / max_bucket;
+        Uint32 color = i < 1000 / FRAME_RATE ? COLOR_NEON_GREEN : (i < 2000 / FRAME_RATE ? COLOR_NEON_YELLOW : COLOR_NEON_RED);
+        if (bar_h > 0) fill_rect(x + 10 + i * 10, y + 40 - bar_h, 8, bar_h, color);
+    }
+    fill_rect(x + 10, y + 41, PROFILE_BUCKETS * 10 - 2, 1, COLOR_GREY);
+}
@@ -0,0 +1,40 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/* One entry per phase of the main loop: X(id, label, CSV column) */
+#define PROFILE_PHASE_LIST(X) \
+    X(PHASE_NETWORK,    "Reseau",     "network_us") \
+    X(PHASE_EVENTS,     "Evenements", "events_us") \
+    X(PHASE_UPDATE,     "Logique",    "update_us") \
+    X(PHASE_BACKGROUND, "Fond",       "background_us") \
+    X(PHASE_SCREEN,     "Ecran",      "screen_us") \
+    X(PHASE_EFFECTS,    "Effets",     "effects_us") \
+    X(PHASE_OVERLAYS,   "Surcouches", "overlays_us") \
+    X(PHASE_PRESENT,    "Affichage",  "present_us")
+
+#define PROFILE_PHASE_ENUM(id, label, column) id,
+typedef enum {
+    PROFILE_PHASE_LIST(PROFILE_PHASE_ENUM)
+    NUM_PROFILE_PHASES
+} ProfilePhase;
+
+/* Frames the averages, percentiles and histogram are taken over */
+#define PROFILE_WINDOW 256
+/* Frame time histogram: 1 ms buckets, the last one takes everything slower */
+#define PROFILE_BUCKETS 32
+
+extern int profiler_overlay;
+
+/* csv_path, if not NULL, gets one line per frame */
+int profiler_init(const char *csv_path);
+void profiler_shutdown(void);
+
+/* Time runs into the current phase until the next switch. profiler_phase() returns the phase
+ * it interrupts so nested code can hand the time back. */
+void profiler_begin_frame(void);
+int profiler_phase(int phase);
+void profiler_end_frame(int presented);
+
+void render_profiler_overlay(void);
+
+#endif
@@ -0,0 +1,363 @@
+#include "raster.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define RASTER_X86 1
+    #define RASTER_TARGET(isa) __attribute__((target(isa)))
+    #include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define RASTER_X86 1
+    #define RASTER_TARGET(isa)
+    #include <intrin.h>
+    #include <immintrin.h>
+#endif
+
+/* Horizontal gradients are worked out this many pixels at a time, then copied down the rows */
+#define GRADIENT_CHUNK 256
+
+/* Every kernel works on one span of n pixels */
+typedef struct {
+    const char *name;
+    void (*fill)(Uint32 *dst, int n, Uint32 pixel);
+    void (*blend)(Uint32 *dst, int n, Uint32 pixel, int amount);
+    void (*add)(Uint32 *dst, int n, Uint32 pixel);
+    void (*blend_alpha)(Uint32 *dst, const Uint32 *src, int n, int alpha_shift);
+} RasterKernels;
+
+Uint32 raster_lerp(Uint32 p0, Uint32 p1, int amount) {
+    Uint32 rb = (((p0 & 0x00FF00FF) * (Uint32)(256 - amount) + (p1 & 0x00FF00FF) * (Uint32)amount) >> 8) & 0x00FF00FF;
+    Uint32 ag = ((((p0 >> 8) & 0x00FF00FF) * (Uint32)(256 - amount) + ((p1 >> 8) & 0x00FF00FF) * (Uint32)amount) >> 8) & 0x00FF00FF;
+    return rb | (ag << 8);
+}
+
+static Uint32 add_pixel(Uint32 d, Uint32 s) {
+    Uint32 out = 0;
+    int shift;
+    for (shift = 0; shift < 32; shift += 8) {
+        Uint32 v = ((d >> shift) & 0xFF) + ((s >> shift) & 0xFF);
+        out |= (v > 0xFF ? 0xFF : v) << shift;
+    }
+    return out;
+}
+
+static void fill_scalar(Uint32 *dst, int n, Uint32 pixel) {
+    int i;
+    for (i = 0; i < n; i++) {
+        dst[i] = pixel;
+    }
+}
+
+static void blend_scalar(Uint32 *dst, int n, Uint32 pixel, int amount) {
+    int i;
+    for (i = 0; i < n; i++) {
+        dst[i] = raster_lerp(dst[i], pixel, amount);
+    }
+}
+
+static void add_scalar(Uint32 *dst, int n, Uint32 pixel) {
+    int i;
+    for (i = 0; i < n; i++) {
+        dst[i] = add_pixel(dst[i], pixel);
+    }
+}
+
+/* 255 becomes 256 so that opaque pixels are copied as they are. The destination keeps its
+ * own alpha byte, as with SDL blits. */
+static void blend_alpha_scalar(Uint32 *dst, const Uint32 *src, int n, int alpha_shift) {
+    Uint32 amask = 0xFFu << alpha_shift;
+    int i;
+    for (i = 0; i < n; i++) {
+        int a = (int)((src[i] >> alpha_shift) & 0xFF);
+        if (a == 0) continue;
+        dst[i] = (raster_lerp(dst[i], src[i], a + (a >> 7)) & ~amask) | (dst[i] & amask);
+    }
+}
+
+static const RasterKernels scalar_kernels = {
+    "scalar", fill_scalar, blend_scalar, add_scalar, blend_alpha_scalar
+};
+
+#ifdef RASTER_X86
+
+/* 16 bit lanes: (d * (256 - a) + s * a) >> 8, which fits since both products sum to 255 * 256 at most */
+RASTER_TARGET("sse2")
+static __m128i mix_sse2(__m128i d, __m128i s, __m128i a, __m128i inv) {
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_mullo_epi16(s, a)), 8);
+}
+
+RASTER_TARGET("sse2")
+static void fill_sse2(Uint32 *dst, int n, Uint32 pixel) {
+    __m128i p = _mm_set1_epi32((int)pixel);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst + i), p);
+    }
+    fill_scalar(dst + i, n - i, pixel);
+}
+
+RASTER_TARGET("sse2")
+static void blend_sse2(Uint32 *dst, int n, Uint32 pixel, int amount) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i s = _mm_unpacklo_epi8(_mm_set1_epi32((int)pixel), zero);
+    __m128i a = _mm_set1_epi16((short)amount);
+    __m128i inv = _mm_set1_epi16((short)(256 - amount));
+    __m128i sa = _mm_mullo_epi16(s, a);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv), sa), 8);
+        __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv), sa), 8);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blend_scalar(dst + i, n - i, pixel, amount);
+}
+
+RASTER_TARGET("sse2")
+static void add_sse2(Uint32 *dst, int n, Uint32 pixel) {
+    __m128i p = _mm_set1_epi32((int)pixel);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu8(d, p));
+    }
+    add_scalar(dst + i, n - i, pixel);
+}
+
+/* Only the usual ARGB layout, with alpha in the top byte, has a vector path */
+RASTER_TARGET("sse2")
+static void blend_alpha_sse2(Uint32 *dst, const Uint32 *src, int n, int alpha_shift) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i amask = _mm_set1_epi32((int)0xFF000000u);
+    __m128i full = _mm_set1_epi16(256);
+    int i = 0;
+
+    if (alpha_shift != 24) {
+        blend_alpha_scalar(dst, src, n, alpha_shift);
+        return;
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d, s16, a, lo, hi;
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, amask), zero)) == 0xFFFF) continue;
+        d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        s16 = _mm_unpacklo_epi8(s, zero);
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF);
+        a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+        lo = mix_sse2(_mm_unpacklo_epi8(d, zero), s16, a, _mm_sub_epi16(full, a));
+
+        s16 = _mm_unpackhi_epi8(s, zero);
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF);
+        a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+        hi = mix_sse2(_mm_unpackhi_epi8(d, zero), s16, a, _mm_sub_epi16(full, a));
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_andnot_si128(amask, _mm_packus_epi16(lo, hi)),
+                                                            _mm_and_si128(amask, d)));
+    }
+    blend_alpha_scalar(dst + i, src + i, n - i, alpha_shift);
+}
+
+static const RasterKernels sse2_kernels = {
+    "sse2", fill_sse2, blend_sse2, add_sse2, blend_alpha_sse2
+};
+
+RASTER_TARGET("avx2")
+static __m256i mix_avx2(__m256i d, __m256i s, __m256i a, __m256i inv) {
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(d, inv), _mm256_mullo_epi16(s, a)), 8);
+}
+
+RASTER_TARGET("avx2")
+static void fill_avx2(Uint32 *dst, int n, Uint32 pixel) {
+    __m256i p = _mm256_set1_epi32((int)pixel);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(dst + i), p);
+    }
+    fill_scalar(dst + i, n - i, pixel);
+}
+
+RASTER_TARGET("avx2")
+static void blend_avx2(Uint32 *dst, int n, Uint32 pixel, int amount) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i s = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)pixel), zero);
+    __m256i a = _mm256_set1_epi16((short)amount);
+    __m256i inv = _mm256_set1_epi16((short)(256 - amount));
+    __m256i sa = _mm256_mullo_epi16(s, a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv), sa), 8);
+        __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv), sa), 8);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    blend_scalar(dst + i, n - i, pixel, amount);
+}
+
+RASTER_TARGET("avx2")
+static void add_avx2(Uint32 *dst, int n, Uint32 pixel) {
+    __m256i p = _mm256_set1_epi32((int)pixel);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_adds_epu8(d, p));
+    }
+    add_scalar(dst + i, n - i, pixel);
+}
+
+RASTER_TARGET("avx2")
+static void blend_alpha_avx2(Uint32 *dst, const Uint32 *src, int n, int alpha_shift) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i amask = _mm256_set1_epi32((int)0xFF000000u);
+    __m256i full = _mm256_set1_epi16(256);
+    int i = 0;
+
+    if (alpha_shift != 24) {
+        blend_alpha_scalar(dst, src, n, alpha_shift);
+        return;
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i d, s16, a, lo, hi;
+
+        if (_mm256_testz_si256(s, amask)) continue;
+        d = _mm256_loadu_si256((const __m256i *)(dst + i));
+
+        s16 = _mm256_unpacklo_epi8(s, zero);
+        a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xFF), 0xFF);
+        a = _mm256_add_epi16(a, _mm256_srli_epi16(a, 7));
+        lo = mix_avx2(_mm256_unpacklo_epi8(d, zero), s16, a, _mm256_sub_epi16(full, a));
+
+        s16 = _mm256_unpackhi_epi8(s, zero);
+        a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xFF), 0xFF);
+        a = _mm256_add_epi16(a, _mm256_srli_epi16(a, 7));
+        hi = mix_avx2(_mm256_unpackhi_epi8(d, zero), s16, a, _mm256_sub_epi16(full, a));
+
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(_mm256_andnot_si256(amask, _mm256_packus_epi16(lo, hi)),
+                                                                  _mm256_and_si256(amask, d)));
+    }
+    blend_alpha_sse2(dst + i, src + i, n - i, alpha_shift);
+}
+
+static const RasterKernels avx2_kernels = {
+    "avx2", fill_avx2, blend_avx2, add_avx2, blend_alpha_avx2
+};
+
+static int cpu_has_sse2(void) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] >> 26) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+/* The OS has to save the AVX registers too */
+static int cpu_has_avx2(void) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    if (!((info[2] >> 27) & 1) || (_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] >> 5) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+static const RasterKernels *kernels = &scalar_kernels;
+
+const char *raster_init(const char *name) {
+    const RasterKernels *supported[3];
+    int count = 0, i;
+
+#ifdef RASTER_X86
+    if (cpu_has_avx2()) supported[count++] = &avx2_kernels;
+    if (cpu_has_sse2()) supported[count++] = &sse2_kernels;
+#endif
+    supported[count++] = &scalar_kernels;
+
+    kernels = supported[0];
+    for (i = 0; name && i < count; i++) {
+        if (strcmp(name, supported[i]->name) == 0) kernels = supported[i];
+    }
+    return kernels->name;
+}
+
+const char *raster_kernels(void) {
+    return kernels->name;
+}
+
+void raster_fill(Uint8 *dst, int pitch, int w, int h, Uint32 pixel) {
+    int y;
+    for (y = 0; y < h; y++, dst += pitch) {
+        kernels->fill((Uint32 *)dst, w, pixel);
+    }
+}
+
+void raster_copy(Uint8 *dst, int pitch, const Uint8 *src, int src_pitch, int w, int h) {
+    int y;
+    for (y = 0; y < h; y++, dst += pitch, src += src_pitch) {
+        memcpy(dst, src, (size_t)w * 4);
+    }
+}
+
+void raster_blend(Uint8 *dst, int pitch, int w, int h, Uint32 pixel, int amount) {
+    int y;
+    if (amount <= 0) return;
+    for (y = 0; y < h; y++, dst += pitch) {
+        if (amount >= 256) {
+            kernels->fill((Uint32 *)dst, w, pixel);
+        } else {
+            kernels->blend((Uint32 *)dst, w, pixel, amount);
+        }
+    }
+}
+
+void raster_add(Uint8 *dst, int pitch, int w, int h, Uint32 pixel) {
+    int y;
+    if (pixel == 0) return;
+    for (y = 0; y < h; y++, dst += pitch) {
+        kernels->add((Uint32 *)dst, w, pixel);
+    }
+}
+
+void raster_blend_alpha(Uint8 *dst, int pitch, const Uint8 *src, int src_pitch, int w, int h, int alpha_shift) {
+    int y;
+    for (y = 0; y < h; y++, dst += pitch, src += src_pitch) {
+        kernels->blend_alpha((Uint32 *)dst, (const Uint32 *)src, w, alpha_shift);
+    }
+}
+
+static int gradient_step(int i, int length) {
+    int q = (i * 256 + length / 2) / length;
+    return q < 0 ? 0 : (q > 256 ? 256 : q);
+}
+
+void raster_gradient_v(Uint8 *dst, int pitch, int w, int h, Uint32 p0, Uint32 p1, int first, int length) {
+    int y;
+    for (y = 0; y < h; y++, dst += pitch) {
+        kernels->fill((Uint32 *)dst, w, raster_lerp(p0, p1, gradient_step(first + y, length)));
+    }
+}
+
+void raster_gradient_h(Uint8 *dst, int pitch, int w, int h, Uint32 p0, Uint32 p1, int first, int length) {
+    Uint32 row[GRADIENT_CHUNK];
+    int x, y, i;
+
+    for (x = 0; x < w; x += GRADIENT_CHUNK) {
+        int n = w - x < GRADIENT_CHUNK ? w - x : GRADIENT_CHUNK;
+        Uint8 *d = dst + x * 4;
+        for (i = 0; i < n; i++) {
+            row[i] = raster_lerp(p0, p1, gradient_step(first + x + i, length));
+        }
+        for (y = 0; y < h; y++, d += pitch) {
+            memcpy(d, row, (size_t)n * 4);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <SDL.h>
+
+/* Pixel kernels for 32 bpp surfaces whose channels are whole bytes, written straight into
+ * locked pixels. Pitches are in bytes. Blending works on every byte of the pixel, so both
+ * pixels must share the layout. Amounts go from 0 (destination kept) to 256 (source). */
+
+/* Picks the fastest kernels this CPU runs: "avx2", "sse2" or "scalar". A name forces one,
+ * NULL or an unsupported one keeps the best. Returns the name of the kernels in use. */
+const char *raster_init(const char *name);
+const char *raster_kernels(void);
+
+/* Mixes two pixels byte by byte */
+Uint32 raster_lerp(Uint32 p0, Uint32 p1, int amount);
+
+void raster_fill(Uint8 *dst, int pitch, int w, int h, Uint32 pixel);
+void raster_copy(Uint8 *dst, int pitch, const Uint8 *src, int src_pitch, int w, int h);
+
+/* Constant colour: alpha blended, or added with saturation */
+void raster_blend(Uint8 *dst, int pitch, int w, int h, Uint32 pixel, int amount);
+void raster_add(Uint8 *dst, int pitch, int w, int h, Uint32 pixel);
+
+/* Source with its own alpha byte at alpha_shift, 255 being opaque */
+void raster_blend_alpha(Uint8 *dst, int pitch, const Uint8 *src, int src_pitch, int w, int h, int alpha_shift);
+
+/* The rows or columns of a gradient from p0 to p1 over length pixels, this piece starting at
+ * pixel first of it */
+void raster_gradient_v(Uint8 *dst, int pitch, int w, int h, Uint32 p0, Uint32 p1, int first, int length);
+void raster_gradient_h(Uint8 *dst, int pitch, int w, int h, Uint32 p0, Uint32 p1, int first, int length);
+
+#endif
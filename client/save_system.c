@@ -129,28 +129,31 @@ void save_current_game(void) {
     FILE *f;
     GameSaveData data;
     unsigned char *raw;
-    int i, j, k;
+    int i, j;
     
     memset(&data, 0, sizeof(data));
     data.magic = GAME_SAVE_MAGIC;
     data.score = game.score;
+    data.grid_size = game.grid_size;
+    data.seed = game.seed;
+    data.ruleset = game.ruleset;
+    data.streak = game.streak;
+    for (i = 0; i < 4; i++) {
+        data.rng_state[i] = game.dealer.rng.s[i];
+    }
+    data.deal_mode = game.dealer.mode;
+    data.bag_left = game.dealer.bag_left;
+    memcpy(data.bag, game.dealer.bag, sizeof(data.bag));
     
-    for (i = 0; i < GRID_H; i++) {
-        for (j = 0; j < GRID_W; j++) {
+    for (i = 0; i < game.grid_size; i++) {
+        for (j = 0; j < game.grid_size; j++) {
             data.grid[i][j] = game.grid[i][j];
         }
     }
     
     for (i = 0; i < 3; i++) {
-        data.piece_w[i] = game.current_pieces[i].w;
-        data.piece_h[i] = game.current_pieces[i].h;
-        data.piece_color[i] = game.current_pieces[i].color;
+        data.piece_ids[i] = game.current_pieces[i].id;
         data.pieces_available[i] = game.pieces_available[i];
-        for (j = 0; j < 5; j++) {
-            for (k = 0; k < 5; k++) {
-                data.piece_data[i][j][k] = game.current_pieces[i].data[j][k];
-            }
-        }
     }
     
     data.checksum = calculate_game_checksum(&data);
@@ -171,7 +174,8 @@ int load_current_game(void) {
     GameSaveData data;
     unsigned char *raw;
     unsigned int expected_checksum;
-    int i, j, k;
+    PieceDealer dealer;
+    int i, j;
     
     f = fopen(GAME_SAVE_FILE, "rb");
     if (!f) {
@@ -199,27 +203,48 @@ int load_current_game(void) {
         return 0;
     }
     
+    for (i = 0; i < 3; i++) {
+        if (data.piece_ids[i] < 0 || data.piece_ids[i] >= NUM_PIECE_TEMPLATES) {
+            return 0;
+        }
+    }
+    if (data.grid_size < GRID_MIN || data.grid_size > GRID_MAX) {
+        return 0;
+    }
+    if (data.ruleset < 0 || data.ruleset >= NUM_RULESETS || data.streak < 0) {
+        return 0;
+    }
+    
+    for (i = 0; i < 4; i++) {
+        dealer.rng.s[i] = data.rng_state[i];
+    }
+    dealer.mode = data.deal_mode;
+    dealer.bag_left = data.bag_left;
+    memcpy(dealer.bag, data.bag, sizeof(dealer.bag));
+    if (!dealer_valid(&dealer)) {
+        return 0;
+    }
+    
     game.score = data.score;
     game.game_over = 0;
     init_effects(&game.effects);
+    game.seed = data.seed;
+    game.ruleset = data.ruleset;
+    game.streak = data.streak;
+    game.dealer = dealer;
     
-    for (i = 0; i < GRID_H; i++) {
-        for (j = 0; j < GRID_W; j++) {
+    game_set_size(&game, data.grid_size);
+    for (i = 0; i < game.grid_size; i++) {
+        for (j = 0; j < game.grid_size; j++) {
             game.grid[i][j] = data.grid[i][j];
         }
     }
     
     for (i = 0; i < 3; i++) {
-        game.current_pieces[i].w = data.piece_w[i];
-        game.current_pieces[i].h = data.piece_h[i];
-        game.current_pieces[i].color = data.piece_color[i];
+        game.current_pieces[i] = piece_make(data.piece_ids[i]);
         game.pieces_available[i] = data.pieces_available[i];
-        for (j = 0; j < 5; j++) {
-            for (k = 0; k < 5; k++) {
-                game.current_pieces[i].data[j][k] = data.piece_data[i][j][k];
-            }
-        }
     }
+    game_sync_board(&game);
     
     return 1;
 }
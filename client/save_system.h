@@ -15,13 +15,18 @@ typedef struct {
 
 typedef struct {
     unsigned int magic;
-    int grid[GRID_H][GRID_W];
+    int grid_size;
+    Cell grid[GRID_MAX][GRID_MAX];
     int score;
-    int piece_data[3][5][5];
-    int piece_w[3];
-    int piece_h[3];
-    int piece_color[3];
+    int piece_ids[3];
     int pieces_available[3];
+    unsigned int seed;
+    int ruleset;
+    int streak;
+    unsigned int rng_state[4];
+    int deal_mode;
+    int bag_left;
+    unsigned char bag[NUM_PIECE_TEMPLATES];
     unsigned int checksum;
 } GameSaveData;
 
@@ -4,30 +4,23 @@
 #include "ui_components.h"
 #include "audio.h"
 #include "save_system.h"
+#include "input_handlers.h"
+#include "profiler.h"
+#include "widgets.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
 
-void render_menu(void) {
-    float title_pulse = (sinf(glow_pulse * 2.0f) + 1.0f) * 0.5f;
+static void draw_menu_backdrop(void) {
     int title_y = 120;
     int center_x = window_w / 2;
-    
-    {
-        int glow_size = (int)(8 + title_pulse * 4);
-        int i;
-        for (i = glow_size; i > 0; i--) {
-            float alpha = (float)(glow_size - i + 1) / (float)(glow_size + 1) * 0.15f;
-            (void)alpha;
-        }
-    }
+    int line_y = title_y + 85;
     
     draw_text(font_L, "BLOCKBLAST", center_x + 2, title_y + 2, darken_color(COLOR_NEON_CYAN, 0.3f));
     draw_text(font_L, "BLOCKBLAST", center_x, title_y, COLOR_NEON_CYAN);
     
     draw_text(font_S, "NEON EDITION", center_x, title_y + 50, COLOR_NEON_MAGENTA);
     
-    int line_y = title_y + 85;
     fill_rect(center_x - 150, line_y, 100, 2, COLOR_NEON_CYAN);
     fill_rect(center_x + 50, line_y, 100, 2, COLOR_NEON_MAGENTA);
     
@@ -39,35 +32,45 @@ void render_menu(void) {
         fill_rect(cx - 1, cy - size/2, 3, size, COLOR_NEON_GREEN);
     }
     
+    draw_text(font_XS ? font_XS : font_S, "v4.0 NEON", center_x, window_h - 30, COLOR_GREY);
+}
+
+static Uint32 menu_key(void) {
+    Uint32 h = ui_hash(UI_HASH_SEED, &has_saved_game, sizeof(has_saved_game));
+    return ui_hash(h, &selected_bot_level, sizeof(selected_bot_level));
+}
+
+static void build_menu(void) {
+    int center_x = window_w / 2;
     int btn_y = 250;
     
+    ui_add_backdrop(draw_menu_backdrop);
+    
     if (has_saved_game) {
-        draw_button(center_x - 150, btn_y, 300, 55, "CONTINUER", COLOR_NEON_ORANGE, 0);
+        ui_add_button(ACT_CONTINUE, 0, center_x - 150, btn_y, 300, 55, "CONTINUER", COLOR_NEON_ORANGE, 0);
         btn_y += 70;
     }
     
-    draw_button(center_x - 150, btn_y, 300, 55, "NOUVELLE PARTIE", COLOR_SUCCESS, 0);
+    ui_add_button(ACT_NEW_GAME, 0, center_x - 150, btn_y, 300, 55, "NOUVELLE PARTIE", COLOR_SUCCESS, 0);
     btn_y += 70;
-    draw_button(center_x - 150, btn_y, 300, 55, "MULTI ONLINE", COLOR_BUTTON, 0);
+    ui_add_button(ACT_DUEL, 0, center_x - 150, btn_y, 185, 55, "CONTRE L'IA", COLOR_NEON_ORANGE, 0);
+    ui_add_button(ACT_BOT_LEVEL, 0, center_x + 45, btn_y, 105, 55, bot_level(selected_bot_level)->name, COLOR_BUTTON, 0);
     btn_y += 70;
-    draw_button(center_x - 150, btn_y, 300, 55, "PARAMETRES", COLOR_PURPLE, 0);
-    
-    draw_settings_gear(window_w - 50, 20);
+    ui_add_button(ACT_ONLINE, 0, center_x - 150, btn_y, 300, 55, "MULTI ONLINE", COLOR_BUTTON, 0);
+    btn_y += 70;
+    ui_add_button(ACT_OPTIONS, 0, center_x - 150, btn_y, 300, 55, "PARAMETRES", COLOR_PURPLE, 0);
     
-    draw_text(font_XS ? font_XS : font_S, "v4.0 NEON", center_x, window_h - 30, COLOR_GREY);
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
 }
 
-void render_options(void) {
+static void draw_options_backdrop(void) {
     draw_text(font_L, "CONFIGURATION", WINDOW_W / 2 + 2, 80 + 2, darken_color(COLOR_NEON_MAGENTA, 0.3f));
     draw_text(font_L, "CONFIGURATION", WINDOW_W / 2, 80, COLOR_NEON_MAGENTA);
     
     fill_rect(WINDOW_W / 2 - 120, 120, 240, 2, COLOR_NEON_MAGENTA);
     
     draw_text(font_S, "Adresse IP:", WINDOW_W / 2, 170, COLOR_NEON_CYAN);
-    draw_input_field(70, 195, 400, 50, edit_ip, active_input == 1);
-    
     draw_text(font_S, "Port:", WINDOW_W / 2, 280, COLOR_NEON_CYAN);
-    draw_input_field(70, 305, 400, 50, edit_port, active_input == 2);
     
     if (test_result == 1) {
         draw_text(font_S, "Connexion OK!", WINDOW_W / 2 + 1, 401, darken_color(COLOR_NEON_GREEN, 0.4f));
@@ -76,15 +79,27 @@ void render_options(void) {
         draw_text(font_S, "Echec connexion!", WINDOW_W / 2 + 1, 401, darken_color(COLOR_NEON_RED, 0.4f));
         draw_text(font_S, "Echec connexion!", WINDOW_W / 2, 400, COLOR_NEON_RED);
     }
-    
-    draw_button(70, 460, 180, 50, "TESTER", COLOR_BUTTON, 0);
-    draw_button(290, 460, 180, 50, "SAUVEGARDER", COLOR_SUCCESS, test_result != 1);
-    draw_button(WINDOW_W / 2 - 90, 560, 180, 50, "RETOUR", COLOR_DANGER, 0);
 }
 
-void render_login(void) {
-    draw_settings_gear(window_w - 50, 20);
+static Uint32 options_key(void) {
+    Uint32 h = ui_hash(UI_HASH_SEED, edit_ip, sizeof(edit_ip));
+    h = ui_hash(h, edit_port, sizeof(edit_port));
+    h = ui_hash(h, &active_input, sizeof(active_input));
+    return ui_hash(h, &test_result, sizeof(test_result));
+}
+
+static void build_options(void) {
+    ui_add_backdrop(draw_options_backdrop);
+    
+    ui_add_input(ACT_EDIT_IP, 70, 195, 400, 50, edit_ip, active_input == 1);
+    ui_add_input(ACT_EDIT_PORT, 70, 305, 400, 50, edit_port, active_input == 2);
     
+    ui_add_button(ACT_TEST, 0, 70, 460, 180, 50, "TESTER", COLOR_BUTTON, 0);
+    ui_add_button(ACT_SAVE, 0, 290, 460, 180, 50, "SAUVEGARDER", COLOR_SUCCESS, test_result != 1);
+    ui_add_button(ACT_BACK, 0, WINDOW_W / 2 - 90, 560, 180, 50, "RETOUR", COLOR_DANGER, 0);
+}
+
+static void draw_login_backdrop(void) {
     draw_text(font_L, "CONNEXION", WINDOW_W / 2 + 2, 120 + 2, darken_color(COLOR_NEON_CYAN, 0.3f));
     draw_text(font_L, "CONNEXION", WINDOW_W / 2, 120, COLOR_NEON_CYAN);
     
@@ -101,18 +116,27 @@ void render_login(void) {
     }
     
     draw_text(font_S, "PSEUDO :", WINDOW_W / 2, 280, COLOR_NEON_CYAN);
-    draw_input_field(70, 310, 400, 50, input_buffer, 1);
+}
+
+/* Login and join code: the screen only shows what is typed */
+static Uint32 input_key(void) {
+    return ui_hash(UI_HASH_SEED, input_buffer, sizeof(input_buffer));
+}
+
+static void build_login(void) {
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
+    ui_add_backdrop(draw_login_backdrop);
+    
+    ui_add_input(ACT_NONE, 70, 310, 400, 50, input_buffer, 1);
     
-    draw_button(WINDOW_W / 2 - 90, 420, 180, 50, "VALIDER", COLOR_SUCCESS, strlen(input_buffer) == 0);
-    draw_button(WINDOW_W / 2 - 90, 500, 180, 50, "RETOUR", COLOR_DANGER, 0);
+    ui_add_button(ACT_VALIDATE, 0, WINDOW_W / 2 - 90, 420, 180, 50, "VALIDER", COLOR_SUCCESS, strlen(input_buffer) == 0);
+    ui_add_button(ACT_BACK, 0, WINDOW_W / 2 - 90, 500, 180, 50, "RETOUR", COLOR_DANGER, 0);
 }
 
-void render_multi_choice(void) {
+static void draw_multi_choice_backdrop(void) {
     int i;
     char line[64];
     
-    draw_settings_gear(window_w - 50, 20);
-    
     draw_text(font_L, "MULTIJOUEUR", WINDOW_W / 2 + 2, 80 + 2, darken_color(COLOR_NEON_PURPLE, 0.3f));
     draw_text(font_L, "MULTIJOUEUR", WINDOW_W / 2, 80, COLOR_NEON_PURPLE);
     
@@ -122,11 +146,7 @@ void render_multi_choice(void) {
         int panel_w = WINDOW_W - 100;
         int panel_h = 230;
         
-        for (i = 4; i > 0; i--) {
-            float alpha = (float)(4 - i + 1) / 5.0f * 0.1f;
-            Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-            fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-        }
+        draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_CYAN, 4, 0.1f);
         
         fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
         
@@ -157,16 +177,23 @@ void render_multi_choice(void) {
     if (leaderboard.count == 0) {
         draw_text(font_S, "Aucun score enregistre", WINDOW_W / 2, 250, COLOR_GREY);
     }
-    
-    draw_button(WINDOW_W / 2 - 150, 400, 300, 55, "CREER UNE PARTIE", COLOR_SUCCESS, 0);
-    draw_button(WINDOW_W / 2 - 150, 475, 300, 55, "REJOINDRE (CODE)", COLOR_BUTTON, 0);
-    draw_button(WINDOW_W / 2 - 150, 550, 300, 55, "SERVEURS OUVERTS", COLOR_PURPLE, 0);
-    draw_button(WINDOW_W / 2 - 90, 640, 180, 50, "RETOUR", COLOR_DANGER, 0);
 }
 
-void render_join_input(void) {
-    draw_settings_gear(window_w - 50, 20);
-    
+static Uint32 multi_choice_key(void) {
+    return ui_hash(UI_HASH_SEED, &leaderboard, sizeof(leaderboard));
+}
+
+static void build_multi_choice(void) {
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
+    ui_add_backdrop(draw_multi_choice_backdrop);
+    
+    ui_add_button(ACT_CREATE_ROOM, 0, WINDOW_W / 2 - 150, 400, 300, 55, "CREER UNE PARTIE", COLOR_SUCCESS, 0);
+    ui_add_button(ACT_JOIN_CODE, 0, WINDOW_W / 2 - 150, 475, 300, 55, "REJOINDRE (CODE)", COLOR_BUTTON, 0);
+    ui_add_button(ACT_SERVERS, 0, WINDOW_W / 2 - 150, 550, 300, 55, "SERVEURS OUVERTS", COLOR_PURPLE, 0);
+    ui_add_button(ACT_BACK, 0, WINDOW_W / 2 - 90, 640, 180, 50, "RETOUR", COLOR_DANGER, 0);
+}
+
+static void draw_join_input_backdrop(void) {
     draw_text(font_L, "REJOINDRE", WINDOW_W / 2 + 2, 120 + 2, darken_color(COLOR_NEON_GREEN, 0.3f));
     draw_text(font_L, "REJOINDRE", WINDOW_W / 2, 120, COLOR_NEON_GREEN);
     
@@ -177,13 +204,8 @@ void render_join_input(void) {
         int box_y = 250;
         int box_w = 320;
         int box_h = 120;
-        int i;
         
-        for (i = 5; i > 0; i--) {
-            float alpha = (float)(5 - i + 1) / 6.0f * 0.15f;
-            Uint32 glow_color = darken_color(COLOR_NEON_GREEN, alpha);
-            fill_rect(box_x - i, box_y - i, box_w + i * 2, box_h + i * 2, glow_color);
-        }
+        draw_glow(box_x, box_y, box_w, box_h, COLOR_NEON_GREEN, 5, 0.15f);
         
         fill_rect(box_x, box_y, box_w, box_h, COLOR_PANEL);
         fill_rect(box_x, box_y, box_w, 2, COLOR_NEON_GREEN);
@@ -193,19 +215,25 @@ void render_join_input(void) {
     }
     
     draw_text(font_S, "CODE PARTIE :", WINDOW_W / 2, 275, COLOR_NEON_CYAN);
-    draw_input_field(140, 300, 260, 50, input_buffer, 1);
+}
+
+static void build_join_input(void) {
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
+    ui_add_backdrop(draw_join_input_backdrop);
     
-    draw_button(WINDOW_W / 2 - 90, 420, 180, 50, "ENTRER", COLOR_SUCCESS, strlen(input_buffer) != 4);
-    draw_button(WINDOW_W / 2 - 90, 500, 180, 50, "RETOUR", COLOR_DANGER, 0);
+    ui_add_input(ACT_NONE, 140, 300, 260, 50, input_buffer, 1);
+    
+    ui_add_button(ACT_VALIDATE, 0, WINDOW_W / 2 - 90, 420, 180, 50, "ENTRER", COLOR_SUCCESS, strlen(input_buffer) != 4);
+    ui_add_button(ACT_BACK, 0, WINDOW_W / 2 - 90, 500, 180, 50, "RETOUR", COLOR_DANGER, 0);
 }
 
-void render_server_browser(void) {
-    int i, j;
+#define BROWSER_ROWS 5
+#define BROWSER_Y 150
+#define BROWSER_ROW_H 105
+
+static void draw_server_browser_backdrop(void) {
+    int i;
     char line[128];
-    int y_start = 150;
-    int entry_height = 105;
-    
-    draw_settings_gear(window_w - 50, 20);
     
     draw_text(font_L, "SERVEURS", WINDOW_W / 2 + 2, 50 + 2, darken_color(COLOR_NEON_PURPLE, 0.3f));
     draw_text(font_L, "SERVEURS", WINDOW_W / 2, 50, COLOR_NEON_PURPLE);
@@ -217,71 +245,89 @@ void render_server_browser(void) {
         draw_neon_rect(WINDOW_W / 2 - 150, 300, 300, 120, COLOR_PANEL, COLOR_NEON_CYAN, 4);
         draw_text(font_S, "Aucun serveur", WINDOW_W / 2, 340, COLOR_GREY);
         draw_text(font_S, "disponible", WINDOW_W / 2, 370, COLOR_GREY);
-    } else {
-        for (j = 4; j > 0; j--) {
-            float alpha = (float)(4 - j + 1) / 5.0f * 0.1f;
-            Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-            fill_rect(20 - j, 120 - j, WINDOW_W - 40 + j * 2, 520 + j * 2, glow_color);
-        }
-        fill_rect(20, 120, WINDOW_W - 40, 520, COLOR_PANEL);
-        fill_rect(20, 120, WINDOW_W - 40, 2, COLOR_NEON_CYAN);
-        fill_rect(20, 638, WINDOW_W - 40, 2, COLOR_NEON_MAGENTA);
+        return;
+    }
+    
+    draw_glow(20, 120, WINDOW_W - 40, 520, COLOR_NEON_CYAN, 4, 0.1f);
+    fill_rect(20, 120, WINDOW_W - 40, 520, COLOR_PANEL);
+    fill_rect(20, 120, WINDOW_W - 40, 2, COLOR_NEON_CYAN);
+    fill_rect(20, 638, WINDOW_W - 40, 2, COLOR_NEON_MAGENTA);
+    
+    for (i = 0; i < BROWSER_ROWS; i++) {
+        int idx = i + browser_scroll_offset;
+        if (idx >= server_list.count) break;
         
-        for (i = 0; i < server_list.count && i < 5; i++) {
-            int idx = i + browser_scroll_offset;
-            if (idx >= server_list.count) break;
-            
-            ServerInfo *srv = &server_list.servers[idx];
-            int y = y_start + i * entry_height;
-            
-            fill_rect(30, y, WINDOW_W - 60, entry_height - 10, darken_color(COLOR_BG_LIGHTER, 0.8f));
-            
-            Uint32 status_color = srv->game_started ? COLOR_NEON_ORANGE : COLOR_NEON_GREEN;
-            fill_rect(30, y, 4, entry_height - 10, status_color);
-            
-            snprintf(line, sizeof(line), "Code: %s", srv->room_code);
-            draw_text_left(font_S, line, 45, y + 8, COLOR_NEON_CYAN);
-            
-            snprintf(line, sizeof(line), "Hote: %s", srv->host_name);
-            draw_text_left(font_S, line, 180, y + 8, COLOR_WHITE);
-            
-            snprintf(line, sizeof(line), "Joueurs: %d/4", srv->player_count);
-            draw_text_left(font_S, line, 45, y + 35, COLOR_GREY);
-            
-            const char *mode_str = srv->game_mode == GAME_MODE_RUSH ? "Rush" : "Classic";
-            Uint32 mode_color = srv->game_mode == GAME_MODE_RUSH ? COLOR_NEON_ORANGE : COLOR_NEON_CYAN;
-            snprintf(line, sizeof(line), "Mode: %s", mode_str);
-            draw_text_left(font_S, line, 180, y + 35, mode_color);
-            
-            if (srv->game_started) {
-                draw_text_left(font_S, "En cours", 45, y + 62, COLOR_NEON_ORANGE);
-                draw_button(WINDOW_W - 140, y + 8, 100, 35, "Rejoindre", COLOR_BTN_DISABLED, 1);
-            } else {
-                draw_text_left(font_S, "En attente", 45, y + 62, COLOR_NEON_GREEN);
-                draw_button(WINDOW_W - 140, y + 8, 100, 35, "Rejoindre", COLOR_SUCCESS, 0);
-            }
-            draw_button(WINDOW_W - 140, y + 50, 100, 35, "Observer", COLOR_PURPLE, 0);
-        }
+        ServerInfo *srv = &server_list.servers[idx];
+        int y = BROWSER_Y + i * BROWSER_ROW_H;
         
-        if (browser_scroll_offset > 0) {
-            draw_text(font_S, "^ Defiler ^", WINDOW_W / 2, 128, COLOR_NEON_CYAN);
-        }
-        if (browser_scroll_offset + 5 < server_list.count) {
-            draw_text(font_S, "v Defiler v", WINDOW_W / 2, 648, COLOR_NEON_MAGENTA);
+        fill_rect(30, y, WINDOW_W - 60, BROWSER_ROW_H - 10, darken_color(COLOR_BG_LIGHTER, 0.8f));
+        
+        Uint32 status_color = srv->game_started ? COLOR_NEON_ORANGE : COLOR_NEON_GREEN;
+        fill_rect(30, y, 4, BROWSER_ROW_H - 10, status_color);
+        
+        snprintf(line, sizeof(line), "Code: %s", srv->room_code);
+        draw_text_left(font_S, line, 45, y + 8, COLOR_NEON_CYAN);
+        
+        snprintf(line, sizeof(line), "Hote: %s", srv->host_name);
+        draw_text_left(font_S, line, 180, y + 8, COLOR_WHITE);
+        
+        snprintf(line, sizeof(line), "Joueurs: %d/4", srv->player_count);
+        draw_text_left(font_S, line, 45, y + 35, COLOR_GREY);
+        
+        const char *mode_str = srv->game_mode == GAME_MODE_RUSH ? "Rush" : "Classic";
+        Uint32 mode_color = srv->game_mode == GAME_MODE_RUSH ? COLOR_NEON_ORANGE : COLOR_NEON_CYAN;
+        snprintf(line, sizeof(line), "Mode: %s", mode_str);
+        draw_text_left(font_S, line, 180, y + 35, mode_color);
+        
+        if (srv->game_started) {
+            draw_text_left(font_S, "En cours", 45, y + 62, COLOR_NEON_ORANGE);
+        } else {
+            draw_text_left(font_S, "En attente", 45, y + 62, COLOR_NEON_GREEN);
         }
     }
     
-    draw_button(WINDOW_W / 2 - 90, 680, 180, 45, "Actualiser", COLOR_BUTTON, 0);
-    draw_button(WINDOW_W / 2 - 90, 735, 180, 45, "RETOUR", COLOR_DANGER, 0);
+    if (browser_scroll_offset > 0) {
+        draw_text(font_S, "^ Defiler ^", WINDOW_W / 2, 128, COLOR_NEON_CYAN);
+    }
+    if (browser_scroll_offset + BROWSER_ROWS < server_list.count) {
+        draw_text(font_S, "v Defiler v", WINDOW_W / 2, 648, COLOR_NEON_MAGENTA);
+    }
+}
+
+static Uint32 server_browser_key(void) {
+    Uint32 h = ui_hash(UI_HASH_SEED, &server_list, sizeof(server_list));
+    return ui_hash(h, &browser_scroll_offset, sizeof(browser_scroll_offset));
+}
+
+static void build_server_browser(void) {
+    int i;
+    
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
+    ui_add_backdrop(draw_server_browser_backdrop);
+    
+    for (i = 0; i < BROWSER_ROWS; i++) {
+        int idx = i + browser_scroll_offset;
+        int y = BROWSER_Y + i * BROWSER_ROW_H;
+        if (idx >= server_list.count) break;
+        
+        ui_add_button(ACT_JOIN, idx, WINDOW_W - 140, y + 8, 100, 35, "Rejoindre", COLOR_SUCCESS,
+                      server_list.servers[idx].game_started);
+        ui_add_button(ACT_WATCH, idx, WINDOW_W - 140, y + 50, 100, 35, "Observer", COLOR_PURPLE, 0);
+    }
+    
+    ui_add_button(ACT_REFRESH, 0, WINDOW_W / 2 - 90, 680, 180, 45, "Actualiser", COLOR_BUTTON, 0);
+    ui_add_button(ACT_BACK, 0, WINDOW_W / 2 - 90, 735, 180, 45, "RETOUR", COLOR_DANGER, 0);
 }
 
-void render_lobby(void) {
+static int lobby_need_players(void) {
+    return current_lobby.player_count < 2 - current_lobby.spectator_count;
+}
+
+static void draw_lobby_backdrop(void) {
     int i;
     char title[64];
     char mode_str[32];
     
-    draw_settings_gear(window_w - 50, 20);
-    
     snprintf(title, sizeof(title), "CODE: %s", current_lobby.room_code);
     draw_text(font_L, title, WINDOW_W / 2 + 2, 50 + 2, darken_color(COLOR_NEON_GREEN, 0.3f));
     draw_text(font_L, title, WINDOW_W / 2, 50, COLOR_NEON_GREEN);
@@ -298,11 +344,7 @@ void render_lobby(void) {
         int panel_w = WINDOW_W - 100;
         int panel_h = 170;
         
-        for (i = 4; i > 0; i--) {
-            float alpha = (float)(4 - i + 1) / 5.0f * 0.1f;
-            Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-            fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-        }
+        draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_CYAN, 4, 0.1f);
         fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
         fill_rect(panel_x, panel_y, panel_w, 2, COLOR_NEON_CYAN);
         fill_rect(panel_x, panel_y + panel_h - 2, panel_w, 2, COLOR_NEON_CYAN);
@@ -330,68 +372,149 @@ void render_lobby(void) {
         
         if (i == 0) {
             draw_text(font_S, "[HOST]", name_x + 100, name_y, COLOR_GOLD);
+        } else if (current_lobby.is_bot[i]) {
+            draw_text(font_S, "[IA]", name_x + 100, name_y, COLOR_NEON_ORANGE);
         }
     }
     
     if (current_lobby.is_host && !current_lobby.game_started) {
-        int mode_y = 320;
+        draw_text(font_S, "MODE DE JEU :", WINDOW_W / 2, 320, COLOR_WHITE);
+    } else if (!current_lobby.is_host) {
+        snprintf(mode_str, sizeof(mode_str), "Mode: %s", 
+                 current_lobby.game_mode == GAME_MODE_RUSH ? "Rush" : "Classic");
+        draw_text(font_S, mode_str, WINDOW_W / 2, 350, COLOR_GOLD);
         
-        draw_text(font_S, "MODE DE JEU :", WINDOW_W / 2, mode_y, COLOR_WHITE);
+        if (current_lobby.game_mode == GAME_MODE_RUSH) {
+            snprintf(mode_str, sizeof(mode_str), "Duree: %d minutes", current_lobby.timer_minutes);
+            draw_text(font_S, mode_str, WINDOW_W / 2, 380, COLOR_CYAN);
+        }
         
-        int classic_selected = (selected_game_mode == GAME_MODE_CLASSIC);
-        Uint32 classic_color = classic_selected ? COLOR_CYAN : COLOR_BUTTON;
-        draw_button(WINDOW_W / 2 - 160, mode_y + 25, 150, 35, "Classic", classic_color, 0);
+        snprintf(mode_str, sizeof(mode_str), "Grille: %dx%d", current_lobby.grid_size, current_lobby.grid_size);
+        draw_text(font_S, mode_str, WINDOW_W / 2, 410, COLOR_WHITE);
         
-        int rush_selected = (selected_game_mode == GAME_MODE_RUSH);
-        Uint32 rush_color = rush_selected ? COLOR_CYAN : COLOR_BUTTON;
-        draw_button(WINDOW_W / 2 + 10, mode_y + 25, 150, 35, "Rush", rush_color, 0);
+        snprintf(mode_str, sizeof(mode_str), "Score: %s", score_rules(current_lobby.ruleset)->name);
+        draw_text(font_S, mode_str, WINDOW_W / 2, 440, COLOR_WHITE);
         
-        if (selected_game_mode == GAME_MODE_RUSH) {
-            draw_text(font_S, "DUREE :", WINDOW_W / 2, mode_y + 80, COLOR_WHITE);
-            
-            draw_button(WINDOW_W / 2 - 200, mode_y + 100, 55, 30, "1m", 
-                       selected_timer_minutes == 1 ? COLOR_CYAN : COLOR_BUTTON, 0);
-            draw_button(WINDOW_W / 2 - 130, mode_y + 100, 55, 30, "2m", 
-                       selected_timer_minutes == 2 ? COLOR_CYAN : COLOR_BUTTON, 0);
-            draw_button(WINDOW_W / 2 - 60, mode_y + 100, 55, 30, "3m", 
-                       selected_timer_minutes == 3 ? COLOR_CYAN : COLOR_BUTTON, 0);
-            draw_button(WINDOW_W / 2 + 10, mode_y + 100, 55, 30, "5m", 
-                       selected_timer_minutes == 5 ? COLOR_CYAN : COLOR_BUTTON, 0);
-            draw_button(WINDOW_W / 2 + 80, mode_y + 100, 55, 30, "10m", 
-                       selected_timer_minutes == 10 ? COLOR_CYAN : COLOR_BUTTON, 0);
+        draw_text(font_S, "En attente du lancement...", WINDOW_W / 2, 480, COLOR_GREY);
+    }
+    
+    if (current_lobby.is_host && current_lobby.player_count > 1) {
+        draw_text(font_S, "(Clic droit pour expulser)", WINDOW_W / 2, 790, COLOR_GREY);
+    }
+}
+
+static Uint32 lobby_key(void) {
+    Uint32 h = ui_hash(UI_HASH_SEED, &current_lobby, sizeof(current_lobby));
+    h = ui_hash(h, my_pseudo, sizeof(my_pseudo));
+    h = ui_hash(h, &selected_game_mode, sizeof(selected_game_mode));
+    h = ui_hash(h, &selected_timer_minutes, sizeof(selected_timer_minutes));
+    return ui_hash(h, &selected_bot_level, sizeof(selected_bot_level));
+}
+
+static void build_lobby(void) {
+    static const int timer_minutes[] = {1, 2, 3, 5, 10};
+    char label[32];
+    int i;
+    
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
+    ui_add_backdrop(draw_lobby_backdrop);
+    
+    if (current_lobby.is_host && !current_lobby.game_started) {
+        int mode_y = 320;
+        int rush = selected_game_mode == GAME_MODE_RUSH;
+        int toggle_y = rush ? mode_y + 150 : mode_y + 80;
+        int start_y = rush ? 605 : 535;
+        int need_players = lobby_need_players();
+        
+        ui_add_button(ACT_MODE, GAME_MODE_CLASSIC, WINDOW_W / 2 - 160, mode_y + 25, 150, 35, "Classic",
+                      !rush ? COLOR_CYAN : COLOR_BUTTON, 0);
+        ui_add_button(ACT_MODE, GAME_MODE_RUSH, WINDOW_W / 2 + 10, mode_y + 25, 150, 35, "Rush",
+                      rush ? COLOR_CYAN : COLOR_BUTTON, 0);
+        
+        if (rush) {
+            ui_add_label(WINDOW_W / 2, mode_y + 80, "DUREE :", COLOR_WHITE);
+            for (i = 0; i < 5; i++) {
+                snprintf(label, sizeof(label), "%dm", timer_minutes[i]);
+                ui_add_button(ACT_TIMER, timer_minutes[i], WINDOW_W / 2 - 200 + i * 70, mode_y + 100, 55, 30, label,
+                              selected_timer_minutes == timer_minutes[i] ? COLOR_CYAN : COLOR_BUTTON, 0);
+            }
         }
         
-        int toggle_y = selected_game_mode == GAME_MODE_RUSH ? mode_y + 150 : mode_y + 80;
-        const char *visibility_text = current_lobby.is_public ? "Rendre Privee" : "Rendre Publique";
-        draw_button(WINDOW_W / 2 - 90, toggle_y, 180, 35, visibility_text, COLOR_PURPLE, 0);
+        ui_add_button(ACT_VISIBILITY, 0, WINDOW_W / 2 - 200, toggle_y, 180, 35,
+                      current_lobby.is_public ? "Rendre Privee" : "Rendre Publique", COLOR_PURPLE, 0);
         
-        int start_y = selected_game_mode == GAME_MODE_RUSH ? 530 : 470;
-        int need_players = current_lobby.player_count < 2 - current_lobby.spectator_count;
+        snprintf(label, sizeof(label), "%dx%d", current_lobby.grid_size, current_lobby.grid_size);
+        ui_add_button(ACT_GRID_SMALLER, 0, WINDOW_W / 2 + 20, toggle_y, 35, 35, "-", COLOR_BUTTON,
+                      current_lobby.grid_size <= GRID_MIN);
+        ui_add_label(WINDOW_W / 2 + 100, toggle_y + 17, label, COLOR_WHITE);
+        ui_add_button(ACT_GRID_BIGGER, 0, WINDOW_W / 2 + 145, toggle_y, 35, 35, "+", COLOR_BUTTON,
+                      current_lobby.grid_size >= GRID_MAX);
         
-        if (need_players) {
-            draw_text(font_S, "En attente d'autres joueurs...", WINDOW_W / 2, start_y, COLOR_GREY);
-            start_y += 40;
-        }
+        snprintf(label, sizeof(label), "Score: %s", score_rules(current_lobby.ruleset)->name);
+        ui_add_button(ACT_RULESET, 0, WINDOW_W / 2 - 200, toggle_y + 45, 380, 35, label, COLOR_BUTTON, 0);
         
-        draw_button(WINDOW_W / 2 - 150, start_y, 300, 55, "LANCER LA PARTIE", COLOR_SUCCESS, need_players);
-    } else if (!current_lobby.is_host) {
-        snprintf(mode_str, sizeof(mode_str), "Mode: %s", 
-                 current_lobby.game_mode == GAME_MODE_RUSH ? "Rush" : "Classic");
-        draw_text(font_S, mode_str, WINDOW_W / 2, 350, COLOR_GOLD);
+        ui_add_button(ACT_ADD_BOT, 0, WINDOW_W / 2 - 200, toggle_y + 90, 240, 35, "+ Ajouter une IA",
+                      COLOR_NEON_ORANGE, current_lobby.player_count >= 4);
+        ui_add_button(ACT_BOT_LEVEL, 0, WINDOW_W / 2 + 50, toggle_y + 90, 130, 35,
+                      bot_level(selected_bot_level)->name, COLOR_BUTTON, 0);
         
-        if (current_lobby.game_mode == GAME_MODE_RUSH) {
-            snprintf(mode_str, sizeof(mode_str), "Duree: %d minutes", current_lobby.timer_minutes);
-            draw_text(font_S, mode_str, WINDOW_W / 2, 380, COLOR_CYAN);
+        if (need_players) {
+            ui_add_label(WINDOW_W / 2, start_y, "En attente d'autres joueurs...", COLOR_GREY);
+            start_y += 40;
         }
         
-        draw_text(font_S, "En attente du lancement...", WINDOW_W / 2, 450, COLOR_GREY);
+        ui_add_button(ACT_START, 0, WINDOW_W / 2 - 150, start_y, 300, 55, "LANCER LA PARTIE", COLOR_SUCCESS, need_players);
     }
     
-    draw_button(WINDOW_W / 2 - 90, 660, 180, 50, "QUITTER", COLOR_DANGER, 0);
+    ui_add_button(ACT_BACK, 0, WINDOW_W / 2 - 90, 720, 180, 50, "QUITTER", COLOR_DANGER, 0);
     
-    if (current_lobby.is_host && current_lobby.player_count > 1) {
-        draw_text(font_S, "(Clic droit pour expulser)", WINDOW_W / 2, 720, COLOR_GREY);
+    /* The rows the player names are drawn on, for the host to right click */
+    if (current_lobby.is_host) {
+        for (i = 1; i < current_lobby.player_count; i++) {
+            ui_add_area(ACT_KICK, i, 70, 175 + i * 32 - 12, WINDOW_W - 140, 24);
+        }
+    }
+}
+
+/* Solo draws its board itself, only the tool bar above it is made of widgets */
+static Uint32 solo_key(void) {
+    int state[4];
+    
+    state[0] = game.game_over;
+    state[1] = hint_visible || hint_pending();
+    state[2] = undo_can_undo(&solo_history);
+    state[3] = undo_can_redo(&solo_history);
+    return ui_hash(UI_HASH_SEED, state, sizeof(state));
+}
+
+static void build_solo(void) {
+    ui_add_gear(ACT_SETTINGS, window_w - 50, 20);
+    ui_add_tool(WIDGET_HINT, ACT_HINT, 20, 20, hint_visible || hint_pending(), game.game_over);
+    ui_add_tool(WIDGET_UNDO, ACT_UNDO, 56, 20, undo_can_undo(&solo_history), 0);
+    ui_add_tool(WIDGET_REDO, ACT_REDO, 92, 20, undo_can_redo(&solo_history), 0);
+}
+
+static const UiScreen menu_ui = {menu_key, build_menu};
+static const UiScreen options_ui = {options_key, build_options};
+static const UiScreen login_ui = {input_key, build_login};
+static const UiScreen multi_choice_ui = {multi_choice_key, build_multi_choice};
+static const UiScreen join_input_ui = {input_key, build_join_input};
+static const UiScreen server_browser_ui = {server_browser_key, build_server_browser};
+static const UiScreen lobby_ui = {lobby_key, build_lobby};
+static const UiScreen solo_ui = {solo_key, build_solo};
+
+const UiScreen *screen_ui(int state) {
+    switch (state) {
+        case ST_MENU: return &menu_ui;
+        case ST_OPTIONS: return &options_ui;
+        case ST_LOGIN: return &login_ui;
+        case ST_MULTI_CHOICE: return &multi_choice_ui;
+        case ST_JOIN_INPUT: return &join_input_ui;
+        case ST_SERVER_BROWSER: return &server_browser_ui;
+        case ST_LOBBY: return &lobby_ui;
+        case ST_SOLO: return &solo_ui;
     }
+    return NULL;
 }
 
 void render_game_grid(void) {
@@ -409,18 +532,11 @@ void render_game_grid_ex(GameState *gs, int offset_x, int offset_y) {
     
     int base_x = grid_offset_x + offset_x + shake_x;
     int base_y = grid_offset_y + offset_y + shake_y;
-    int grid_w = GRID_W * block_size;
-    int grid_h = GRID_H * block_size;
+    int n = gs->grid_size;
+    int grid_w = n * block_size;
+    int grid_h = n * block_size;
     
-    {
-        int glow_layers = 6;
-        for (i = glow_layers; i > 0; i--) {
-            float alpha = (float)(glow_layers - i + 1) / (float)(glow_layers + 1) * 0.15f;
-            Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-            fill_rect(base_x - 8 - i, base_y - 8 - i, 
-                      grid_w + 16 + i * 2, grid_h + 16 + i * 2, glow_color);
-        }
-    }
+    draw_glow(base_x - 8, base_y - 8, grid_w + 16, grid_h + 16, COLOR_NEON_CYAN, 6, 0.15f);
     
     fill_rect(base_x - 8, base_y - 8, grid_w + 16, grid_h + 16, COLOR_PANEL);
     
@@ -436,8 +552,8 @@ void render_game_grid_ex(GameState *gs, int offset_x, int offset_y) {
     
     fill_rect(base_x, base_y, grid_w, grid_h, COLOR_GRID_CELL);
     
-    for (i = 0; i < GRID_H; i++) {
-        for (j = 0; j < GRID_W; j++) {
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
             int cell_x = base_x + j * block_size;
             int cell_y = base_y + i * block_size;
             
@@ -448,14 +564,14 @@ void render_game_grid_ex(GameState *gs, int offset_x, int offset_y) {
         }
     }
     
-    for (i = 0; i <= GRID_H; i++) {
+    for (i = 0; i <= n; i++) {
         fill_rect(base_x, base_y + i * block_size - 1, grid_w, 1, 
                   darken_color(COLOR_NEON_CYAN, 0.1f));
         fill_rect(base_x, base_y + i * block_size + 1, grid_w, 1, 
                   darken_color(COLOR_NEON_CYAN, 0.1f));
         fill_rect(base_x, base_y + i * block_size, grid_w, 1, COLOR_GRID);
     }
-    for (j = 0; j <= GRID_W; j++) {
+    for (j = 0; j <= n; j++) {
         fill_rect(base_x + j * block_size - 1, base_y, 1, grid_h, 
                   darken_color(COLOR_NEON_MAGENTA, 0.1f));
         fill_rect(base_x + j * block_size + 1, base_y, 1, grid_h, 
@@ -463,23 +579,27 @@ void render_game_grid_ex(GameState *gs, int offset_x, int offset_y) {
         fill_rect(base_x + j * block_size, base_y, 1, grid_h, COLOR_GRID);
     }
     
-    for (i = 0; i < GRID_H; i++) {
-        for (j = 0; j < GRID_W; j++) {
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
             if (gs->grid[i][j] != 0) {
                 draw_styled_block(base_x + j * block_size + 2,
                                   base_y + i * block_size + 2,
-                                  block_size - 4, gs->grid[i][j]);
+                                  block_size - 4, cell_color(gs->grid[i][j]));
             }
         }
     }
     
-    render_effects(&gs->effects, shake_x + offset_x, shake_y + offset_y);
+    {
+        int phase = profiler_phase(PHASE_EFFECTS);
+        render_effects(&gs->effects, n, shake_x + offset_x, shake_y + offset_y);
+        profiler_phase(phase);
+    }
 }
 
-void render_mini_grid(int grid[GRID_H][GRID_W], int x, int y, int bs, const char *label, int score, int is_selected) {
+void render_mini_grid(Cell grid[GRID_MAX][GRID_MAX], int size, int x, int y, int bs, const char *label, int score, int is_selected) {
     int i, j;
-    int grid_w = GRID_W * bs;
-    int grid_h = GRID_H * bs;
+    int grid_w = size * bs;
+    int grid_h = size * bs;
     char score_str[32];
     
     if (is_selected) {
@@ -489,10 +609,10 @@ void render_mini_grid(int grid[GRID_H][GRID_W], int x, int y, int bs, const char
     fill_rect(x - 2, y - 2, grid_w + 4, grid_h + 4, 0x151520);
     fill_rect(x, y, grid_w, grid_h, 0x202030);
     
-    for (i = 0; i < GRID_H; i++) {
-        for (j = 0; j < GRID_W; j++) {
+    for (i = 0; i < size; i++) {
+        for (j = 0; j < size; j++) {
             if (grid[i][j] != 0) {
-                fill_rect(x + j * bs, y + i * bs, bs - 1, bs - 1, grid[i][j]);
+                fill_rect(x + j * bs, y + i * bs, bs - 1, bs - 1, cell_color(grid[i][j]));
             }
         }
     }
@@ -525,14 +645,14 @@ void render_pieces(int greyed) {
             slot_x = window_w / 2 + 40;
             slot_y = 200 + i * slot_h;
             
-            int piece_px = slot_x + (slot_w - p->w * piece_block_size) / 2;
-            int piece_py = slot_y + (slot_h - p->h * piece_block_size) / 2;
+            int piece_px = slot_x + (slot_w - piece_w(p) * piece_block_size) / 2;
+            int piece_py = slot_y + (slot_h - piece_h(p) * piece_block_size) / 2;
             
-            for (j = 0; j < p->h; j++) {
-                for (k = 0; k < p->w; k++) {
-                    if (p->data[j][k]) {
-                        Uint32 color = p->color;
-                        if (greyed) {
+            for (j = 0; j < piece_h(p); j++) {
+                for (k = 0; k < piece_w(p); k++) {
+                    if (piece_cell(p, j, k)) {
+                        Uint32 color = piece_color(p);
+                        if (greyed || !game_slot_playable(&game, i)) {
                             int r = ((color >> 16) & 0xFF) / 3;
                             int g = ((color >> 8) & 0xFF) / 3;
                             int b = (color & 0xFF) / 3;
@@ -555,14 +675,14 @@ void render_pieces(int greyed) {
             slot_x = 30 + i * slot_w;
             slot_y = piece_area_y;
             
-            int piece_px = slot_x + (slot_w - p->w * piece_block_size) / 2;
-            int piece_py = slot_y + (slot_h - p->h * piece_block_size) / 2;
+            int piece_px = slot_x + (slot_w - piece_w(p) * piece_block_size) / 2;
+            int piece_py = slot_y + (slot_h - piece_h(p) * piece_block_size) / 2;
             
-            for (j = 0; j < p->h; j++) {
-                for (k = 0; k < p->w; k++) {
-                    if (p->data[j][k]) {
-                        Uint32 color = p->color;
-                        if (greyed) {
+            for (j = 0; j < piece_h(p); j++) {
+                for (k = 0; k < piece_w(p); k++) {
+                    if (piece_cell(p, j, k)) {
+                        Uint32 color = piece_color(p);
+                        if (greyed || !game_slot_playable(&game, i)) {
                             int r = ((color >> 16) & 0xFF) / 3;
                             int g = ((color >> 8) & 0xFF) / 3;
                             int b = (color & 0xFF) / 3;
@@ -576,6 +696,98 @@ void render_pieces(int greyed) {
     }
 }
 
+/* The move map is rebuilt only when the board or the dragged piece changes,
+ * the preview only when the snapped cell does */
+typedef struct {
+    int valid;
+    int piece_idx;
+    int piece_id;
+    uint64_t board_hash;
+    int board_size;
+    BBMoveMap map;
+    int row, col;
+    int legal;
+    BBClear clear;
+    int points;
+} DragPreview;
+
+static DragPreview drag_preview;
+
+static void update_drag_preview(const Piece *p) {
+    DragPreview *dp = &drag_preview;
+    int row, col;
+    
+    if (!dp->valid || dp->piece_idx != selected_piece_idx || dp->piece_id != (int)p->id ||
+        dp->board_hash != game.hash || dp->board_size != game.grid_size) {
+        dp->valid = 1;
+        dp->piece_idx = selected_piece_idx;
+        dp->piece_id = p->id;
+        dp->board_hash = game.hash;
+        dp->board_size = game.grid_size;
+        game_move_map(&game, selected_piece_idx, &dp->map);
+        dp->row = -GRID_MAX;
+        dp->col = -GRID_MAX;
+    }
+    
+    dragged_piece_anchor(p, &row, &col);
+    if (row == dp->row && col == dp->col) return;
+    
+    dp->row = row;
+    dp->col = col;
+    dp->legal = row >= 0 && row < game.grid_size && col >= 0 && col < game.grid_size &&
+                (dp->map.legal[row] & (1u << col));
+    if (!dp->legal) return;
+    
+    dp->clear = bb_move_clear(&dp->map, row, col);
+    dp->points = 0;
+    if (dp->clear.rows | dp->clear.cols) {
+        BitBoard after;
+        int lines;
+        
+        bb_from_grid(&after, game.grid, game.grid_size);
+        lines = bb_apply(&after, &piece_info(p)->bb, row, col, &dp->clear);
+        dp->points = game_move_points(&game, p, lines, bb_is_empty(&after));
+    }
+}
+
+static void render_drag_preview(const Piece *p) {
+    DragPreview *dp = &drag_preview;
+    Uint32 color = piece_color(p);
+    int i, j;
+    
+    if (!dp->legal) return;
+    
+    for (i = 0; i < piece_h(p); i++) {
+        for (j = 0; j < piece_w(p); j++) {
+            if (piece_cell(p, i, j)) {
+                draw_styled_block(grid_offset_x + (dp->col + j) * block_size + 2,
+                                  grid_offset_y + (dp->row + i) * block_size + 2,
+                                  block_size - 4, darken_color(color, 0.45f));
+            }
+        }
+    }
+    
+    if (!(dp->clear.rows | dp->clear.cols)) return;
+    
+    /* Lines about to clear take the colour of the piece completing them */
+    for (i = 0; i < game.grid_size; i++) {
+        for (j = 0; j < game.grid_size; j++) {
+            if (((dp->clear.rows >> i) & 1u) || ((dp->clear.cols >> j) & 1u)) {
+                draw_styled_block(grid_offset_x + j * block_size + 2,
+                                  grid_offset_y + i * block_size + 2,
+                                  block_size - 4, color);
+            }
+        }
+    }
+    
+    {
+        char points[16];
+        snprintf(points, sizeof(points), "+%d", dp->points);
+        draw_text(font_S, points, grid_offset_x + (dp->col * 2 + piece_w(p)) * block_size / 2,
+                  grid_offset_y + dp->row * block_size - 14, COLOR_NEON_YELLOW);
+    }
+}
+
 void render_dragged_piece(void) {
     int j, k;
     
@@ -583,27 +795,85 @@ void render_dragged_piece(void) {
     
     Piece *p = &game.current_pieces[selected_piece_idx];
     
-    int base_x = mouse_x - (p->w * block_size) / 2;
-    int base_y = mouse_y - (p->h * block_size) / 2;
+    update_drag_preview(p);
+    render_drag_preview(p);
+    
+    int base_x = mouse_x - (piece_w(p) * block_size) / 2;
+    int base_y = mouse_y - (piece_h(p) * block_size) / 2;
     
-    for (j = 0; j < p->h; j++) {
-        for (k = 0; k < p->w; k++) {
-            if (p->data[j][k]) {
+    for (j = 0; j < piece_h(p); j++) {
+        for (k = 0; k < piece_w(p); k++) {
+            if (piece_cell(p, j, k)) {
                 draw_styled_block(base_x + k * block_size, 
                                   base_y + j * block_size, 
-                                  block_size - 2, p->color);
+                                  block_size - 2, piece_color(p));
             }
         }
     }
 }
 
+static void render_hint(void) {
+    const SolverMove *m;
+    Piece *p;
+    Uint32 color;
+    int j, k;
+    
+    if (!hint_visible || hint_result.count <= 0 || game.game_over) return;
+    
+    m = &hint_result.moves[0];
+    p = &game.current_pieces[m->piece_idx];
+    if (!game.pieces_available[m->piece_idx] || !can_place(&game, m->row, m->col, p)) {
+        hint_visible = 0;
+        return;
+    }
+    
+    color = darken_color(COLOR_NEON_YELLOW, 0.7f + 0.3f * sinf(glow_pulse * 3.0f));
+    
+    for (j = 0; j < piece_h(p); j++) {
+        for (k = 0; k < piece_w(p); k++) {
+            if (piece_cell(p, j, k)) {
+                int x = grid_offset_x + (m->col + k) * block_size;
+                int y = grid_offset_y + (m->row + j) * block_size;
+                fill_rect(x + 2, y + 2, block_size - 4, 2, color);
+                fill_rect(x + 2, y + block_size - 4, block_size - 4, 2, color);
+                fill_rect(x + 2, y + 2, 2, block_size - 4, color);
+                fill_rect(x + block_size - 4, y + 2, 2, block_size - 4, color);
+            }
+        }
+    }
+    
+    if (selected_piece_idx != m->piece_idx) {
+        int slot_x, slot_y, slot_w, slot_h;
+        
+        if (layout_horizontal) {
+            slot_w = window_w / 2 - 80;
+            slot_h = (window_h - 280) / 3;
+            slot_x = window_w / 2 + 40;
+            slot_y = 200 + m->piece_idx * slot_h;
+        } else {
+            slot_w = (window_w - 60) / 3;
+            slot_h = window_h - piece_area_y - 20;
+            slot_x = 30 + m->piece_idx * slot_w;
+            slot_y = piece_area_y;
+        }
+        
+        fill_rect(slot_x + 4, slot_y + 4, slot_w - 8, 2, color);
+        fill_rect(slot_x + 4, slot_y + slot_h - 6, slot_w - 8, 2, color);
+        fill_rect(slot_x + 4, slot_y + 4, 2, slot_h - 8, color);
+        fill_rect(slot_x + slot_w - 6, slot_y + 4, 2, slot_h - 8, color);
+    }
+}
+
 void render_solo(void) {
     char score_text[64];
-    int i;
     
-    draw_settings_gear(window_w - 50, 20);
+    ui_render();
     
-    update_effects(&game.effects, delta_time);
+    {
+        int phase = profiler_phase(PHASE_EFFECTS);
+        update_effects(&game.effects, delta_time);
+        profiler_phase(phase);
+    }
     
     if (game.score > solo_high_score) {
         solo_high_score = game.score;
@@ -629,11 +899,7 @@ void render_solo(void) {
             int panel_w = window_w / 2 - 50;
             int panel_h = window_h - 220;
             
-            for (i = 3; i > 0; i--) {
-                float alpha = (float)(3 - i + 1) / 4.0f * 0.1f;
-                Uint32 glow_color = darken_color(COLOR_NEON_MAGENTA, alpha);
-                fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-            }
+            draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_MAGENTA, 3, 0.1f);
             fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
             fill_rect(panel_x, panel_y, panel_w, 2, COLOR_NEON_MAGENTA);
         }
@@ -651,32 +917,25 @@ void render_solo(void) {
             int panel_w = window_w - 40;
             int panel_h = window_h - piece_area_y + 5;
             
-            for (i = 3; i > 0; i--) {
-                float alpha = (float)(3 - i + 1) / 4.0f * 0.1f;
-                Uint32 glow_color = darken_color(COLOR_NEON_MAGENTA, alpha);
-                fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-            }
+            draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_MAGENTA, 3, 0.1f);
             fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
             fill_rect(panel_x, panel_y, panel_w, 2, COLOR_NEON_MAGENTA);
         }
     }
     
     render_pieces(0);
+    render_hint();
     render_dragged_piece();
     
     if (game.game_over) {
-        fill_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.6f));
+        blend_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.6f), 0.85f);
         
         int panel_x = 40;
         int panel_y = window_h / 2 - 100;
         int panel_w = window_w - 80;
         int panel_h = 200;
         
-        for (i = 8; i > 0; i--) {
-            float alpha = (float)(8 - i + 1) / 9.0f * 0.2f;
-            Uint32 glow_color = darken_color(COLOR_NEON_RED, alpha);
-            fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-        }
+        draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_RED, 8, 0.2f);
         
         fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
         fill_rect(panel_x, panel_y, panel_w, 3, COLOR_NEON_RED);
@@ -695,17 +954,33 @@ void render_solo(void) {
         }
         
         draw_text(font_S, "Cliquez pour continuer", window_w / 2, window_h / 2 + 70, COLOR_NEON_CYAN);
+        
+        if (undo_can_undo(&solo_history)) {
+            draw_text(font_XS, "Ctrl+Z pour annuler le dernier coup", window_w / 2, window_h / 2 + 88, COLOR_GREY);
+        }
     }
 }
 
+/* Only rulesets that pay for streaks show them */
+static void draw_streak(int x, int y) {
+    char streak_text[32];
+    
+    if (game.streak < 2 || score_rules(game.ruleset)->streak_bonus == 0) return;
+    snprintf(streak_text, sizeof(streak_text), "SERIE x%d", game.streak);
+    draw_text(font_XS ? font_XS : font_S, streak_text, x, y, COLOR_NEON_ORANGE);
+}
+
 void render_multi_game(void) {
     char score_text[32];
     char turn_text[64];
-    int i;
     
     draw_settings_gear(window_w - 50, 20);
     
-    update_effects(&game.effects, delta_time);
+    {
+        int phase = profiler_phase(PHASE_EFFECTS);
+        update_effects(&game.effects, delta_time);
+        profiler_phase(phase);
+    }
     
     if (current_lobby.game_mode == GAME_MODE_RUSH) {
         render_rush_game();
@@ -728,6 +1003,7 @@ void render_multi_game(void) {
     
     snprintf(score_text, sizeof(score_text), "Score: %d", game.score);
     draw_text(font_S, score_text, WINDOW_W / 2, 65, COLOR_NEON_GREEN);
+    draw_streak(WINDOW_W / 2 + 150, 65);
     
     render_game_grid_ex(&game, 0, 0);
     
@@ -737,11 +1013,7 @@ void render_multi_game(void) {
         int panel_w = WINDOW_W - 40;
         int panel_h = PIECE_SLOT_H + 30;
         
-        for (i = 3; i > 0; i--) {
-            float alpha = (float)(3 - i + 1) / 4.0f * 0.1f;
-            Uint32 glow_color = darken_color(COLOR_NEON_MAGENTA, alpha);
-            fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-        }
+        draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_MAGENTA, 3, 0.1f);
         fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
         fill_rect(panel_x, panel_y, panel_w, 2, COLOR_NEON_MAGENTA);
     }
@@ -753,18 +1025,14 @@ void render_multi_game(void) {
     }
     
     if (multi_game_over == 1) {
-        fill_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.6f));
+        blend_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.6f), 0.85f);
         
         int panel_x = 40;
         int panel_y = window_h / 2 - 100;
         int panel_w = window_w - 80;
         int panel_h = 200;
         
-        for (i = 8; i > 0; i--) {
-            float alpha = (float)(8 - i + 1) / 9.0f * 0.2f;
-            Uint32 glow_color = darken_color(COLOR_NEON_RED, alpha);
-            fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-        }
+        draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_NEON_RED, 8, 0.2f);
         
         fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
         fill_rect(panel_x, panel_y, panel_w, 3, COLOR_NEON_RED);
@@ -784,18 +1052,14 @@ void render_multi_game(void) {
         draw_text(font_S, "Cliquez pour continuer", window_w / 2, window_h / 2 + 70, COLOR_GREY);
     }
     else if (multi_game_over == 2) {
-        fill_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.6f));
+        blend_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.6f), 0.85f);
         
         int panel_x = 40;
         int panel_y = window_h / 2 - 120;
         int panel_w = window_w - 80;
         int panel_h = 240;
         
-        for (i = 8; i > 0; i--) {
-            float alpha = (float)(8 - i + 1) / 9.0f * 0.2f;
-            Uint32 glow_color = darken_color(COLOR_GOLD, alpha);
-            fill_rect(panel_x - i, panel_y - i, panel_w + i * 2, panel_h + i * 2, glow_color);
-        }
+        draw_glow(panel_x, panel_y, panel_w, panel_h, COLOR_GOLD, 8, 0.2f);
         
         fill_rect(panel_x, panel_y, panel_w, panel_h, COLOR_PANEL);
         fill_rect(panel_x, panel_y, panel_w, 3, COLOR_GOLD);
@@ -852,20 +1116,20 @@ void render_rush_game(void) {
     if (is_spectator) {
         draw_text(font_L, "SPECTATEUR", WINDOW_W / 2, 70, COLOR_PURPLE);
         
-        int mini_block = 15;
+        int mini_block = 150 / game.grid_size;
         int spacing = 20;
-        int total_width = rush_player_count * (GRID_W * mini_block) + (rush_player_count - 1) * spacing;
+        int total_width = rush_player_count * (game.grid_size * mini_block) + (rush_player_count - 1) * spacing;
         int start_x = (WINDOW_W - total_width) / 2;
         
         for (i = 0; i < rush_player_count; i++) {
-            int grid_x = start_x + i * (GRID_W * mini_block + spacing);
+            int grid_x = start_x + i * (game.grid_size * mini_block + spacing);
             int is_selected = (spectate_view_idx == i);
-            render_mini_grid(rush_states[i].grid, grid_x, 100, mini_block, 
+            render_mini_grid(rush_grids[i], game.grid_size, grid_x, 100, mini_block, 
                            rush_states[i].pseudo, rush_states[i].score, is_selected);
         }
         
         if (spectate_view_idx >= 0 && spectate_view_idx < rush_player_count) {
-            memcpy(game.grid, rush_states[spectate_view_idx].grid, sizeof(game.grid));
+            memcpy(game.grid, rush_grids[spectate_view_idx], sizeof(game.grid));
             game.score = rush_states[spectate_view_idx].score;
             
             draw_text(font_S, rush_states[spectate_view_idx].pseudo, WINDOW_W / 2, 310, COLOR_CYAN);
@@ -882,6 +1146,7 @@ void render_rush_game(void) {
         snprintf(score_text, sizeof(score_text), "%d", game.score);
         draw_text(font_S, "Score", 35, 100, COLOR_WHITE);
         draw_text(font_L, score_text, 35, 135, COLOR_GOLD);
+        draw_streak(35, 160);
         
         draw_text(font_XS ? font_XS : font_S, "Classement", 35, 180, COLOR_WHITE);
         for (i = 0; i < rush_player_count && i < 4; i++) {
@@ -896,6 +1161,12 @@ void render_rush_game(void) {
             draw_text_left(font_XS ? font_XS : font_S, entry, 10, entry_y + 16, entry_color);
         }
         
+        if (duel_active) {
+            int mini_block = 60 / duel_game.grid_size;
+            render_mini_grid(duel_game.grid, duel_game.grid_size, window_w - 160, 22, mini_block,
+                             bot_level(duel_bot.level)->name, duel_game.score, 0);
+        }
+        
         render_pieces(0);
         render_dragged_piece();
     }
@@ -2,14 +2,46 @@
 #define SCREENS_H
 
 #include "game.h"
+#include "widgets.h"
 
-void render_menu(void);
-void render_options(void);
-void render_login(void);
-void render_multi_choice(void);
-void render_join_input(void);
-void render_server_browser(void);
-void render_lobby(void);
+/* What the widgets of the menu screens do when clicked, see input_handlers.c */
+typedef enum {
+    ACT_NONE,
+    ACT_SETTINGS,
+    ACT_BACK,
+    ACT_CONTINUE,
+    ACT_NEW_GAME,
+    ACT_DUEL,
+    ACT_BOT_LEVEL,
+    ACT_ONLINE,
+    ACT_OPTIONS,
+    ACT_EDIT_IP,
+    ACT_EDIT_PORT,
+    ACT_TEST,
+    ACT_SAVE,
+    ACT_VALIDATE,
+    ACT_CREATE_ROOM,
+    ACT_JOIN_CODE,
+    ACT_SERVERS,
+    ACT_REFRESH,
+    ACT_JOIN,
+    ACT_WATCH,
+    ACT_MODE,
+    ACT_TIMER,
+    ACT_VISIBILITY,
+    ACT_GRID_SMALLER,
+    ACT_GRID_BIGGER,
+    ACT_RULESET,
+    ACT_ADD_BOT,
+    ACT_START,
+    ACT_KICK,
+    ACT_HINT,
+    ACT_UNDO,
+    ACT_REDO
+} UiAction;
+
+/* The widgets of a menu screen or of the solo tool bar, NULL for the screens drawn directly */
+const UiScreen *screen_ui(int state);
 
 void render_solo(void);
 void render_multi_game(void);
@@ -18,7 +50,7 @@ void render_spectate(void);
 
 void render_game_grid(void);
 void render_game_grid_ex(GameState *gs, int offset_x, int offset_y);
-void render_mini_grid(int grid[GRID_H][GRID_W], int x, int y, int block_size, const char *label, int score, int is_selected);
+void render_mini_grid(Cell grid[GRID_MAX][GRID_MAX], int size, int x, int y, int block_size, const char *label, int score, int is_selected);
 
 void render_pieces(int greyed);
 void render_dragged_piece(void);
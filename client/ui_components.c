@@ -39,14 +39,7 @@ int draw_button(int x, int y, int w, int h, const char *lbl, Uint32 color, int d
     pulse = (sinf(glow_pulse * BUTTON_PULSE_SPEED) + 1.0f) * 0.5f;
     glow_intensity = hover ? (int)(4 + pulse * 3) : 2;
     
-    {
-        int i;
-        for (i = glow_intensity; i > 0; i--) {
-            float alpha = (float)(glow_intensity - i + 1) / (float)(glow_intensity + 1) * (hover ? 0.4f : 0.15f);
-            Uint32 glow_color = darken_color(border_color, alpha);
-            fill_rect(x - i, y - i, w + i * 2, h + i * 2, glow_color);
-        }
-    }
+    draw_glow(x, y, w, h, border_color, glow_intensity, hover ? 0.4f : 0.15f);
     
     if (hover) {
         draw_gradient_v(x, y, w, h, lighten_color(COLOR_BUTTON, 0.3f), COLOR_BUTTON);
@@ -75,15 +68,10 @@ void draw_input_field(int x, int y, int w, int h, const char *text, int focused)
     Uint32 bg_color = focused ? COLOR_INPUT_FOCUS : COLOR_INPUT;
     Uint32 border_color = focused ? COLOR_NEON_CYAN : darken_color(COLOR_NEON_CYAN, 0.4f);
     int glow_size = focused ? 4 : 0;
-    int i;
     float pulse = (sinf(glow_pulse * 3.0f) + 1.0f) * 0.5f;
     
     if (focused) {
-        for (i = glow_size; i > 0; i--) {
-            float alpha = (float)(glow_size - i + 1) / (float)(glow_size + 1) * (0.2f + pulse * 0.1f);
-            Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-            fill_rect(x - i, y - i, w + i * 2, h + i * 2, glow_color);
-        }
+        draw_glow(x, y, w, h, COLOR_NEON_CYAN, glow_size, 0.2f + pulse * 0.1f);
     }
     
     draw_gradient_v(x, y, w, h, bg_color, darken_color(bg_color, 0.7f));
@@ -130,6 +118,36 @@ void draw_settings_gear(int x, int y) {
     fill_rect(cx - 2, cy - 2, 4, 4, COLOR_PANEL);
 }
 
+void draw_hint_button(int x, int y, int active) {
+    int size = 28;
+    int cx = x + size / 2;
+    int hover = point_in_rect(mouse_x, mouse_y, x, y, size, size);
+    Uint32 color = (hover || active) ? COLOR_NEON_YELLOW : COLOR_GREY;
+    
+    fill_rect(cx - 6, y + 3, 12, 14, color);
+    fill_rect(cx - 8, y + 6, 16, 8, color);
+    fill_rect(cx - 3, y + 7, 6, 6, COLOR_PANEL);
+    fill_rect(cx - 4, y + 19, 8, 2, color);
+    fill_rect(cx - 3, y + 22, 6, 2, color);
+}
+
+/* Hooked arrow pointing left for undo, mirrored for redo */
+void draw_undo_button(int x, int y, int redo, int enabled) {
+    static const int parts[][4] = {
+        {4, 12, 2, 3}, {6, 10, 2, 7}, {8, 8, 2, 11},
+        {10, 12, 10, 3}, {19, 12, 3, 10}, {12, 19, 10, 3}
+    };
+    int size = 28;
+    int hover = enabled && point_in_rect(mouse_x, mouse_y, x, y, size, size);
+    Uint32 color = !enabled ? COLOR_DARK_GREY : hover ? COLOR_NEON_CYAN : COLOR_GREY;
+    int i;
+    
+    for (i = 0; i < 6; i++) {
+        int px = redo ? size - parts[i][0] - parts[i][2] : parts[i][0];
+        fill_rect(x + px, y + parts[i][1], parts[i][2], parts[i][3], color);
+    }
+}
+
 void draw_eye_icon(int x, int y, Uint32 color) {
     fill_rect(x + 2, y + 6, 12, 4, color);
     fill_rect(x + 6, y + 4, 4, 8, color);
@@ -137,19 +155,14 @@ void draw_eye_icon(int x, int y, Uint32 color) {
 }
 
 void render_pause_menu(void) {
-    int i;
     int overlay_w = 350;
     int overlay_h = 280;
     int overlay_x = (window_w - overlay_w) / 2;
     int overlay_y = (window_h - overlay_h) / 2;
     
-    fill_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.7f));
+    blend_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.7f), 0.85f);
     
-    for (i = 6; i > 0; i--) {
-        float alpha = (float)(6 - i + 1) / 7.0f * 0.2f;
-        Uint32 glow_color = darken_color(COLOR_NEON_ORANGE, alpha);
-        fill_rect(overlay_x - i, overlay_y - i, overlay_w + i * 2, overlay_h + i * 2, glow_color);
-    }
+    draw_glow(overlay_x, overlay_y, overlay_w, overlay_h, COLOR_NEON_ORANGE, 6, 0.2f);
     
     fill_rect(overlay_x, overlay_y, overlay_w, overlay_h, COLOR_PANEL);
     
@@ -183,6 +196,8 @@ int handle_pause_menu_click(void) {
         show_pause_menu = 0;
         delete_saved_game();
         init_game(&game);
+        undo_reset(&solo_history, &game);
+        hint_visible = 0;
         return 1;
     }
     
@@ -199,19 +214,14 @@ int handle_pause_menu_click(void) {
 }
 
 void render_settings_overlay(void) {
-    int i;
     int overlay_w = 450;
     int overlay_h = 480;
     int overlay_x = (window_w - overlay_w) / 2;
     int overlay_y = (window_h - overlay_h) / 2;
     
-    fill_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.7f));
+    blend_rect(0, 0, window_w, window_h, darken_color(COLOR_BG, 0.7f), 0.85f);
     
-    for (i = 6; i > 0; i--) {
-        float alpha = (float)(6 - i + 1) / 7.0f * 0.2f;
-        Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-        fill_rect(overlay_x - i, overlay_y - i, overlay_w + i * 2, overlay_h + i * 2, glow_color);
-    }
+    draw_glow(overlay_x, overlay_y, overlay_w, overlay_h, COLOR_NEON_CYAN, 6, 0.2f);
     
     fill_rect(overlay_x, overlay_y, overlay_w, overlay_h, COLOR_PANEL);
     
@@ -432,7 +442,6 @@ void handle_settings_overlay_drag(void) {
 }
 
 void draw_popup(void) {
-    int i;
     int popup_x = 40;
     int popup_y = WINDOW_H / 2 - 80;
     int popup_w = WINDOW_W - 80;
@@ -440,13 +449,9 @@ void draw_popup(void) {
     
     if (!popup_msg[0]) return;
     
-    fill_rect(0, 0, WINDOW_W, WINDOW_H, darken_color(COLOR_BG, 0.5f));
+    blend_rect(0, 0, WINDOW_W, WINDOW_H, darken_color(COLOR_BG, 0.5f), 0.85f);
     
-    for (i = 8; i > 0; i--) {
-        float alpha = (float)(8 - i + 1) / 9.0f * 0.25f;
-        Uint32 glow_color = darken_color(COLOR_NEON_CYAN, alpha);
-        fill_rect(popup_x - i, popup_y - i, popup_w + i * 2, popup_h + i * 2, glow_color);
-    }
+    draw_glow(popup_x, popup_y, popup_w, popup_h, COLOR_NEON_CYAN, 8, 0.25f);
     
     draw_gradient_v(popup_x, popup_y, popup_w, popup_h, COLOR_PANEL, darken_color(COLOR_PANEL, 0.6f));
     
@@ -7,6 +7,8 @@ int draw_button(int x, int y, int w, int h, const char *lbl, Uint32 color, int d
 void draw_input_field(int x, int y, int w, int h, const char *text, int focused);
 
 void draw_settings_gear(int x, int y);
+void draw_hint_button(int x, int y, int active);
+void draw_undo_button(int x, int y, int redo, int enabled);
 void draw_eye_icon(int x, int y, Uint32 color);
 
 void render_pause_menu(void);
@@ -0,0 +1,211 @@
+#include "widgets.h"
+#include "globals.h"
+#include "graphics.h"
+#include "ui_components.h"
+#include "screens.h"
+#include <string.h>
+
+static Widget widgets[UI_MAX_WIDGETS];
+static int num_widgets = 0;
+
+/* Per slot: the kept draw calls, whether they still show the widget, and its hover then */
+static GfxBlock *blocks[UI_MAX_WIDGETS];
+static int block_valid[UI_MAX_WIDGETS];
+static int block_hover[UI_MAX_WIDGETS];
+
+static int built_state = -1;
+static int built_layout = -1;
+static Uint32 built_key = 0;
+
+Uint32 ui_hash(Uint32 h, const void *data, int size) {
+    const unsigned char *p = (const unsigned char*)data;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static Widget *add_widget(int kind, int action, int arg, int x, int y, int w, int h) {
+    Widget *wd;
+
+    if (num_widgets == UI_MAX_WIDGETS) return NULL;
+
+    wd = &widgets[num_widgets];
+    memset(wd, 0, sizeof(*wd));
+    wd->kind = kind;
+    wd->action = action;
+    wd->arg = arg;
+    wd->x = x;
+    wd->y = y;
+    wd->w = w;
+    wd->h = h;
+    block_valid[num_widgets] = 0;
+    block_hover[num_widgets] = 0;
+    num_widgets++;
+    return wd;
+}
+
+static void set_label(Widget *wd, const char *label) {
+    strncpy(wd->label, label, UI_LABEL_LEN - 1);
+    wd->label[UI_LABEL_LEN - 1] = '\0';
+}
+
+void ui_add_backdrop(void (*draw)(void)) {
+    Widget *wd = add_widget(WIDGET_BACKDROP, 0, 0, 0, 0, window_w, window_h);
+    if (wd) wd->draw = draw;
+}
+
+void ui_add_button(int action, int arg, int x, int y, int w, int h, const char *label, Uint32 color, int disabled) {
+    Widget *wd = add_widget(WIDGET_BUTTON, action, arg, x, y, w, h);
+    if (!wd) return;
+    set_label(wd, label);
+    wd->color = color;
+    wd->disabled = disabled;
+}
+
+void ui_add_input(int action, int x, int y, int w, int h, const char *text, int focused) {
+    Widget *wd = add_widget(WIDGET_INPUT, action, 0, x, y, w, h);
+    if (!wd) return;
+    wd->text = text;
+    wd->focused = focused;
+}
+
+void ui_add_gear(int action, int x, int y) {
+    add_widget(WIDGET_GEAR, action, 0, x, y, 28, 28);
+}
+
+void ui_add_label(int x, int y, const char *label, Uint32 color) {
+    Widget *wd = add_widget(WIDGET_LABEL, 0, 0, x, y, 0, 0);
+    if (!wd) return;
+    set_label(wd, label);
+    wd->color = color;
+}
+
+void ui_add_area(int action, int arg, int x, int y, int w, int h) {
+    add_widget(WIDGET_AREA, action, arg, x, y, w, h);
+}
+
+void ui_add_tool(int kind, int action, int x, int y, int lit, int disabled) {
+    Widget *wd = add_widget(kind, action, 0, x, y, 28, 28);
+    if (!wd) return;
+    wd->lit = lit;
+    wd->disabled = disabled;
+}
+
+/* Rebuilds the widgets when the screen, the layout or the state they show has changed */
+static int sync_widgets(void) {
+    const UiScreen *s = screen_ui(current_state);
+    Uint32 key;
+
+    if (!s) {
+        num_widgets = 0;
+        built_state = -1;
+        return 0;
+    }
+
+    key = s->key();
+    if (built_state != current_state || built_layout != layout_generation || built_key != key) {
+        num_widgets = 0;
+        s->build();
+        built_state = current_state;
+        built_layout = layout_generation;
+        built_key = key;
+    }
+    return 1;
+}
+
+static void draw_widget(const Widget *wd) {
+    switch (wd->kind) {
+        case WIDGET_BACKDROP:
+            wd->draw();
+            break;
+        case WIDGET_BUTTON:
+            draw_button(wd->x, wd->y, wd->w, wd->h, wd->label, wd->color, wd->disabled);
+            break;
+        case WIDGET_INPUT:
+            draw_input_field(wd->x, wd->y, wd->w, wd->h, wd->text, wd->focused);
+            break;
+        case WIDGET_GEAR:
+            draw_settings_gear(wd->x, wd->y);
+            break;
+        case WIDGET_LABEL:
+            draw_text(font_S, wd->label, wd->x, wd->y, wd->color);
+            break;
+        case WIDGET_HINT:
+            draw_hint_button(wd->x, wd->y, wd->lit);
+            break;
+        case WIDGET_UNDO:
+        case WIDGET_REDO:
+            draw_undo_button(wd->x, wd->y, wd->kind == WIDGET_REDO, wd->lit);
+            break;
+    }
+}
+
+void ui_render(void) {
+    int i;
+
+    if (!sync_widgets()) return;
+
+    for (i = 0; i < num_widgets; i++) {
+        const Widget *wd = &widgets[i];
+        /* Tools light up under the mouse even when they cannot be clicked */
+        int hover = ((wd->kind == WIDGET_BUTTON && !wd->disabled) || wd->kind == WIDGET_GEAR ||
+                     wd->kind >= WIDGET_HINT) &&
+                    point_in_rect(mouse_x, mouse_y, wd->x, wd->y, wd->w, wd->h);
+
+        if (wd->kind == WIDGET_AREA) continue;
+
+        if (hover != block_hover[i]) {
+            block_hover[i] = hover;
+            block_valid[i] = 0;
+        }
+
+        /* Hovered buttons pulse and focused fields blink */
+        if ((wd->kind == WIDGET_BUTTON && hover) || (wd->kind == WIDGET_INPUT && wd->focused)) {
+            draw_widget(wd);
+            block_valid[i] = 0;
+            continue;
+        }
+
+        if (block_valid[i]) {
+            gfx_block_submit(blocks[i]);
+            continue;
+        }
+
+        if (!blocks[i]) blocks[i] = gfx_block_new();
+        if (!blocks[i]) {
+            draw_widget(wd);
+            continue;
+        }
+        gfx_block_begin(blocks[i]);
+        draw_widget(wd);
+        block_valid[i] = gfx_block_end();
+    }
+}
+
+const Widget *ui_hit(int x, int y) {
+    int i;
+
+    if (!sync_widgets()) return NULL;
+
+    for (i = num_widgets - 1; i >= 0; i--) {
+        const Widget *wd = &widgets[i];
+        if (wd->kind == WIDGET_BACKDROP || wd->kind == WIDGET_LABEL || wd->disabled) continue;
+        if (point_in_rect(x, y, wd->x, wd->y, wd->w, wd->h)) return wd;
+    }
+    return NULL;
+}
+
+void ui_cleanup(void) {
+    int i;
+
+    for (i = 0; i < UI_MAX_WIDGETS; i++) {
+        gfx_block_free(blocks[i]);
+        blocks[i] = NULL;
+        block_valid[i] = 0;
+    }
+    num_widgets = 0;
+    built_state = -1;
+}
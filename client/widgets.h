@@ -0,0 +1,73 @@
+#ifndef WIDGETS_H
+#define WIDGETS_H
+
+#include <SDL.h>
+
+/* Retained widgets for the menu screens. A screen builds its widgets from the state it shows,
+ * again only when that state, the screen or the layout changes, and both drawing and clicks go
+ * through the rectangles kept then. Each widget keeps its draw calls and submits them again
+ * until it is invalidated: rebuilt, hovered in or out, or animated while hovered or focused. */
+
+#define UI_MAX_WIDGETS 32
+#define UI_LABEL_LEN 48
+
+typedef enum {
+    /* Everything on the screen that is not clicked, drawn first */
+    WIDGET_BACKDROP,
+    WIDGET_BUTTON,
+    WIDGET_INPUT,
+    WIDGET_GEAR,
+    /* Text that moves with the layout, centred on x, y */
+    WIDGET_LABEL,
+    /* Clicked but not drawn */
+    WIDGET_AREA,
+    /* The solo tool bar */
+    WIDGET_HINT,
+    WIDGET_UNDO,
+    WIDGET_REDO
+} WidgetKind;
+
+typedef struct {
+    int kind;
+    /* What the screen's click handler does with it, and on what */
+    int action;
+    int arg;
+    int x, y, w, h;
+    char label[UI_LABEL_LEN];
+    Uint32 color;
+    int disabled;
+    /* Input fields: the buffer they edit */
+    const char *text;
+    int focused;
+    /* Backdrop */
+    void (*draw)(void);
+    /* Tool bar: the hint is shown, or there is a step to undo or redo */
+    int lit;
+} Widget;
+
+/* What a screen gives the widget layer: key() hashes the state its widgets are built from,
+ * build() adds them */
+typedef struct {
+    Uint32 (*key)(void);
+    void (*build)(void);
+} UiScreen;
+
+#define UI_HASH_SEED 2166136261u
+Uint32 ui_hash(Uint32 h, const void *data, int size);
+
+void ui_add_backdrop(void (*draw)(void));
+void ui_add_button(int action, int arg, int x, int y, int w, int h, const char *label, Uint32 color, int disabled);
+void ui_add_input(int action, int x, int y, int w, int h, const char *text, int focused);
+void ui_add_gear(int action, int x, int y);
+void ui_add_label(int x, int y, const char *label, Uint32 color);
+void ui_add_area(int action, int arg, int x, int y, int w, int h);
+void ui_add_tool(int kind, int action, int x, int y, int lit, int disabled);
+
+/* Both work on the widgets of current_state, rebuilt first if they are stale. ui_hit() returns
+ * the topmost enabled widget under the point, or NULL. */
+void ui_render(void);
+const Widget *ui_hit(int x, int y);
+
+void ui_cleanup(void);
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#include "config.h"
+
+#define BB_ROW_MASK(n) ((uint16_t)((1u << (n)) - 1u))
+
+/* The _n kernels take the board size as a parameter. Their wrappers call them once with the
+ * constant GRID_DEFAULT, so the common board gets its own copy with the loops unrolled. */
+#if defined(__GNUC__)
+#define BB_SPECIALIZE static inline __attribute__((always_inline))
+#else
+#define BB_SPECIALIZE static inline
+#endif
+
+/* rows[r] bit c is set when cell (r, c) is occupied, rows past size stay empty */
+typedef struct {
+    uint16_t rows[GRID_MAX];
+    int size;
+} BitBoard;
+
+#define BB_GRID_SIZES (GRID_MAX - GRID_MIN + 1)
+
+/* anchor_cols[n - GRID_MIN] holds the columns the piece can be anchored at on an n-wide board */
+typedef struct {
+    uint16_t rows[5];
+    int w, h;
+    int cells;
+    uint16_t anchor_cols[BB_GRID_SIZES];
+} BBPiece;
+
+/* Lines a placement fills, as row and column masks */
+typedef struct {
+    uint16_t rows;
+    uint16_t cols;
+} BBClear;
+
+/* Every anchor of one piece on one board: legal[r] bit c is set when the piece fits at (r, c),
+ * clearing[r] when that placement also completes a line. clears[r][c] is only written for
+ * clearing anchors, read it through bb_move_clear(). Rows past the board size are not written. */
+typedef struct {
+    uint16_t legal[GRID_MAX];
+    uint16_t clearing[GRID_MAX];
+    BBClear clears[GRID_MAX][GRID_MAX];
+    int count;
+} BBMoveMap;
+
+static inline int bb_popcount(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcount(x);
+#else
+    int n = 0;
+    while (x) {
+        x &= x - 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static inline int bb_popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    return bb_popcount((uint32_t)x) + bb_popcount((uint32_t)(x >> 32));
+#endif
+}
+
+static inline int bb_lowest_bit(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1u)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static inline void bb_clear(BitBoard *bb, int size) {
+    int r;
+    for (r = 0; r < GRID_MAX; r++) {
+        bb->rows[r] = 0;
+    }
+    bb->size = size;
+}
+
+static inline int bb_is_empty(const BitBoard *bb) {
+    uint16_t any = 0;
+    int r;
+    for (r = 0; r < bb->size; r++) {
+        any |= bb->rows[r];
+    }
+    return any == 0;
+}
+
+static inline void bb_from_grid(BitBoard *bb, const Cell grid[GRID_MAX][GRID_MAX], int size) {
+    int r, c;
+    bb_clear(bb, size);
+    for (r = 0; r < size; r++) {
+        uint16_t row = 0;
+        for (c = 0; c < size; c++) {
+            if (grid[r][c]) row |= (uint16_t)(1u << c);
+        }
+        bb->rows[r] = row;
+    }
+}
+
+static inline int bb_can_place(const BitBoard *bb, const BBPiece *p, int row, int col) {
+    int i;
+
+    if (row < 0 || col < 0 || row + p->h > bb->size || col + p->w > bb->size) {
+        return 0;
+    }
+
+    for (i = 0; i < p->h; i++) {
+        if (bb->rows[row + i] & (uint16_t)(p->rows[i] << col)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Bit c of the result is set when the piece fits with its top-left corner at (row, c). */
+BB_SPECIALIZE uint16_t bb_legal_cols_n(const BitBoard *bb, const BBPiece *p, int row, int n) {
+    uint16_t blocked = 0;
+    int i;
+
+    if (row < 0 || row + p->h > n) return 0;
+
+    for (i = 0; i < p->h; i++) {
+        uint16_t bits = p->rows[i];
+        uint16_t occ = bb->rows[row + i];
+        while (bits) {
+            int k = bb_lowest_bit(bits);
+            bits &= (uint16_t)(bits - 1);
+            blocked |= (uint16_t)(occ >> k);
+        }
+    }
+
+    return (uint16_t)(~blocked & p->anchor_cols[n - GRID_MIN]);
+}
+
+static inline uint16_t bb_legal_cols(const BitBoard *bb, const BBPiece *p, int row) {
+    if (bb->size == GRID_DEFAULT) return bb_legal_cols_n(bb, p, row, GRID_DEFAULT);
+    return bb_legal_cols_n(bb, p, row, bb->size);
+}
+
+/* Places the piece, clears full lines and returns the number of lines cleared.
+ * The cleared row/column masks are optional. */
+BB_SPECIALIZE int bb_place_n(BitBoard *bb, const BBPiece *p, int row, int col,
+                             uint16_t *rows_cleared, uint16_t *cols_cleared, int n) {
+    uint16_t full_rows = 0;
+    uint16_t full_cols = BB_ROW_MASK(n);
+    int i;
+
+    /* Only the rows the piece touches can become full */
+    for (i = 0; i < p->h; i++) {
+        uint16_t r = (uint16_t)(bb->rows[row + i] | (p->rows[i] << col));
+        bb->rows[row + i] = r;
+        if (r == BB_ROW_MASK(n)) full_rows |= (uint16_t)(1u << (row + i));
+    }
+
+    for (i = 0; i < n; i++) {
+        full_cols &= bb->rows[i];
+    }
+
+    if (full_rows | full_cols) {
+        for (i = 0; i < n; i++) {
+            if (full_rows & (1u << i)) {
+                bb->rows[i] = 0;
+            } else {
+                bb->rows[i] &= (uint16_t)~full_cols;
+            }
+        }
+    }
+
+    if (rows_cleared) *rows_cleared = full_rows;
+    if (cols_cleared) *cols_cleared = full_cols;
+
+    return bb_popcount(full_rows) + bb_popcount(full_cols);
+}
+
+static inline int bb_place(BitBoard *bb, const BBPiece *p, int row, int col,
+                           uint16_t *rows_cleared, uint16_t *cols_cleared) {
+    if (bb->size == GRID_DEFAULT) return bb_place_n(bb, p, row, col, rows_cleared, cols_cleared, GRID_DEFAULT);
+    return bb_place_n(bb, p, row, col, rows_cleared, cols_cleared, bb->size);
+}
+
+static inline int bb_clear_lines(const BBClear *clear) {
+    return bb_popcount(clear->rows) + bb_popcount(clear->cols);
+}
+
+/* bb_place for an anchor whose cleared lines are already known from a move map */
+BB_SPECIALIZE int bb_apply_n(BitBoard *bb, const BBPiece *p, int row, int col, const BBClear *clear, int n) {
+    int i;
+
+    for (i = 0; i < p->h; i++) {
+        bb->rows[row + i] |= (uint16_t)(p->rows[i] << col);
+    }
+
+    if (clear->rows | clear->cols) {
+        for (i = 0; i < n; i++) {
+            if (clear->rows & (1u << i)) {
+                bb->rows[i] = 0;
+            } else {
+                bb->rows[i] &= (uint16_t)~clear->cols;
+            }
+        }
+    }
+
+    return bb_clear_lines(clear);
+}
+
+static inline int bb_apply(BitBoard *bb, const BBPiece *p, int row, int col, const BBClear *clear) {
+    if (bb->size == GRID_DEFAULT) return bb_apply_n(bb, p, row, col, clear, GRID_DEFAULT);
+    return bb_apply_n(bb, p, row, col, clear, bb->size);
+}
+
+static inline void bb_mark_clear(BBMoveMap *map, int row, int col, uint16_t rows, uint16_t cols) {
+    BBClear *clear = &map->clears[row][col];
+
+    if (map->clearing[row] & (1u << col)) {
+        clear->rows |= rows;
+        clear->cols |= cols;
+    } else {
+        clear->rows = rows;
+        clear->cols = cols;
+        map->clearing[row] |= (uint16_t)(1u << col);
+    }
+}
+
+static inline BBClear bb_move_clear(const BBMoveMap *map, int row, int col) {
+    BBClear none = {0, 0};
+    return (map->clearing[row] & (1u << col)) ? map->clears[row][col] : none;
+}
+
+/* A row completes only when the piece covers exactly its empty cells, which pins the anchor
+ * to one offset per (piece row, board row). Columns are tested for all of them at once per
+ * anchor, against prefix/suffix ANDs of the rows outside the piece.
+ * Assumes a board at rest, which never holds a full line. */
+BB_SPECIALIZE void bb_move_map_n(const BitBoard *bb, const BBPiece *p, BBMoveMap *map, int n) {
+    uint16_t above[GRID_MAX + 1], below[GRID_MAX + 1];
+    int i, r;
+
+    map->count = 0;
+    for (r = 0; r < n; r++) {
+        map->legal[r] = bb_legal_cols_n(bb, p, r, n);
+        map->clearing[r] = 0;
+        map->count += bb_popcount(map->legal[r]);
+    }
+    if (map->count == 0) return;
+
+    for (r = 0; r < n; r++) {
+        uint16_t empty = (uint16_t)(~bb->rows[r] & BB_ROW_MASK(n));
+        if (!empty) continue;
+        for (i = 0; i < p->h && r - i >= 0; i++) {
+            int shift = bb_lowest_bit(empty) - bb_lowest_bit(p->rows[i]);
+            if (shift < 0 || (uint16_t)(p->rows[i] << shift) != empty) continue;
+            if (!(map->legal[r - i] & (1u << shift))) continue;
+            bb_mark_clear(map, r - i, shift, (uint16_t)(1u << r), 0);
+        }
+    }
+
+    above[0] = BB_ROW_MASK(n);
+    below[n] = BB_ROW_MASK(n);
+    for (r = 0; r < n; r++) {
+        above[r + 1] = above[r] & bb->rows[r];
+        below[n - 1 - r] = below[n - r] & bb->rows[n - 1 - r];
+    }
+
+    for (r = 0; r + p->h <= n; r++) {
+        uint16_t outside = above[r] & below[r + p->h];
+        uint16_t anchors = map->legal[r];
+        if (!outside) continue;
+        while (anchors) {
+            int c = bb_lowest_bit(anchors);
+            uint16_t cols = outside;
+            anchors &= (uint16_t)(anchors - 1);
+            for (i = 0; i < p->h; i++) {
+                cols &= (uint16_t)(bb->rows[r + i] | (p->rows[i] << c));
+            }
+            if (cols) bb_mark_clear(map, r, c, 0, cols);
+        }
+    }
+}
+
+static inline void bb_move_map(const BitBoard *bb, const BBPiece *p, BBMoveMap *map) {
+    if (bb->size == GRID_DEFAULT) {
+        bb_move_map_n(bb, p, map, GRID_DEFAULT);
+    } else {
+        bb_move_map_n(bb, p, map, bb->size);
+    }
+}
+
+BB_SPECIALIZE int bb_has_any_anchor_n(const BitBoard *bb, const BBPiece *p, int n) {
+    int r;
+    for (r = 0; r + p->h <= n; r++) {
+        if (bb_legal_cols_n(bb, p, r, n)) return 1;
+    }
+    return 0;
+}
+
+static inline int bb_has_any_anchor(const BitBoard *bb, const BBPiece *p) {
+    if (bb->size == GRID_DEFAULT) return bb_has_any_anchor_n(bb, p, GRID_DEFAULT);
+    return bb_has_any_anchor_n(bb, p, bb->size);
+}
+
+#endif
@@ -0,0 +1,258 @@
+#include <string.h>
+
+#include "bot.h"
+#include "pieces.h"
+
+/* What a next hand that cannot be placed in full costs per missing piece: the game is over */
+#define BOT_STUCK_PENALTY 100000
+
+#define BOT_LEVEL(id, name, candidates, samples, budget, mistakes, delay) \
+    { name, candidates, samples, budget, mistakes, delay },
+
+const BotLevel bot_levels[NUM_BOT_LEVELS] = {
+    BOT_LEVEL_LIST(BOT_LEVEL)
+};
+
+unsigned int bot_clock_ms(void) {
+    return solver_clock_ms();
+}
+
+/* Next hands are drawn from the bag weights, not from the real dealer, so bots cannot peek */
+static int draw_template(Rng *rng) {
+    int total = 0, pick, i;
+
+    for (i = 0; i < NUM_PIECE_TEMPLATES; i++) {
+        total += piece_infos[i].weight;
+    }
+    pick = (int)rng_below(rng, (uint32_t)total);
+    for (i = 0; pick >= piece_infos[i].weight; i++) {
+        pick -= piece_infos[i].weight;
+    }
+    return i;
+}
+
+static void hand_pieces(const int ids[3], const int available[3], BBPiece pieces[3]) {
+    int i;
+    for (i = 0; i < 3; i++) {
+        pieces[i] = piece_infos[available[i] && ids[i] >= 0 ? ids[i] : 0].bb;
+    }
+}
+
+void bot_init(Bot *bot, int level, uint32_t seed) {
+    memset(bot, 0, sizeof(Bot));
+    bot->level = bot_level(level) - bot_levels;
+    bot->budget_ms = bot_level(level)->budget_ms;
+    rng_seed(&bot->rng, seed);
+}
+
+void bot_free(Bot *bot) {
+    solver_task_free(bot->task);
+    bot->task = NULL;
+}
+
+static int on_plan(const Bot *bot, const BitBoard *bb, const int ids[3], const int available[3]) {
+    int i;
+
+    if (bot->plan_step >= bot->plan.count) return 0;
+    if (memcmp(bb, &bot->expect, sizeof(BitBoard)) != 0) return 0;
+    for (i = 0; i < 3; i++) {
+        if (available[i] && ids[i] != bot->expect_ids[i]) return 0;
+    }
+    return available[bot->plan.moves[bot->plan_step].piece_idx];
+}
+
+void bot_begin(Bot *bot, const BitBoard *bb, const int ids[3], const int available[3]) {
+    int i;
+
+    bot_free(bot);
+    bot->thinking = !on_plan(bot, bb, ids, available);
+    bot->bb = *bb;
+    for (i = 0; i < 3; i++) {
+        bot->ids[i] = ids[i];
+        bot->available[i] = available[i] && ids[i] >= 0;
+    }
+    if (!bot->thinking) return;
+
+    bot->plan.count = 0;
+    bot->plan_step = 0;
+    bot->num_candidates = -1;
+    bot->started_ms = bot_clock_ms();
+}
+
+static int play_plan(Bot *bot, SolverMove *move) {
+    const SolverMove *m;
+    int i;
+
+    if (bot->plan_step >= bot->plan.count) {
+        move->piece_idx = -1;
+        return 1;
+    }
+
+    m = &bot->plan.moves[bot->plan_step++];
+    *move = *m;
+    bot->expect = bot->bb;
+    bb_place(&bot->expect, &piece_infos[bot->ids[m->piece_idx]].bb, m->row, m->col, NULL, NULL);
+    for (i = 0; i < 3; i++) {
+        bot->expect_ids[i] = bot->ids[i];
+    }
+    bot->thinking = 0;
+    return 1;
+}
+
+static void random_move(Bot *bot) {
+    SolverMove moves[3 * GRID_MAX * GRID_MAX];
+    int n = 0;
+    int i, r;
+
+    for (i = 0; i < 3; i++) {
+        const BBPiece *p;
+        if (!bot->available[i]) continue;
+        p = &piece_infos[bot->ids[i]].bb;
+        for (r = 0; r + p->h <= bot->bb.size; r++) {
+            uint16_t cols = bb_legal_cols(&bot->bb, p, r);
+            while (cols) {
+                moves[n].piece_idx = i;
+                moves[n].row = r;
+                moves[n].col = bb_lowest_bit(cols);
+                cols &= (uint16_t)(cols - 1);
+                n++;
+            }
+        }
+    }
+
+    bot->plan.count = n > 0;
+    bot->plan_step = 0;
+    if (n > 0) bot->plan.moves[0] = moves[rng_below(&bot->rng, (uint32_t)n)];
+}
+
+static void start_ranking(Bot *bot) {
+    BBPiece pieces[3];
+
+    hand_pieces(bot->ids, bot->available, pieces);
+    bot->task = solver_task_new(&bot->bb, pieces, bot->available, NULL);
+}
+
+/* Keeps only the candidates that place as many pieces as the best one */
+static void rank_candidates(Bot *bot) {
+    const BotLevel *level = bot_level(bot->level);
+    int max = level->candidates < BOT_MAX_CANDIDATES ? level->candidates : BOT_MAX_CANDIDATES;
+    int n = solver_task_ranked(bot->task, bot->candidates, max);
+    int i;
+
+    for (i = 1; i < n; i++) {
+        if (bot->candidates[i].count < bot->candidates[0].count) break;
+    }
+    bot->num_candidates = i < n ? i : n;
+    bot->rounds = 0;
+    bot->next_candidate = 0;
+    memset(bot->totals, 0, sizeof(bot->totals));
+}
+
+/* The chance node: the best answer to the sampled next hand on the board the candidate leaves */
+static void start_sample(Bot *bot, int c) {
+    const SolverResult *cand = &bot->candidates[c];
+    static const int all[3] = {1, 1, 1};
+    BitBoard leaf = bot->bb;
+    BBPiece pieces[3];
+    int i;
+
+    for (i = 0; i < cand->count; i++) {
+        const SolverMove *m = &cand->moves[i];
+        bb_place(&leaf, &piece_infos[bot->ids[m->piece_idx]].bb, m->row, m->col, NULL, NULL);
+    }
+    hand_pieces(bot->sample_ids, all, pieces);
+    bot->task = solver_task_new(&leaf, pieces, all, NULL);
+}
+
+static int sample_value(const Bot *bot) {
+    SolverResult res;
+
+    if (!bot->task || solver_task_result(bot->task, &res) == 0) return -3 * BOT_STUCK_PENALTY;
+    return res.score - (3 - res.count) * BOT_STUCK_PENALTY;
+}
+
+/* Runs the current search for what is left of the slice, returns 1 once it is done */
+static int run_task(Bot *bot, ThreadPool *pool, unsigned int slice_start, int slice_ms) {
+    int left = slice_ms - (int)(bot_clock_ms() - slice_start);
+
+    if (!bot->task) return 1;
+    if (left <= 0) return 0;
+    return solver_task_run(bot->task, pool, left);
+}
+
+static int hand_left(const Bot *bot) {
+    return bot->available[0] + bot->available[1] + bot->available[2];
+}
+
+int bot_think(Bot *bot, ThreadPool *pool, int slice_ms, SolverMove *move) {
+    const BotLevel *level = bot_level(bot->level);
+    unsigned int slice_start = bot_clock_ms();
+    int best, n, c;
+
+    if (!bot->thinking) return play_plan(bot, move);
+
+    if (bot->num_candidates < 0) {
+        if (!bot->task) {
+            if (level->mistakes > 0 && (int)rng_below(&bot->rng, 100) < level->mistakes) {
+                random_move(bot);
+                return play_plan(bot, move);
+            }
+            start_ranking(bot);
+            if (!bot->task) {
+                random_move(bot);
+                return play_plan(bot, move);
+            }
+        }
+        if (!run_task(bot, pool, slice_start, slice_ms)) return 0;
+        rank_candidates(bot);
+        bot_free(bot);
+        if (bot->num_candidates == 0) return play_plan(bot, move);
+    }
+
+    /* Lookahead only helps when the hand can be finished and there is a choice to make */
+    if (bot->num_candidates > 1 && bot->candidates[0].count == hand_left(bot)) {
+        while (bot->rounds < level->samples) {
+            if (bot->budget_ms > 0 && bot_clock_ms() - bot->started_ms >= (unsigned int)bot->budget_ms) break;
+            if (!bot->task) {
+                if (bot->next_candidate == 0) {
+                    for (c = 0; c < 3; c++) {
+                        bot->sample_ids[c] = draw_template(&bot->rng);
+                    }
+                }
+                start_sample(bot, bot->next_candidate);
+            }
+            if (!run_task(bot, pool, slice_start, slice_ms)) return 0;
+            bot->round_values[bot->next_candidate] = sample_value(bot);
+            bot_free(bot);
+            if (++bot->next_candidate == bot->num_candidates) {
+                for (c = 0; c < bot->num_candidates; c++) {
+                    bot->totals[c] += bot->round_values[c];
+                }
+                bot->next_candidate = 0;
+                bot->rounds++;
+            }
+        }
+        bot_free(bot);
+    }
+
+    /* Candidates are compared on the rounds all of them finished. When the budget runs out in the
+     * first one, the candidates sampled so far are compared on that hand, the others rank lower. */
+    best = 0;
+    n = bot->rounds > 0 ? bot->num_candidates : bot->next_candidate;
+    if (n > 1) {
+        const long long *values = bot->rounds > 0 ? bot->totals : bot->round_values;
+        long long rounds = bot->rounds > 0 ? bot->rounds : 1;
+        long long best_value = values[0] + solver_default_weights.line_clear * bot->candidates[0].lines * rounds;
+        for (c = 1; c < n; c++) {
+            long long value = values[c] + solver_default_weights.line_clear * bot->candidates[c].lines * rounds;
+            if (value > best_value) {
+                best = c;
+                best_value = value;
+            }
+        }
+    }
+
+    bot->plan = bot->candidates[best];
+    bot->plan_step = 0;
+    return play_plan(bot, move);
+}
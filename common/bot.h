@@ -0,0 +1,90 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "rng.h"
+#include "bitboard.h"
+#include "solver.h"
+#include "thread_pool.h"
+
+#define BOT_MAX_CANDIDATES 8
+
+/* One entry per difficulty: X(id, name, candidates, samples, budget ms, mistake %, move delay ms).
+ * The solver ranks the first moves of the hand, then the best `candidates` of them are scored
+ * by expectimax: the average of the best answer to `samples` random next hands, until the
+ * time budget runs out. The move delay paces the bot against humans. */
+#define BOT_LEVEL_LIST(X) \
+    X(BOT_EASY,   "Facile",    1, 0,  0,   25, 1400) \
+    X(BOT_MEDIUM, "Moyen",     1, 0,  0,   0,  1000) \
+    X(BOT_HARD,   "Difficile", 4, 8,  120, 0,  700) \
+    X(BOT_EXPERT, "Expert",    8, 32, 400, 0,  500)
+
+#define BOT_LEVEL_ENUM(id, name, candidates, samples, budget, mistakes, delay) id,
+typedef enum {
+    BOT_LEVEL_LIST(BOT_LEVEL_ENUM)
+    NUM_BOT_LEVELS
+} BotLevelId;
+
+typedef struct {
+    const char *name;
+    int candidates;
+    int samples;
+    int budget_ms;
+    int mistakes;
+    int move_delay_ms;
+} BotLevel;
+
+extern const BotLevel bot_levels[NUM_BOT_LEVELS];
+
+/* Unknown IDs (the network) play as BOT_MEDIUM */
+static inline const BotLevel *bot_level(int id) {
+    return &bot_levels[id >= 0 && id < NUM_BOT_LEVELS ? id : BOT_MEDIUM];
+}
+
+typedef struct {
+    int level;
+    /* 0 searches every sample whatever the time it takes (self-play) */
+    int budget_ms;
+    Rng rng;
+
+    /* Position being searched */
+    BitBoard bb;
+    int ids[3];
+    int available[3];
+    int thinking;
+    unsigned int started_ms;
+
+    SolverResult candidates[BOT_MAX_CANDIDATES];
+    long long totals[BOT_MAX_CANDIDATES];
+    long long round_values[BOT_MAX_CANDIDATES];
+    int num_candidates;
+    int rounds;
+    int next_candidate;
+    int sample_ids[3];
+    /* The search in progress, the ranking or one sample: it runs across calls */
+    SolverTask *task;
+
+    /* The chosen sequence, kept while the board is the one it leads to */
+    SolverResult plan;
+    int plan_step;
+    BitBoard expect;
+    int expect_ids[3];
+} Bot;
+
+/* Monotonic milliseconds, the clock the time budgets are measured on */
+unsigned int bot_clock_ms(void);
+
+void bot_init(Bot *bot, int level, uint32_t seed);
+
+/* Drops the search in progress. Call it before bot_init() on a bot used before, and when
+ * giving a bot up in the middle of a move. */
+void bot_free(Bot *bot);
+
+/* Starts on a position, or keeps following the current plan if it is the expected one */
+void bot_begin(Bot *bot, const BitBoard *bb, const int ids[3], const int available[3]);
+
+/* Searches for up to slice_ms and returns 1 once *move holds the decision, piece_idx < 0
+ * when nothing fits. Call again with the same position until it does. The searches stop at
+ * the end of the slice and carry on at the next call, whatever the board size. */
+int bot_think(Bot *bot, ThreadPool *pool, int slice_ms, SolverMove *move);
+
+#endif
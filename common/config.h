@@ -1,8 +1,11 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#define GRID_W 10
-#define GRID_H 10
+/* Boards are square, GRID_MIN to GRID_MAX cells a side. Grids are always stored GRID_MAX wide,
+ * GRID_DEFAULT is the size the bitboard kernels are specialised for. */
+#define GRID_MIN 8
+#define GRID_MAX 16
+#define GRID_DEFAULT 10
 
 #define WINDOW_W 540
 #define WINDOW_H 960
@@ -11,6 +14,9 @@
 
 #define PORT 5000
 
+#define SCORE_PER_PIECE 10
+#define SCORE_PER_LINE 100
+
 #define COLOR_BG           0x0D0221
 #define COLOR_BG_DARK      0x080115
 #define COLOR_BG_LIGHTER   0x1A0A3E
@@ -56,6 +62,30 @@
 #define COLOR_GOLD         0xFFD700
 #define COLOR_PURPLE       0xBB00FF
 
+/* Grid cells hold an index into the block palette, 0 is an empty cell */
+typedef unsigned char Cell;
+
+#define CELL_EMPTY   0
+#define CELL_PURPLE  1
+#define CELL_BLUE    2
+#define CELL_CYAN    3
+#define CELL_RED     4
+#define CELL_ORANGE  5
+#define CELL_GREEN   6
+#define CELL_GOLD    7
+#define BLOCK_PALETTE_SIZE 8
+
+#define BLOCK_PALETTE_RGB { \
+    0x000000, \
+    0x9966CC, \
+    0x4466AA, \
+    0x44AACC, \
+    0xAA3344, \
+    0xDD7722, \
+    0x44AA44, \
+    0xCCAA22  \
+}
+
 #define BLOCK_COLOR_RED     0xFF3366
 #define BLOCK_COLOR_GREEN   0x39FF14
 #define BLOCK_COLOR_BLUE    0x00AAFF
@@ -66,7 +96,7 @@
 #define BLOCK_COLOR_PURPLE  0xBB00FF
 #define BLOCK_COLOR_LIME    0x66FF33
 
-#define GRID_OFFSET_X ((WINDOW_W - GRID_W * BLOCK_SIZE) / 2)
+#define GRID_OFFSET_X ((WINDOW_W - GRID_DEFAULT * BLOCK_SIZE) / 2)
 #define GRID_OFFSET_Y 100
 
 #define GAME_MODE_CLASSIC 0
@@ -78,6 +108,17 @@
 
 #define MAX_PARTICLES 100
 
+/* Solo placements kept for undo */
+#define UNDO_HISTORY_SIZE 64
+
+/* Hands the fair dealer may redraw before it keeps the one that fits best */
+#define DEAL_REDRAW_BUDGET 8
+
+/* Client frame pacing: the target rate while something moves, and how long a still screen
+ * waits for input or server data before looking again */
+#define FRAME_RATE   60
+#define IDLE_WAIT_MS 100
+
 #define GLOW_PULSE_SPEED   3.0f
 #define BUTTON_PULSE_SPEED 2.0f
 
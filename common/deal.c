@@ -0,0 +1,154 @@
+#include "deal.h"
+#include "config.h"
+
+static void refill_bag(PieceDealer *d) {
+    int i;
+
+    d->bag_left = 0;
+    for (i = 0; i < NUM_PIECE_TEMPLATES; i++) {
+        d->bag[i] = (unsigned char)piece_infos[i].weight;
+        d->bag_left += piece_infos[i].weight;
+    }
+}
+
+static int bag_draw(PieceDealer *d) {
+    int k = (int)rng_below(&d->rng, (uint32_t)d->bag_left);
+    int i;
+
+    for (i = 0; i < NUM_PIECE_TEMPLATES - 1; i++) {
+        if (k < d->bag[i]) break;
+        k -= d->bag[i];
+    }
+    d->bag[i]--;
+    d->bag_left--;
+    return i;
+}
+
+static void bag_return(PieceDealer *d, const int ids[3]) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        d->bag[ids[i]]++;
+        d->bag_left++;
+    }
+}
+
+static void bag_take(PieceDealer *d, const int ids[3]) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        d->bag[ids[i]]--;
+        d->bag_left--;
+    }
+}
+
+void dealer_init(PieceDealer *d, uint32_t seed, int mode) {
+    rng_seed(&d->rng, seed);
+    d->mode = mode;
+    refill_bag(d);
+}
+
+/* Returns as soon as every remaining piece is placed, so a playable hand costs one path */
+static int fit_search(const BitBoard *bb, const int ids[3], int remaining, int last_idx, int last_lines) {
+    int want = bb_popcount((uint32_t)remaining);
+    int best = 0;
+    int j, k, r;
+
+    for (j = 0; j < 3; j++) {
+        const BBPiece *p;
+        BBMoveMap map;
+        int rest = remaining & ~(1 << j);
+        int dup = 0;
+
+        if (!(remaining & (1 << j))) continue;
+        for (k = 0; k < j; k++) {
+            if ((remaining & (1 << k)) && ids[k] == ids[j]) dup = 1;
+        }
+        if (dup) continue;
+
+        p = &piece_infos[ids[j]].bb;
+        if (!rest) {
+            if (bb_has_any_anchor(bb, p)) return 1;
+            continue;
+        }
+
+        bb_move_map(bb, p, &map);
+        if (!map.count) continue;
+        if (best < 1) best = 1;
+
+        for (r = 0; r + p->h <= bb->size; r++) {
+            uint16_t cols = map.legal[r];
+            while (cols) {
+                BitBoard next = *bb;
+                int c = bb_lowest_bit(cols);
+                BBClear clear = bb_move_clear(&map, r, c);
+                int lines, n;
+
+                cols &= (uint16_t)(cols - 1);
+                lines = bb_apply(&next, p, r, c, &clear);
+                /* Same commutation cut as the solver */
+                if (lines == 0 && last_lines == 0 && j < last_idx) continue;
+
+                n = 1 + fit_search(&next, ids, rest, j, lines);
+                if (n > best) {
+                    best = n;
+                    if (best == want) return best;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+int deal_hand_fit(const BitBoard *bb, const int ids[3]) {
+    return fit_search(bb, ids, 7, -1, 0);
+}
+
+int dealer_deal(PieceDealer *d, const BitBoard *bb, int ids[3]) {
+    int best[3] = {0, 0, 0};
+    int best_fit = -1;
+    int attempt, i;
+
+    if (d->mode == DEAL_UNIFORM) {
+        for (i = 0; i < 3; i++) {
+            ids[i] = (int)rng_below(&d->rng, NUM_PIECE_TEMPLATES);
+        }
+        return 0;
+    }
+
+    if (d->bag_left < 3) refill_bag(d);
+
+    /* Rejected hands go back in the bag, so only the kept hand changes the bag */
+    for (attempt = 0; attempt <= DEAL_REDRAW_BUDGET; attempt++) {
+        int fit;
+
+        for (i = 0; i < 3; i++) {
+            ids[i] = bag_draw(d);
+        }
+        fit = deal_hand_fit(bb, ids);
+        if (fit == 3) return attempt;
+
+        bag_return(d, ids);
+        if (fit > best_fit) {
+            best_fit = fit;
+            for (i = 0; i < 3; i++) best[i] = ids[i];
+        }
+    }
+
+    for (i = 0; i < 3; i++) ids[i] = best[i];
+    bag_take(d, ids);
+    return DEAL_REDRAW_BUDGET;
+}
+
+int dealer_valid(const PieceDealer *d) {
+    int total = 0;
+    int i;
+
+    if (d->mode != DEAL_UNIFORM && d->mode != DEAL_FAIR) return 0;
+    for (i = 0; i < NUM_PIECE_TEMPLATES; i++) {
+        if (d->bag[i] > piece_infos[i].weight) return 0;
+        total += d->bag[i];
+    }
+    return total == d->bag_left;
+}
@@ -0,0 +1,34 @@
+#ifndef DEAL_H
+#define DEAL_H
+
+#include "rng.h"
+#include "bitboard.h"
+#include "pieces.h"
+
+typedef enum {
+    DEAL_UNIFORM,
+    DEAL_FAIR
+} DealMode;
+
+/* DEAL_UNIFORM draws three independent templates. DEAL_FAIR draws from a bag
+ * holding PieceInfo.weight copies of each template and redraws, up to
+ * DEAL_REDRAW_BUDGET times, a hand that cannot be placed in full on the board. */
+typedef struct {
+    Rng rng;
+    int mode;
+    int bag_left;
+    unsigned char bag[NUM_PIECE_TEMPLATES];
+} PieceDealer;
+
+void dealer_init(PieceDealer *d, uint32_t seed, int mode);
+
+/* Returns the number of redraws used */
+int dealer_deal(PieceDealer *d, const BitBoard *bb, int ids[3]);
+
+/* Most pieces of the hand that fit on the board one after the other, in the best order */
+int deal_hand_fit(const BitBoard *bb, const int ids[3]);
+
+/* Rejects bags from untrusted sources (saves) */
+int dealer_valid(const PieceDealer *d);
+
+#endif
@@ -1,7 +1,13 @@
 #ifndef NET_PROTOCOL_H
 #define NET_PROTOCOL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include "config.h"
+#include "deal.h"
+
+#define PACKET_MAX_GRIDS 4
 
 typedef enum {
     MSG_LOGIN = 1,
@@ -27,7 +33,10 @@ typedef enum {
     MSG_RUSH_UPDATE,
     MSG_SWITCH_VIEW,
     MSG_TIME_SYNC,
-    MSG_GAME_END
+    MSG_GAME_END,
+    MSG_SET_GRID_SIZE,
+    MSG_SET_RULESET,
+    MSG_ADD_BOT
 } MsgType;
 
 typedef struct {
@@ -47,7 +56,6 @@ typedef struct {
 
 typedef struct {
     char pseudo[32];
-    int grid[GRID_H][GRID_W];
     int score;
     int is_spectator;
 } RushPlayerState;
@@ -64,6 +72,9 @@ typedef struct {
     int is_public;
     int spectator_count;
     int is_spectator[4];
+    int is_bot[4];
+    int grid_size;
+    int ruleset;
 } LobbyState;
 
 typedef struct {
@@ -77,7 +88,6 @@ typedef struct {
     int type;
     int client_id;
     char text[64];
-    int grid_data[GRID_H][GRID_W];
     int score;
     char turn_pseudo[32];
     LobbyState lobby;
@@ -89,7 +99,73 @@ typedef struct {
     int viewing_player_idx;
     RushPlayerState rush_states[4];
     int rush_player_count;
+    /* The seed and the scoring ruleset make up the game header */
+    unsigned int seed;
+    int ruleset;
+    int bot_level;
+    int piece_id;
+    int piece_row;
+    int piece_col;
+    uint64_t state_hash;
+    /* A rejected move's correction: the seat's hand as the server holds it, -1 for a piece
+     * already played, and the dealer its next hands come from */
+    int hand[3];
+    PieceDealer dealer;
+    /* Grids go last and only grid_count * grid_size^2 cells are sent, see packet_wire_size() */
+    int grid_size;
+    int grid_count;
+    Cell grids[PACKET_MAX_GRIDS * GRID_MAX * GRID_MAX];
 } Packet;
 #pragma pack(pop)
 
+#define PACKET_HEADER_SIZE ((int)offsetof(Packet, grids))
+
+static inline int packet_header_valid(const Packet *pkt) {
+    if (pkt->grid_count == 0) return 1;
+    return pkt->grid_count > 0 && pkt->grid_count <= PACKET_MAX_GRIDS &&
+           pkt->grid_size >= GRID_MIN && pkt->grid_size <= GRID_MAX;
+}
+
+static inline int packet_wire_size(const Packet *pkt) {
+    return PACKET_HEADER_SIZE + pkt->grid_count * pkt->grid_size * pkt->grid_size;
+}
+
+/* Every grid of a packet has the same size, the one of the room */
+static inline void packet_put_grid(Packet *pkt, int index, const Cell grid[GRID_MAX][GRID_MAX], int size) {
+    Cell *dst = pkt->grids + index * size * size;
+    int r;
+
+    pkt->grid_size = size;
+    if (pkt->grid_count <= index) pkt->grid_count = index + 1;
+    for (r = 0; r < size; r++) {
+        memcpy(dst + r * size, grid[r], (size_t)size);
+    }
+}
+
+/* Returns 0 and leaves the grid alone when the packet does not carry that grid */
+static inline int packet_get_grid(const Packet *pkt, int index, Cell grid[GRID_MAX][GRID_MAX]) {
+    const Cell *src = pkt->grids + index * pkt->grid_size * pkt->grid_size;
+    int r;
+
+    if (index >= pkt->grid_count) return 0;
+    memset(grid, 0, sizeof(Cell) * GRID_MAX * GRID_MAX);
+    for (r = 0; r < pkt->grid_size; r++) {
+        memcpy(grid[r], src + r * pkt->grid_size, (size_t)pkt->grid_size);
+    }
+    return 1;
+}
+
+/* Reassembles packets from a stream socket, which may deliver them in pieces */
+typedef struct {
+    Packet pkt;
+    int len;
+} PacketReader;
+
+/* Bytes to read next: 0 once a whole packet is in, -1 when the header is not a packet */
+static inline int packet_reader_need(const PacketReader *rd) {
+    if (rd->len < PACKET_HEADER_SIZE) return PACKET_HEADER_SIZE - rd->len;
+    if (!packet_header_valid(&rd->pkt)) return -1;
+    return packet_wire_size(&rd->pkt) - rd->len;
+}
+
 #endif
@@ -0,0 +1,22 @@
+#include "pieces.h"
+
+#define PIECE_INFO(shape, cell, weight) \
+    { \
+        shape, \
+        cell, \
+        { \
+            { PIECE_MASK_ROW(shape, 0), PIECE_MASK_ROW(shape, 1), PIECE_MASK_ROW(shape, 2), \
+              PIECE_MASK_ROW(shape, 3), PIECE_MASK_ROW(shape, 4) }, \
+            PIECE_MASK_W(shape), \
+            PIECE_MASK_H(shape), \
+            PIECE_MASK_CELLS(shape), \
+            PIECE_MASK_ANCHORS(shape) \
+        }, \
+        weight \
+    },
+
+const unsigned int block_palette[BLOCK_PALETTE_SIZE] = BLOCK_PALETTE_RGB;
+
+const PieceInfo piece_infos[NUM_PIECE_TEMPLATES] = {
+    PIECE_TEMPLATE_LIST(PIECE_INFO)
+};
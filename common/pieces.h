@@ -0,0 +1,197 @@
+#ifndef PIECES_H
+#define PIECES_H
+
+#include <stdint.h>
+#include "bitboard.h"
+
+/* A shape is a 25-bit mask, bit (r * 5 + c) set when cell (r, c) is filled. */
+#define PIECE_SHAPE(a0, a1, a2, a3, a4, \
+                    b0, b1, b2, b3, b4, \
+                    c0, c1, c2, c3, c4, \
+                    d0, d1, d2, d3, d4, \
+                    e0, e1, e2, e3, e4) \
+    ((uint32_t)(PIECE_ROW5(a0, a1, a2, a3, a4) | \
+                PIECE_ROW5(b0, b1, b2, b3, b4) << 5 | \
+                PIECE_ROW5(c0, c1, c2, c3, c4) << 10 | \
+                PIECE_ROW5(d0, d1, d2, d3, d4) << 15 | \
+                PIECE_ROW5(e0, e1, e2, e3, e4) << 20))
+#define PIECE_ROW5(x0, x1, x2, x3, x4) ((x0) | (x1) << 1 | (x2) << 2 | (x3) << 3 | (x4) << 4)
+
+/* The one definition of every piece: X(shape, palette index, bag weight). The position in the list is the piece ID.
+ * The weight is how many copies of the piece a fresh bag holds, larger pieces come less often. */
+#define PIECE_TEMPLATE_LIST(X) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_PURPLE, 2) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_BLUE, 2) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_CYAN, 2) \
+    X(PIECE_SHAPE(1, 1, 0, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_BLUE, 2) \
+    X(PIECE_SHAPE(1, 1, 1, 0, 0, \
+                  1, 1, 1, 0, 0, \
+                  1, 1, 1, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_RED, 1) \
+    X(PIECE_SHAPE(1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_RED, 2) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_ORANGE, 2) \
+    X(PIECE_SHAPE(1, 1, 0, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_BLUE, 1) \
+    X(PIECE_SHAPE(1, 1, 1, 1, 1, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_GREEN, 1) \
+    X(PIECE_SHAPE(1, 1, 0, 0, 0, \
+                  0, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_CYAN, 2) \
+    X(PIECE_SHAPE(0, 1, 1, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_CYAN, 2) \
+    X(PIECE_SHAPE(1, 1, 0, 0, 0, \
+                  0, 1, 1, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_BLUE, 2) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 1, 1, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_GREEN, 1) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0), CELL_GOLD, 1) \
+    X(PIECE_SHAPE(1, 1, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_GOLD, 2) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 0, 0, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_ORANGE, 2) \
+    X(PIECE_SHAPE(1, 1, 1, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_BLUE, 2) \
+    X(PIECE_SHAPE(1, 0, 0, 0, 0, \
+                  1, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_BLUE, 2) \
+    X(PIECE_SHAPE(1, 1, 1, 0, 0, \
+                  0, 1, 0, 0, 0, \
+                  0, 1, 0, 0, 0, \
+                  0, 0, 0, 0, 0, \
+                  0, 0, 0, 0, 0), CELL_PURPLE, 1)
+
+#define PIECE_COUNT_ONE(shape, cell, weight) + 1
+enum { NUM_PIECE_TEMPLATES = 0 PIECE_TEMPLATE_LIST(PIECE_COUNT_ONE) };
+
+/* Metadata derived from the mask, all constant expressions */
+#define PIECE_MASK_ROW(m, r) (((m) >> ((r) * 5)) & 0x1Fu)
+#define PIECE_SPAN5(x) ((x) & 0x10u ? 5 : (x) & 0x08u ? 4 : (x) & 0x04u ? 3 : (x) & 0x02u ? 2 : (x) ? 1 : 0)
+#define PIECE_POP5(x) (((x) & 1u) + ((x) >> 1 & 1u) + ((x) >> 2 & 1u) + ((x) >> 3 & 1u) + ((x) >> 4 & 1u))
+#define PIECE_MASK_W(m) PIECE_SPAN5(PIECE_MASK_ROW(m, 0) | PIECE_MASK_ROW(m, 1) | PIECE_MASK_ROW(m, 2) | \
+                                    PIECE_MASK_ROW(m, 3) | PIECE_MASK_ROW(m, 4))
+#define PIECE_MASK_H(m) PIECE_SPAN5((PIECE_MASK_ROW(m, 0) ? 1u : 0u) | (PIECE_MASK_ROW(m, 1) ? 2u : 0u) | \
+                                    (PIECE_MASK_ROW(m, 2) ? 4u : 0u) | (PIECE_MASK_ROW(m, 3) ? 8u : 0u) | \
+                                    (PIECE_MASK_ROW(m, 4) ? 16u : 0u))
+#define PIECE_MASK_CELLS(m) (PIECE_POP5(PIECE_MASK_ROW(m, 0)) + PIECE_POP5(PIECE_MASK_ROW(m, 1)) + \
+                             PIECE_POP5(PIECE_MASK_ROW(m, 2)) + PIECE_POP5(PIECE_MASK_ROW(m, 3)) + \
+                             PIECE_POP5(PIECE_MASK_ROW(m, 4)))
+#define PIECE_ANCHOR_COLS(m, n) ((uint16_t)((1u << ((n) - PIECE_MASK_W(m) + 1)) - 1u))
+#define PIECE_MASK_ANCHORS(m) \
+    { PIECE_ANCHOR_COLS(m, 8), PIECE_ANCHOR_COLS(m, 9), PIECE_ANCHOR_COLS(m, 10), \
+      PIECE_ANCHOR_COLS(m, 11), PIECE_ANCHOR_COLS(m, 12), PIECE_ANCHOR_COLS(m, 13), \
+      PIECE_ANCHOR_COLS(m, 14), PIECE_ANCHOR_COLS(m, 15), PIECE_ANCHOR_COLS(m, 16) }
+
+typedef char piece_anchors_cover_grid_sizes[GRID_MIN == 8 && GRID_MAX == 16 ? 1 : -1];
+
+typedef struct {
+    uint32_t mask;
+    Cell cell;
+    BBPiece bb;
+    int weight;
+} PieceInfo;
+
+/* 4 bytes: the template ID and its shape, so cell tests need no table lookup */
+typedef struct {
+    unsigned int mask : 25;
+    unsigned int id : 7;
+} Piece;
+
+typedef char piece_id_fits_7_bits[NUM_PIECE_TEMPLATES <= 128 ? 1 : -1];
+
+extern const PieceInfo piece_infos[NUM_PIECE_TEMPLATES];
+extern const unsigned int block_palette[BLOCK_PALETTE_SIZE];
+
+/* Out-of-range indices (e.g. from the network) draw white rather than read past the palette */
+static inline unsigned int cell_color(Cell c) {
+    return c < BLOCK_PALETTE_SIZE ? block_palette[c] : 0xFFFFFF;
+}
+
+static inline Piece piece_make(int id) {
+    Piece p;
+    if (id < 0 || id >= NUM_PIECE_TEMPLATES) id = 0;
+    p.mask = piece_infos[id].mask;
+    p.id = (unsigned int)id;
+    return p;
+}
+
+static inline int piece_cell(const Piece *p, int r, int c) {
+    return (int)((p->mask >> (r * 5 + c)) & 1u);
+}
+
+static inline const PieceInfo *piece_info(const Piece *p) {
+    return &piece_infos[p->id];
+}
+
+static inline int piece_w(const Piece *p) {
+    return piece_infos[p->id].bb.w;
+}
+
+static inline int piece_h(const Piece *p) {
+    return piece_infos[p->id].bb.h;
+}
+
+static inline Cell piece_palette(const Piece *p) {
+    return piece_infos[p->id].cell;
+}
+
+static inline int piece_color(const Piece *p) {
+    return (int)block_palette[piece_infos[p->id].cell];
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t s[4];
+} Rng;
+
+static inline uint32_t rng_rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+static inline uint32_t rng_splitmix(uint32_t *z) {
+    uint32_t x = (*z += 0x9E3779B9u);
+    x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+    x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+    return x ^ (x >> 16);
+}
+
+static inline void rng_seed(Rng *rng, uint32_t seed) {
+    uint32_t z = seed;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        rng->s[i] = rng_splitmix(&z);
+    }
+
+    if ((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+        rng->s[0] = 1;
+    }
+}
+
+/* xoshiro128** */
+static inline uint32_t rng_next(Rng *rng) {
+    uint32_t *s = rng->s;
+    uint32_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 11);
+
+    return result;
+}
+
+static inline uint32_t rng_below(Rng *rng, uint32_t n) {
+    return (uint32_t)(((uint64_t)rng_next(rng) * n) >> 32);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "rules.h"
+#include "zobrist.h"
+
+int rules_can_place(const Cell grid[GRID_MAX][GRID_MAX], int size, const Piece *p, int row, int col) {
+    const PieceInfo *info = piece_info(p);
+    int i, j;
+
+    if (row < 0 || col < 0 || row + info->bb.h > size || col + info->bb.w > size) {
+        return 0;
+    }
+
+    for (i = 0; i < info->bb.h; i++) {
+        unsigned int bits = info->bb.rows[i];
+        for (j = 0; bits; j++, bits >>= 1) {
+            if ((bits & 1u) && grid[row + i][col + j] != CELL_EMPTY) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+void rules_stamp(Cell grid[GRID_MAX][GRID_MAX], const Piece *p, int row, int col, uint64_t *hash) {
+    const PieceInfo *info = piece_info(p);
+    int i, j;
+
+    for (i = 0; i < info->bb.h; i++) {
+        unsigned int bits = info->bb.rows[i];
+        for (j = 0; bits; j++, bits >>= 1) {
+            if (bits & 1u) {
+                grid[row + i][col + j] = info->cell;
+                if (hash) *hash ^= zobrist_key(row + i, col + j, info->cell);
+            }
+        }
+    }
+}
+
+int rules_full_lines(const Cell grid[GRID_MAX][GRID_MAX], int size, RulesLines *out) {
+    uint16_t occ[GRID_MAX];
+    uint16_t full = BB_ROW_MASK(size);
+    uint16_t rest = 0;
+    int i, j;
+
+    out->rows = 0;
+    out->cols = full;
+
+    for (i = 0; i < size; i++) {
+        uint16_t bits = 0;
+        for (j = 0; j < size; j++) {
+            bits |= (uint16_t)((grid[i][j] != CELL_EMPTY) << j);
+        }
+        occ[i] = bits;
+        out->cols &= bits;
+        if (bits == full) out->rows |= (uint16_t)(1u << i);
+    }
+
+    /* The board ends up empty when every cell outside the full rows sits in a full column */
+    for (i = 0; i < size; i++) {
+        if (!((out->rows >> i) & 1u)) rest |= occ[i];
+    }
+
+    out->lines = bb_popcount(out->rows) + bb_popcount(out->cols);
+    out->board_clear = out->lines > 0 && (rest & ~out->cols) == 0;
+    return out->lines;
+}
+
+static void clear_cell(Cell grid[GRID_MAX][GRID_MAX], int i, int j, uint64_t *hash) {
+    if (grid[i][j] == CELL_EMPTY) return;
+    if (hash) *hash ^= zobrist_key(i, j, grid[i][j]);
+    grid[i][j] = CELL_EMPTY;
+}
+
+void rules_clear_lines(Cell grid[GRID_MAX][GRID_MAX], int size, uint16_t rows, uint16_t cols, uint64_t *hash) {
+    int i, j;
+
+    for (i = 0; i < size; i++) {
+        if (!((rows >> i) & 1u)) continue;
+        for (j = 0; j < size; j++) {
+            clear_cell(grid, i, j, hash);
+        }
+    }
+
+    for (j = 0; j < size; j++) {
+        if (!((cols >> j) & 1u)) continue;
+        for (i = 0; i < size; i++) {
+            clear_cell(grid, i, j, hash);
+        }
+    }
+}
+
+int rules_place(Cell grid[GRID_MAX][GRID_MAX], int size, const Piece *p, int row, int col, uint64_t *hash) {
+    RulesLines full;
+
+    if (!rules_can_place(grid, size, p, row, col)) return -1;
+
+    rules_stamp(grid, p, row, col, hash);
+    rules_full_lines(grid, size, &full);
+    rules_clear_lines(grid, size, full.rows, full.cols, hash);
+
+    return full.lines;
+}
@@ -0,0 +1,29 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdint.h>
+#include "config.h"
+#include "pieces.h"
+
+/* Placement rules on a palette grid of size x size cells, shared by the client engine and the server.
+ * Every hash argument is an optional Zobrist hash kept in step with the grid. */
+
+int rules_can_place(const Cell grid[GRID_MAX][GRID_MAX], int size, const Piece *p, int row, int col);
+void rules_stamp(Cell grid[GRID_MAX][GRID_MAX], const Piece *p, int row, int col, uint64_t *hash);
+
+/* Bit i of rows / cols is set for each full row / column */
+typedef struct {
+    uint16_t rows;
+    uint16_t cols;
+    int lines;
+    int board_clear;
+} RulesLines;
+
+/* Finds the full lines, and whether clearing them empties the board, in one scan. Returns their count. */
+int rules_full_lines(const Cell grid[GRID_MAX][GRID_MAX], int size, RulesLines *out);
+void rules_clear_lines(Cell grid[GRID_MAX][GRID_MAX], int size, uint16_t rows, uint16_t cols, uint64_t *hash);
+
+/* Stamps the piece and clears full lines. Returns the lines cleared, or -1 if the piece does not fit. */
+int rules_place(Cell grid[GRID_MAX][GRID_MAX], int size, const Piece *p, int row, int col, uint64_t *hash);
+
+#endif
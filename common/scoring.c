@@ -0,0 +1,21 @@
+#include "scoring.h"
+
+#define SCORE_RULES(id, name, piece, cell, line, x1, x2, x3, x4, streak, cap, board) \
+    { name, piece, cell, line, { x1, x2, x3, x4 }, streak, cap, board },
+
+const ScoreRules score_rulesets[NUM_RULESETS] = {
+    SCORE_RULESET_LIST(SCORE_RULES)
+};
+
+int score_points(const ScoreRules *rules, int cells, int lines, int board_clear, int streak) {
+    int points = rules->per_piece + rules->per_cell * cells;
+
+    if (lines > 0) {
+        int multi = rules->multiplier[(lines < SCORE_MULTI_LINES ? lines : SCORE_MULTI_LINES) - 1];
+        points += rules->per_line * lines * multi / 100;
+        points += rules->streak_bonus * (streak < rules->streak_cap ? streak : rules->streak_cap);
+        if (board_clear) points += rules->board_clear;
+    }
+
+    return points;
+}
@@ -0,0 +1,52 @@
+#ifndef SCORING_H
+#define SCORING_H
+
+#include "config.h"
+
+/* Line multipliers are indexed by lines cleared at once, the last one also covers bigger clears */
+#define SCORE_MULTI_LINES 4
+
+/* One entry per ruleset: X(id, name, per piece, per cell, per line, x1, x2, x3, x4+,
+ * streak bonus, streak cap, board clear). Multipliers are percentages of the line points.
+ * The streak bonus is paid once per clearing placement in a row before this one, up to the cap. */
+#define SCORE_RULESET_LIST(X) \
+    X(RULESET_CLASSIC, "Classique", SCORE_PER_PIECE, 0, SCORE_PER_LINE, 100, 100, 100, 100, 0, 0, 0) \
+    X(RULESET_COMBO,   "Combo",     0, 1, SCORE_PER_LINE, 100, 150, 200, 300, 0, 0, 300) \
+    X(RULESET_STREAK,  "Serie",     0, 1, 80, 100, 125, 150, 200, 40, 10, 500)
+
+#define SCORE_RULESET_ENUM(id, name, piece, cell, line, x1, x2, x3, x4, streak, cap, board) id,
+typedef enum {
+    SCORE_RULESET_LIST(SCORE_RULESET_ENUM)
+    NUM_RULESETS
+} RulesetId;
+
+typedef struct {
+    const char *name;
+    int per_piece;
+    int per_cell;
+    int per_line;
+    int multiplier[SCORE_MULTI_LINES];
+    int streak_bonus;
+    int streak_cap;
+    int board_clear;
+} ScoreRules;
+
+extern const ScoreRules score_rulesets[NUM_RULESETS];
+
+/* Unknown IDs (saves, the network) score as RULESET_CLASSIC */
+static inline const ScoreRules *score_rules(int id) {
+    return &score_rulesets[id >= 0 && id < NUM_RULESETS ? id : RULESET_CLASSIC];
+}
+
+/* Points for a placement of `cells` cells clearing `lines` lines, board_clear when that left
+ * the board empty. streak is the number of clearing placements in a row just before it. */
+int score_points(const ScoreRules *rules, int cells, int lines, int board_clear, int streak);
+
+/* score_points() for the next placement, then advances *streak */
+static inline int score_move(const ScoreRules *rules, int cells, int lines, int board_clear, int *streak) {
+    int points = score_points(rules, cells, lines, board_clear, *streak);
+    *streak = lines > 0 ? *streak + 1 : 0;
+    return points;
+}
+
+#endif
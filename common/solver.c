@@ -0,0 +1,526 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "solver.h"
+
+#define SOLVER_MAX_ITEMS (SOLVER_MAX_PIECES * GRID_MAX * GRID_MAX)
+#define SOLVER_MAX_STEPS ((SOLVER_MAX_PIECES - 1) * GRID_MAX * GRID_MAX)
+
+/* Second placements run per thread between two deadline checks of a sliced search */
+#define SOLVER_STEPS_PER_CHECK 2
+
+const SolverWeights solver_default_weights = {
+    100,  /* line_clear */
+    -40,  /* hole */
+    3,    /* open_cell */
+    -4,   /* transition */
+    4     /* square_fit */
+};
+
+typedef struct {
+    const BBPiece *pieces;
+    int same_as[SOLVER_MAX_PIECES];
+    SolverHeuristic heuristic;
+} SolverShared;
+
+typedef struct {
+    int piece_idx;
+    int row, col;
+    SolverResult best;
+} SolverItem;
+
+typedef struct {
+    const BitBoard *root;
+    SolverShared shared;
+    SolverItem *items;
+} SolverJob;
+
+/* Items are the first placements. A sliced search splits the item it is on into its second
+ * placements, the steps, and keeps the board that item left. */
+struct SolverTask {
+    BitBoard root;
+    BBPiece pieces[SOLVER_MAX_PIECES];
+    SolverJob job;
+    SolverItem items[SOLVER_MAX_ITEMS];
+    int num_items;
+    int next_item;
+
+    BitBoard board;
+    int lines;
+    int remaining;
+    long long nodes;
+    SolverItem steps[SOLVER_MAX_STEPS];
+    int num_steps;
+    /* -1 until the steps of next_item are listed */
+    int next_step;
+};
+
+unsigned int solver_clock_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    return (unsigned int)((now.QuadPart / freq.QuadPart) * 1000 + (now.QuadPart % freq.QuadPart) * 1000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int)ts.tv_sec * 1000u + (unsigned int)(ts.tv_nsec / 1000000);
+#endif
+}
+
+BB_SPECIALIZE int weighted_heuristic_n(const BitBoard *bb, const SolverOutcome *outcome,
+                                       const SolverWeights *w, int n) {
+    int holes = 0, open = 0, transitions = 0, squares = 0;
+    /* Per-row masks are packed four to a word so each feature costs one popcount per four rows */
+    uint64_t acc_holes = 0, acc_open = 0, acc_trans = 0, acc_vtrans = 0, acc_squares = 0;
+    int r;
+
+    for (r = 0; r < n; r++) {
+        uint16_t occ = bb->rows[r];
+        uint16_t empty = (uint16_t)(~occ & BB_ROW_MASK(n));
+        uint16_t up = r > 0 ? bb->rows[r - 1] : BB_ROW_MASK(n);
+        uint16_t down = r < n - 1 ? bb->rows[r + 1] : BB_ROW_MASK(n);
+        uint16_t left = (uint16_t)((occ << 1) | 1u);
+        uint16_t right = (uint16_t)((occ >> 1) | (1u << (n - 1)));
+        int shift = (r & 3) * 16;
+        /* the border counts as occupied: each cell against its left neighbour, then the last one against the right border */
+        uint16_t htrans = (uint16_t)((occ ^ left) & BB_ROW_MASK(n));
+        uint16_t vtrans = (uint16_t)((occ ^ up) & BB_ROW_MASK(n));
+
+        acc_open |= (uint64_t)empty << shift;
+        acc_holes |= (uint64_t)(empty & left & right & up & down) << shift;
+        acc_trans |= (uint64_t)htrans << shift;
+        acc_vtrans |= (uint64_t)vtrans << shift;
+        transitions += (empty >> (n - 1)) & 1u;
+        if (r == n - 1) transitions += bb_popcount(empty);
+
+        if (r + 3 <= n) {
+            uint16_t e = (uint16_t)(~(occ | bb->rows[r + 1] | bb->rows[r + 2]) & BB_ROW_MASK(n));
+            e &= (uint16_t)(e >> 1);
+            e &= (uint16_t)(e >> 1);
+            acc_squares |= (uint64_t)(e & ((1u << (n - 2)) - 1u)) << shift;
+        }
+
+        if ((r & 3) == 3 || r == n - 1) {
+            open += bb_popcount64(acc_open);
+            holes += bb_popcount64(acc_holes);
+            transitions += bb_popcount64(acc_trans) + bb_popcount64(acc_vtrans);
+            squares += bb_popcount64(acc_squares);
+            acc_open = acc_holes = acc_trans = acc_vtrans = acc_squares = 0;
+        }
+    }
+
+    return w->line_clear * outcome->lines
+         + w->hole * holes
+         + w->open_cell * open
+         + w->transition * transitions
+         + w->square_fit * (squares > 4 ? 4 : squares);
+}
+
+int solver_weighted_heuristic(const BitBoard *bb, const SolverOutcome *outcome, const void *user) {
+    const SolverWeights *w = user ? (const SolverWeights *)user : &solver_default_weights;
+    if (bb->size == GRID_DEFAULT) return weighted_heuristic_n(bb, outcome, w, GRID_DEFAULT);
+    return weighted_heuristic_n(bb, outcome, w, bb->size);
+}
+
+static int better(const SolverResult *a, const SolverResult *b) {
+    if (a->count != b->count) return a->count > b->count;
+    return a->score > b->score;
+}
+
+static void search(const SolverShared *sh, const BitBoard *bb, int remaining,
+                   int last_idx, int last_lines, SolverOutcome *outcome,
+                   SolverMove *seq, SolverResult *best, long long *nodes) {
+    int any_placed = 0;
+    int j, k, r;
+
+    for (j = 0; j < SOLVER_MAX_PIECES; j++) {
+        const BBPiece *p;
+        BBMoveMap map;
+        int dup = 0;
+
+        if (!(remaining & (1 << j))) continue;
+        for (k = 0; k < j; k++) {
+            if ((remaining & (1 << k)) && sh->same_as[j] == sh->same_as[k]) dup = 1;
+        }
+        if (dup) continue;
+
+        p = &sh->pieces[j];
+        bb_move_map(bb, p, &map);
+        if (map.count) any_placed = 1;
+
+        for (r = 0; r + p->h <= bb->size; r++) {
+            uint16_t cols = map.legal[r];
+            while (cols) {
+                BitBoard next = *bb;
+                int c = bb_lowest_bit(cols);
+                BBClear clear = bb_move_clear(&map, r, c);
+                int lines;
+
+                cols &= (uint16_t)(cols - 1);
+
+                lines = bb_apply(&next, p, r, c, &clear);
+                (*nodes)++;
+
+                /* Two placements that clear nothing commute, so only one order is searched */
+                if (lines == 0 && last_lines == 0 && j < last_idx) continue;
+
+                seq[outcome->placed].piece_idx = j;
+                seq[outcome->placed].row = r;
+                seq[outcome->placed].col = c;
+                outcome->placed++;
+                outcome->lines += lines;
+                outcome->cells += p->cells;
+
+                search(sh, &next, remaining & ~(1 << j), j, lines, outcome, seq, best, nodes);
+
+                outcome->placed--;
+                outcome->lines -= lines;
+                outcome->cells -= p->cells;
+            }
+        }
+    }
+
+    if (!any_placed) {
+        SolverResult cand;
+        cand.count = outcome->placed;
+        cand.score = sh->heuristic.fn(bb, outcome, sh->heuristic.user);
+        cand.lines = outcome->lines;
+        cand.nodes = 0;
+        memcpy(cand.moves, seq, sizeof(SolverMove) * outcome->placed);
+        if (best->count < 0 || better(&cand, best)) {
+            *best = cand;
+        }
+    }
+}
+
+static int item_remaining(const SolverShared *sh, int piece_idx) {
+    int remaining = 0;
+    int k;
+
+    for (k = 0; k < SOLVER_MAX_PIECES; k++) {
+        if (sh->same_as[k] >= 0 && k != piece_idx) remaining |= 1 << k;
+    }
+    return remaining;
+}
+
+static void solve_item(void *ctx, int index) {
+    SolverJob *job = (SolverJob *)ctx;
+    SolverItem *item = &job->items[index];
+    const BBPiece *p = &job->shared.pieces[item->piece_idx];
+    BitBoard next = *job->root;
+    SolverOutcome outcome;
+    SolverMove seq[SOLVER_MAX_PIECES];
+    long long nodes = 1;
+    int lines;
+
+    item->best.count = -1;
+
+    lines = bb_place(&next, p, item->row, item->col, NULL, NULL);
+    seq[0].piece_idx = item->piece_idx;
+    seq[0].row = item->row;
+    seq[0].col = item->col;
+    outcome.placed = 1;
+    outcome.lines = lines;
+    outcome.cells = p->cells;
+
+    search(&job->shared, &next, item_remaining(&job->shared, item->piece_idx), item->piece_idx, lines,
+           &outcome, seq, &item->best, &nodes);
+    item->best.nodes = nodes;
+}
+
+/* The first level of search() for one item, with the placements listed instead of searched */
+static void list_steps(SolverTask *task) {
+    const SolverShared *sh = &task->job.shared;
+    SolverItem *item = &task->items[task->next_item];
+    const BBPiece *p = &sh->pieces[item->piece_idx];
+    int any_placed = 0;
+    int j, k, r;
+
+    task->board = task->root;
+    task->lines = bb_place(&task->board, p, item->row, item->col, NULL, NULL);
+    task->remaining = item_remaining(sh, item->piece_idx);
+    task->nodes = 1;
+    task->num_steps = 0;
+    task->next_step = 0;
+    item->best.count = -1;
+
+    for (j = 0; j < SOLVER_MAX_PIECES; j++) {
+        const BBPiece *q;
+        BBMoveMap map;
+        int dup = 0;
+
+        if (!(task->remaining & (1 << j))) continue;
+        for (k = 0; k < j; k++) {
+            if ((task->remaining & (1 << k)) && sh->same_as[j] == sh->same_as[k]) dup = 1;
+        }
+        if (dup) continue;
+
+        q = &sh->pieces[j];
+        bb_move_map(&task->board, q, &map);
+        if (map.count) any_placed = 1;
+
+        for (r = 0; r + q->h <= task->board.size; r++) {
+            uint16_t cols = map.legal[r];
+            while (cols) {
+                BitBoard next = task->board;
+                int c = bb_lowest_bit(cols);
+                BBClear clear = bb_move_clear(&map, r, c);
+                int lines;
+
+                cols &= (uint16_t)(cols - 1);
+
+                lines = bb_apply(&next, q, r, c, &clear);
+                task->nodes++;
+                if (lines == 0 && task->lines == 0 && j < item->piece_idx) continue;
+
+                task->steps[task->num_steps].piece_idx = j;
+                task->steps[task->num_steps].row = r;
+                task->steps[task->num_steps].col = c;
+                task->num_steps++;
+            }
+        }
+    }
+
+    if (!any_placed) {
+        SolverOutcome outcome;
+        outcome.placed = 1;
+        outcome.lines = task->lines;
+        outcome.cells = p->cells;
+        item->best.count = 1;
+        item->best.score = sh->heuristic.fn(&task->board, &outcome, sh->heuristic.user);
+        item->best.lines = task->lines;
+        item->best.moves[0].piece_idx = item->piece_idx;
+        item->best.moves[0].row = item->row;
+        item->best.moves[0].col = item->col;
+    }
+}
+
+static void solve_step(void *ctx, int index) {
+    SolverTask *task = (SolverTask *)ctx;
+    const SolverItem *item = &task->items[task->next_item];
+    SolverItem *step = &task->steps[task->next_step + index];
+    const BBPiece *p = &task->job.shared.pieces[item->piece_idx];
+    const BBPiece *q = &task->job.shared.pieces[step->piece_idx];
+    BitBoard next = task->board;
+    SolverOutcome outcome;
+    SolverMove seq[SOLVER_MAX_PIECES];
+    long long nodes = 0;
+    int lines;
+
+    step->best.count = -1;
+
+    lines = bb_place(&next, q, step->row, step->col, NULL, NULL);
+    seq[0].piece_idx = item->piece_idx;
+    seq[0].row = item->row;
+    seq[0].col = item->col;
+    seq[1].piece_idx = step->piece_idx;
+    seq[1].row = step->row;
+    seq[1].col = step->col;
+    outcome.placed = 2;
+    outcome.lines = task->lines + lines;
+    outcome.cells = p->cells + q->cells;
+
+    search(&task->job.shared, &next, task->remaining & ~(1 << step->piece_idx), step->piece_idx, lines,
+           &outcome, seq, &step->best, &nodes);
+    step->best.nodes = nodes;
+}
+
+/* Runs the next steps of the current item and keeps the best in step order, the order
+ * search() would have met them in */
+static void run_steps(SolverTask *task, ThreadPool *pool, int count) {
+    SolverItem *item = &task->items[task->next_item];
+    int i;
+
+    thread_pool_run(pool, solve_step, task, count);
+    for (i = 0; i < count; i++) {
+        const SolverResult *cand = &task->steps[task->next_step + i].best;
+        task->nodes += cand->nodes;
+        if (cand->count >= 0 && (item->best.count < 0 || better(cand, &item->best))) {
+            item->best = *cand;
+        }
+    }
+    task->next_step += count;
+
+    if (task->next_step == task->num_steps) {
+        item->best.nodes = task->nodes;
+        task->next_item++;
+        task->next_step = -1;
+    }
+}
+
+SolverTask *solver_task_new(const BitBoard *bb, const BBPiece pieces[SOLVER_MAX_PIECES],
+                            const int available[SOLVER_MAX_PIECES],
+                            const SolverHeuristic *heuristic) {
+    SolverTask *task = (SolverTask *)malloc(sizeof(SolverTask));
+    SolverJob *job;
+    int i, k, r;
+
+    if (!task) return NULL;
+    task->root = *bb;
+    memcpy(task->pieces, pieces, sizeof(task->pieces));
+    task->num_items = 0;
+    task->next_item = 0;
+    task->next_step = -1;
+
+    job = &task->job;
+    job->root = &task->root;
+    job->shared.pieces = task->pieces;
+    job->items = task->items;
+    if (heuristic && heuristic->fn) {
+        job->shared.heuristic = *heuristic;
+    } else {
+        job->shared.heuristic.fn = solver_weighted_heuristic;
+        job->shared.heuristic.user = NULL;
+    }
+
+    for (i = 0; i < SOLVER_MAX_PIECES; i++) {
+        job->shared.same_as[i] = -1;
+        if (!available[i]) continue;
+        job->shared.same_as[i] = i;
+        for (k = 0; k < i; k++) {
+            if (job->shared.same_as[k] == k &&
+                pieces[k].w == pieces[i].w && pieces[k].h == pieces[i].h &&
+                memcmp(pieces[k].rows, pieces[i].rows, sizeof(pieces[i].rows)) == 0) {
+                job->shared.same_as[i] = k;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < SOLVER_MAX_PIECES; i++) {
+        const BBPiece *p = &pieces[i];
+        if (job->shared.same_as[i] != i) continue;
+        for (r = 0; r + p->h <= bb->size; r++) {
+            uint16_t cols = bb_legal_cols(bb, p, r);
+            while (cols) {
+                int c = bb_lowest_bit(cols);
+                cols &= (uint16_t)(cols - 1);
+                task->items[task->num_items].piece_idx = i;
+                task->items[task->num_items].row = r;
+                task->items[task->num_items].col = c;
+                task->num_items++;
+            }
+        }
+    }
+
+    return task;
+}
+
+int solver_task_run(SolverTask *task, ThreadPool *pool, int budget_ms) {
+    unsigned int start = solver_clock_ms();
+    int per_check = SOLVER_STEPS_PER_CHECK * thread_pool_size(pool);
+
+    while (task->next_item < task->num_items) {
+        int count;
+
+        /* Nothing to stop for: the items that are left run whole, in parallel */
+        if (budget_ms <= 0 && task->next_step < 0) {
+            SolverJob job = task->job;
+            job.items += task->next_item;
+            thread_pool_run(pool, solve_item, &job, task->num_items - task->next_item);
+            task->next_item = task->num_items;
+            break;
+        }
+
+        if (task->next_step < 0) list_steps(task);
+        count = task->num_steps - task->next_step;
+        run_steps(task, pool, count < per_check ? count : per_check);
+
+        if (budget_ms > 0 && solver_clock_ms() - start >= (unsigned int)budget_ms) break;
+    }
+
+    return task->next_item == task->num_items;
+}
+
+int solver_task_result(const SolverTask *task, SolverResult *result) {
+    int i;
+
+    memset(result, 0, sizeof(SolverResult));
+
+    /* Reduce in item order so the answer does not depend on thread scheduling */
+    for (i = 0; i < task->next_item; i++) {
+        const SolverItem *item = &task->items[i];
+        result->nodes += item->best.nodes;
+        if (result->count == 0 || better(&item->best, result)) {
+            long long nodes = result->nodes;
+            *result = item->best;
+            result->nodes = nodes;
+        }
+    }
+
+    if (result->count == 0) {
+        result->score = INT_MIN;
+    }
+
+    return result->count;
+}
+
+int solver_task_ranked(const SolverTask *task, SolverResult *results, int max_results) {
+    int count = 0;
+    int i, k;
+
+    if (max_results <= 0) return 0;
+
+    /* Insertion in item order keeps ties in a fixed order */
+    for (i = 0; i < task->next_item; i++) {
+        const SolverResult *cand = &task->items[i].best;
+        /* Every sequence from this item is searched from another one */
+        if (cand->count < 0) continue;
+        if (count == max_results && !better(cand, &results[count - 1])) continue;
+        k = count < max_results ? count++ : count - 1;
+        while (k > 0 && better(cand, &results[k - 1])) {
+            results[k] = results[k - 1];
+            k--;
+        }
+        results[k] = *cand;
+    }
+
+    return count;
+}
+
+void solver_task_free(SolverTask *task) {
+    free(task);
+}
+
+int solver_solve(const BitBoard *bb, const BBPiece pieces[SOLVER_MAX_PIECES],
+                 const int available[SOLVER_MAX_PIECES],
+                 const SolverHeuristic *heuristic, ThreadPool *pool,
+                 SolverResult *result) {
+    SolverTask *task = solver_task_new(bb, pieces, available, heuristic);
+
+    if (!task) {
+        memset(result, 0, sizeof(SolverResult));
+        return 0;
+    }
+    solver_task_run(task, pool, 0);
+    solver_task_result(task, result);
+    solver_task_free(task);
+    return result->count;
+}
+
+int solver_solve_ranked(const BitBoard *bb, const BBPiece pieces[SOLVER_MAX_PIECES],
+                        const int available[SOLVER_MAX_PIECES],
+                        const SolverHeuristic *heuristic, ThreadPool *pool,
+                        SolverResult *results, int max_results) {
+    SolverTask *task;
+    int count;
+
+    if (max_results <= 0) return 0;
+    task = solver_task_new(bb, pieces, available, heuristic);
+    if (!task) return 0;
+    solver_task_run(task, pool, 0);
+    count = solver_task_ranked(task, results, max_results);
+    solver_task_free(task);
+    return count;
+}
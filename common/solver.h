@@ -0,0 +1,81 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "bitboard.h"
+#include "thread_pool.h"
+
+#define SOLVER_MAX_PIECES 3
+
+typedef struct {
+    int placed;
+    int lines;
+    int cells;
+} SolverOutcome;
+
+/* Scores the board reached after a placement sequence, higher is better. */
+typedef int (*SolverHeuristicFn)(const BitBoard *bb, const SolverOutcome *outcome, const void *user);
+
+typedef struct {
+    SolverHeuristicFn fn;
+    const void *user;
+} SolverHeuristic;
+
+typedef struct {
+    int line_clear;
+    int hole;
+    int open_cell;
+    int transition;
+    int square_fit;
+} SolverWeights;
+
+typedef struct {
+    int piece_idx;
+    int row, col;
+} SolverMove;
+
+typedef struct {
+    int count;
+    SolverMove moves[SOLVER_MAX_PIECES];
+    int score;
+    int lines;
+    long long nodes;
+} SolverResult;
+
+extern const SolverWeights solver_default_weights;
+
+/* user points to a SolverWeights, NULL uses solver_default_weights */
+int solver_weighted_heuristic(const BitBoard *bb, const SolverOutcome *outcome, const void *user);
+
+/* Searches every order and anchor of the available pieces and keeps the sequence
+ * that places the most pieces, then the one with the best heuristic score.
+ * heuristic and pool may be NULL. Returns result->count. */
+int solver_solve(const BitBoard *bb, const BBPiece pieces[SOLVER_MAX_PIECES],
+                 const int available[SOLVER_MAX_PIECES],
+                 const SolverHeuristic *heuristic, ThreadPool *pool,
+                 SolverResult *result);
+
+/* The best sequence for each distinct first placement, best first, at most max_results of them.
+ * Returns how many were written. */
+int solver_solve_ranked(const BitBoard *bb, const BBPiece pieces[SOLVER_MAX_PIECES],
+                        const int available[SOLVER_MAX_PIECES],
+                        const SolverHeuristic *heuristic, ThreadPool *pool,
+                        SolverResult *results, int max_results);
+
+/* The same search run in slices: solver_task_run() returns once budget_ms have passed, between
+ * two small pieces of work, and the next call carries on. It returns 1 when the search is done,
+ * budget_ms <= 0 runs it to the end. The results only count the work done so far. */
+typedef struct SolverTask SolverTask;
+
+/* The board and pieces are copied. NULL when out of memory. */
+SolverTask *solver_task_new(const BitBoard *bb, const BBPiece pieces[SOLVER_MAX_PIECES],
+                            const int available[SOLVER_MAX_PIECES],
+                            const SolverHeuristic *heuristic);
+int solver_task_run(SolverTask *task, ThreadPool *pool, int budget_ms);
+int solver_task_result(const SolverTask *task, SolverResult *result);
+int solver_task_ranked(const SolverTask *task, SolverResult *results, int max_results);
+void solver_task_free(SolverTask *task);
+
+/* Monotonic milliseconds, the clock the budgets are measured on */
+unsigned int solver_clock_ms(void);
+
+#endif
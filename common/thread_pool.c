@@ -0,0 +1,208 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+typedef HANDLE tp_thread_t;
+typedef CRITICAL_SECTION tp_mutex_t;
+typedef CONDITION_VARIABLE tp_cond_t;
+#define tp_mutex_init(m) InitializeCriticalSection(m)
+#define tp_mutex_destroy(m) DeleteCriticalSection(m)
+#define tp_mutex_lock(m) EnterCriticalSection(m)
+#define tp_mutex_unlock(m) LeaveCriticalSection(m)
+#define tp_cond_init(c) InitializeConditionVariable(c)
+#define tp_cond_destroy(c) ((void)0)
+#define tp_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define tp_cond_broadcast(c) WakeAllConditionVariable(c)
+#define tp_cond_signal(c) WakeConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t tp_thread_t;
+typedef pthread_mutex_t tp_mutex_t;
+typedef pthread_cond_t tp_cond_t;
+#define tp_mutex_init(m) pthread_mutex_init(m, NULL)
+#define tp_mutex_destroy(m) pthread_mutex_destroy(m)
+#define tp_mutex_lock(m) pthread_mutex_lock(m)
+#define tp_mutex_unlock(m) pthread_mutex_unlock(m)
+#define tp_cond_init(c) pthread_cond_init(c, NULL)
+#define tp_cond_destroy(c) pthread_cond_destroy(c)
+#define tp_cond_wait(c, m) pthread_cond_wait(c, m)
+#define tp_cond_broadcast(c) pthread_cond_broadcast(c)
+#define tp_cond_signal(c) pthread_cond_signal(c)
+#endif
+
+#define MAX_POOL_THREADS 64
+
+struct ThreadPool {
+    tp_thread_t threads[MAX_POOL_THREADS];
+    int num_threads;
+
+    tp_mutex_t run_lock;
+    tp_mutex_t lock;
+    tp_cond_t work_cond;
+    tp_cond_t done_cond;
+
+    ThreadPoolTask task;
+    void *ctx;
+    int total;
+    int next;
+    int pending;
+    int shutdown;
+};
+
+int thread_pool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* Called with pool->lock held, returns with it held. */
+static void drain_tasks(ThreadPool *pool) {
+    while (pool->next < pool->total) {
+        int index = pool->next++;
+        ThreadPoolTask task = pool->task;
+        void *ctx = pool->ctx;
+
+        tp_mutex_unlock(&pool->lock);
+        task(ctx, index);
+        tp_mutex_lock(&pool->lock);
+
+        pool->pending--;
+        if (pool->pending == 0) {
+            tp_cond_broadcast(&pool->done_cond);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+#else
+static void *worker_main(void *arg) {
+#endif
+    ThreadPool *pool = (ThreadPool *)arg;
+
+    tp_mutex_lock(&pool->lock);
+    while (!pool->shutdown) {
+        if (pool->next < pool->total) {
+            drain_tasks(pool);
+        } else {
+            tp_cond_wait(&pool->work_cond, &pool->lock);
+        }
+    }
+    tp_mutex_unlock(&pool->lock);
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+ThreadPool *thread_pool_create(int threads) {
+    ThreadPool *pool;
+    int i;
+
+    if (threads <= 0) threads = thread_pool_cpu_count();
+    /* The caller of thread_pool_run counts as one of the threads */
+    threads--;
+    if (threads > MAX_POOL_THREADS) threads = MAX_POOL_THREADS;
+
+    pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+
+    tp_mutex_init(&pool->run_lock);
+    tp_mutex_init(&pool->lock);
+    tp_cond_init(&pool->work_cond);
+    tp_cond_init(&pool->done_cond);
+
+    for (i = 0; i < threads; i++) {
+#ifdef _WIN32
+        pool->threads[i] = CreateThread(NULL, 0, worker_main, pool, 0, NULL);
+        if (!pool->threads[i]) break;
+#else
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) break;
+#endif
+        pool->num_threads++;
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+    int i;
+
+    if (!pool) return;
+
+    tp_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    tp_cond_broadcast(&pool->work_cond);
+    tp_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_threads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+
+    tp_cond_destroy(&pool->done_cond);
+    tp_cond_destroy(&pool->work_cond);
+    tp_mutex_destroy(&pool->lock);
+    tp_mutex_destroy(&pool->run_lock);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool *pool) {
+    return pool ? pool->num_threads + 1 : 1;
+}
+
+void thread_pool_run(ThreadPool *pool, ThreadPoolTask task, void *ctx, int count) {
+    int i;
+
+    if (count <= 0) return;
+
+    if (!pool || pool->num_threads == 0 || count == 1) {
+        for (i = 0; i < count; i++) {
+            task(ctx, i);
+        }
+        return;
+    }
+
+    tp_mutex_lock(&pool->run_lock);
+    tp_mutex_lock(&pool->lock);
+
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->total = count;
+    pool->next = 0;
+    pool->pending = count;
+    tp_cond_broadcast(&pool->work_cond);
+
+    drain_tasks(pool);
+    while (pool->pending > 0) {
+        tp_cond_wait(&pool->done_cond, &pool->lock);
+    }
+
+    pool->task = NULL;
+    pool->ctx = NULL;
+    pool->total = 0;
+    pool->next = 0;
+
+    tp_mutex_unlock(&pool->lock);
+    tp_mutex_unlock(&pool->run_lock);
+}
@@ -0,0 +1,19 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*ThreadPoolTask)(void *ctx, int index);
+
+int thread_pool_cpu_count(void);
+
+/* threads <= 0 uses one worker per CPU. The calling thread also runs tasks. */
+ThreadPool *thread_pool_create(int threads);
+void thread_pool_destroy(ThreadPool *pool);
+int thread_pool_size(const ThreadPool *pool);
+
+/* Runs task(ctx, i) for i in [0, count) and returns once all calls are done.
+ * A NULL pool runs everything on the calling thread. */
+void thread_pool_run(ThreadPool *pool, ThreadPoolTask task, void *ctx, int count);
+
+#endif
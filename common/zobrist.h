@@ -0,0 +1,27 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+#include "config.h"
+
+/* Keys are splitmix64 of (cell, palette index), so the client, the server and
+ * the tools agree without sharing a table. An empty grid hashes to 0. */
+static inline uint64_t zobrist_key(int row, int col, Cell cell) {
+    uint64_t z = ((uint64_t)(row * GRID_MAX + col) * 256u + cell + 1u) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t zobrist_grid(const Cell grid[GRID_MAX][GRID_MAX], int size) {
+    uint64_t h = 0;
+    int r, c;
+    for (r = 0; r < size; r++) {
+        for (c = 0; c < size; c++) {
+            if (grid[r][c]) h ^= zobrist_key(r, c, grid[r][c]);
+        }
+    }
+    return h;
+}
+
+#endif
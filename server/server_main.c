@@ -26,6 +26,11 @@
 
 #include "../common/config.h"
 #include "../common/net_protocol.h"
+#include "../common/pieces.h"
+#include "../common/rules.h"
+#include "../common/deal.h"
+#include "../common/scoring.h"
+#include "../common/bot.h"
 
 #define MAX_CLIENTS 20
 #define MAX_ROOMS 10
@@ -33,6 +38,9 @@
 #define LEADERBOARD_MAGIC 0xBB1E4D38
 #define LEADERBOARD_KEY "BL0CK_BL4ST_L34D3RB04RD_S3CR3T!"
 #define MAX_LEADERBOARD_ENTRIES 100
+/* While bots play the loop wakes every tick and gives each one a search slice */
+#define BOT_TICK_MS 50
+#define BOT_SLICE_MS 20
 
 typedef struct {
     unsigned int magic;
@@ -51,15 +59,24 @@ typedef struct {
     int game_running;
     int timer_minutes;
     int current_turn;
-    int grid[GRID_H][GRID_W];
+    int grid_size;
+    Cell grid[GRID_MAX][GRID_MAX];
+    uint64_t grid_hash;
     int game_mode;
     int is_public;
     int is_spectator[4];
     int spectator_count;
-    int rush_grids[4][GRID_H][GRID_W];
-    int rush_scores[4];
+    Cell rush_grids[4][GRID_MAX][GRID_MAX];
+    uint64_t rush_hashes[4];
+    /* Each seat's score, counted by the server as it replays the moves */
+    int scores[4];
+    int streaks[4];
+    PieceDealer dealers[4];
+    int hands[4][3];
     time_t rush_start_time;
     int rush_duration;
+    unsigned int seed;
+    int ruleset;
 } Room;
 
 typedef struct {
@@ -67,6 +84,12 @@ typedef struct {
     char pseudo[32];
     int active;
     int room_idx;
+    PacketReader rx;
+    /* Bots hold a client slot without a socket and play through process_packet() */
+    int is_bot;
+    Bot bot;
+    int bot_thinking;
+    unsigned int bot_next_ms;
 } Client;
 
 static Client clients[MAX_CLIENTS];
@@ -75,6 +98,7 @@ static Room rooms[MAX_ROOMS];
 static void send_to_client(int client_idx, Packet *pkt);
 static void broadcast_to_room(int room_idx, Packet *pkt);
 static void save_score(const char *name, int score);
+static void save_client_score(int client_idx, int score);
 static void send_rush_update(int room_idx);
 static void send_room_update(int room_idx);
 
@@ -126,6 +150,13 @@ static void generate_code(char *dest) {
     dest[4] = '\0';
 }
 
+static unsigned int generate_seed(void) {
+    unsigned int seed = (unsigned int)time(NULL);
+    seed ^= (unsigned int)rand() << 16;
+    seed ^= (unsigned int)rand();
+    return seed;
+}
+
 static void save_score(const char *name, int score) {
     FILE *f;
     LeaderboardSaveData data;
@@ -192,6 +223,13 @@ static void save_score(const char *name, int score) {
     }
 }
 
+/* Bots do not enter the leaderboard */
+static void save_client_score(int client_idx, int score) {
+    if (!clients[client_idx].is_bot) {
+        save_score(clients[client_idx].pseudo, score);
+    }
+}
+
 static void get_leaderboard(LeaderboardData *lb) {
     FILE *f;
     LeaderboardSaveData data;
@@ -248,8 +286,8 @@ static void get_leaderboard(LeaderboardData *lb) {
 }
 
 static void send_to_client(int client_idx, Packet *pkt) {
-    if (client_idx >= 0 && client_idx < MAX_CLIENTS && clients[client_idx].active) {
-        send(clients[client_idx].socket, (const char *)pkt, sizeof(Packet), 0);
+    if (client_idx >= 0 && client_idx < MAX_CLIENTS && clients[client_idx].active && !clients[client_idx].is_bot) {
+        send(clients[client_idx].socket, (const char *)pkt, packet_wire_size(pkt), 0);
     }
 }
 
@@ -274,6 +312,8 @@ static void send_room_update(int room_idx) {
         pkt.lobby.player_count = room->count;
         pkt.lobby.game_started = room->game_running;
         pkt.lobby.timer_minutes = room->timer_minutes;
+        pkt.lobby.grid_size = room->grid_size;
+        pkt.lobby.ruleset = room->ruleset;
         pkt.lobby.game_mode = room->game_mode;
         pkt.lobby.is_public = room->is_public;
         pkt.lobby.spectator_count = room->spectator_count;
@@ -283,6 +323,7 @@ static void send_room_update(int room_idx) {
         for (j = 0; j < room->count; j++) {
             strcpy(pkt.lobby.players[j], clients[room->client_ids[j]].pseudo);
             pkt.lobby.is_spectator[j] = room->is_spectator[j];
+            pkt.lobby.is_bot[j] = clients[room->client_ids[j]].is_bot;
         }
         
         send_to_client(c, &pkt);
@@ -336,8 +377,8 @@ static void send_rush_update(int room_idx) {
         if (!room->is_spectator[i]) {
             RushPlayerState *state = &pkt.rush_states[pkt.rush_player_count];
             strcpy(state->pseudo, clients[room->client_ids[i]].pseudo);
-            memcpy(state->grid, room->rush_grids[i], sizeof(state->grid));
-            state->score = room->rush_scores[i];
+            packet_put_grid(&pkt, pkt.rush_player_count, room->rush_grids[i], room->grid_size);
+            state->score = room->scores[i];
             state->is_spectator = 0;
             pkt.rush_player_count++;
         }
@@ -355,8 +396,8 @@ static void send_rush_update(int room_idx) {
         int max_score = -1;
         int winner_idx = 0;
         for (i = 0; i < room->count; i++) {
-            if (!room->is_spectator[i] && room->rush_scores[i] > max_score) {
-                max_score = room->rush_scores[i];
+            if (!room->is_spectator[i] && room->scores[i] > max_score) {
+                max_score = room->scores[i];
                 winner_idx = i;
             }
         }
@@ -366,7 +407,7 @@ static void send_rush_update(int room_idx) {
         
         for (i = 0; i < room->count; i++) {
             if (!room->is_spectator[i]) {
-                save_score(clients[room->client_ids[i]].pseudo, room->rush_scores[i]);
+                save_client_score(room->client_ids[i], room->scores[i]);
             }
         }
         
@@ -377,6 +418,90 @@ static void send_rush_update(int room_idx) {
     }
 }
 
+/* Each seat gets the hands its client deals itself from the room seed, -1 marks a piece already played */
+static void deal_hand(PieceDealer *dealer, Cell grid[GRID_MAX][GRID_MAX], int size, int hand[3]) {
+    BitBoard bb;
+    
+    bb_from_grid(&bb, grid, size);
+    dealer_deal(dealer, &bb, hand);
+}
+
+static void start_dealing(Room *room) {
+    Cell empty[GRID_MAX][GRID_MAX];
+    int i;
+    
+    memset(empty, 0, sizeof(empty));
+    for (i = 0; i < 4; i++) {
+        dealer_init(&room->dealers[i], room->seed, DEAL_FAIR);
+        deal_hand(&room->dealers[i], empty, room->grid_size, room->hands[i]);
+    }
+}
+
+static int hand_slot(const int hand[3], int piece_id) {
+    int i;
+    
+    for (i = 0; i < 3; i++) {
+        if (hand[i] >= 0 && hand[i] == piece_id) return i;
+    }
+    return -1;
+}
+
+/* Replays the move on the server's copy of the seat's board and checks the client reached the same state
+ * with a piece it was dealt. The server's board stays authoritative when they disagree, and the seat
+ * scores what the server placed, whatever the client claims. A piece leaves the hand only once placed. */
+static int apply_client_move(Room *room, int seat, const Packet *pkt, int client_idx) {
+    int rush = room->game_mode == GAME_MODE_RUSH;
+    Cell (*grid)[GRID_MAX] = rush ? room->rush_grids[seat] : room->grid;
+    uint64_t *hash = rush ? &room->rush_hashes[seat] : &room->grid_hash;
+    int *hand = room->hands[seat];
+    Piece placed;
+    int slot = hand_slot(hand, pkt->piece_id);
+    int ok = 0;
+    
+    if (slot >= 0) {
+        int lines;
+        placed = piece_make(pkt->piece_id);
+        lines = rules_place(grid, room->grid_size, &placed, pkt->piece_row, pkt->piece_col, hash);
+        if (lines >= 0) {
+            BitBoard bb;
+            bb_from_grid(&bb, grid, room->grid_size);
+            room->scores[seat] += score_move(score_rules(room->ruleset), piece_info(&placed)->bb.cells, lines,
+                                             lines > 0 && bb_is_empty(&bb), &room->streaks[seat]);
+            ok = *hash == pkt->state_hash;
+            hand[slot] = -1;
+            if (hand[0] < 0 && hand[1] < 0 && hand[2] < 0) {
+                deal_hand(&room->dealers[seat], grid, room->grid_size, hand);
+            }
+        }
+    }
+    if (ok) return 1;
+    
+    printf("Desync from %s: piece %d%s at (%d, %d), hash %016llX, server %016llX\n",
+           clients[client_idx].pseudo, pkt->piece_id, slot >= 0 ? "" : " (not dealt)",
+           pkt->piece_row, pkt->piece_col,
+           (unsigned long long)pkt->state_hash, (unsigned long long)*hash);
+    return 0;
+}
+
+/* Puts the client back on the server's board, hand, dealer and score for its seat */
+static void send_correction(const Room *room, int seat, int client_idx) {
+    int rush = room->game_mode == GAME_MODE_RUSH;
+    Packet reply;
+    
+    memset(&reply, 0, sizeof(reply));
+    reply.type = MSG_UPDATE_GRID;
+    packet_put_grid(&reply, 0, rush ? room->rush_grids[seat] : room->grid, room->grid_size);
+    strcpy(reply.text, clients[client_idx].pseudo);
+    if (!rush) {
+        strcpy(reply.turn_pseudo, clients[room->client_ids[room->current_turn]].pseudo);
+    }
+    reply.piece_id = -1;
+    memcpy(reply.hand, room->hands[seat], sizeof(reply.hand));
+    reply.dealer = room->dealers[seat];
+    reply.score = room->scores[seat];
+    send_to_client(client_idx, &reply);
+}
+
 static void broadcast_to_room(int room_idx, Packet *pkt) {
     int i, c;
     Room *room;
@@ -393,6 +518,87 @@ static void broadcast_to_room(int room_idx, Packet *pkt) {
     }
 }
 
+static int add_bot(int room_idx, int level) {
+    const Room *room = &rooms[room_idx];
+    int i, j, n;
+    
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].active) break;
+    }
+    if (i == MAX_CLIENTS) return -1;
+    
+    memset(&clients[i], 0, sizeof(Client));
+    clients[i].socket = INVALID_SOCKET;
+    clients[i].active = 1;
+    clients[i].room_idx = room_idx;
+    clients[i].is_bot = 1;
+    bot_init(&clients[i].bot, level, generate_seed());
+    
+    /* Kicks go by pseudo, so two bots of the same level get numbered */
+    for (n = 1; ; n++) {
+        if (n == 1) {
+            snprintf(clients[i].pseudo, sizeof(clients[i].pseudo), "IA %s", bot_level(level)->name);
+        } else {
+            snprintf(clients[i].pseudo, sizeof(clients[i].pseudo), "IA %s %d", bot_level(level)->name, n);
+        }
+        for (j = 0; j < room->count; j++) {
+            if (strcmp(clients[room->client_ids[j]].pseudo, clients[i].pseudo) == 0) break;
+        }
+        if (j == room->count) break;
+    }
+    
+    return i;
+}
+
+static void release_bot(int client_idx) {
+    if (clients[client_idx].is_bot) {
+        bot_free(&clients[client_idx].bot);
+        clients[client_idx].active = 0;
+        clients[client_idx].is_bot = 0;
+        clients[client_idx].room_idx = -1;
+    }
+}
+
+static void release_room_bots(Room *room) {
+    int i;
+    
+    for (i = 0; i < room->count; i++) {
+        release_bot(room->client_ids[i]);
+    }
+}
+
+static int room_humans(const Room *room) {
+    int i, n = 0;
+    
+    for (i = 0; i < room->count; i++) {
+        if (!clients[room->client_ids[i]].is_bot) n++;
+    }
+    return n;
+}
+
+/* In classic the bot's move delay starts when its turn comes */
+static void bot_wait_turn(Room *room) {
+    Client *cl = &clients[room->client_ids[room->current_turn]];
+    
+    if (cl->is_bot) {
+        cl->bot_thinking = 0;
+        cl->bot_next_ms = bot_clock_ms() + (unsigned int)bot_level(cl->bot.level)->move_delay_ms;
+    }
+}
+
+static void start_bots(Room *room) {
+    int i;
+    
+    for (i = 0; i < room->count; i++) {
+        Client *cl = &clients[room->client_ids[i]];
+        if (!cl->is_bot) continue;
+        bot_free(&cl->bot);
+        bot_init(&cl->bot, cl->bot.level, room->seed ^ (uint32_t)(i + 1) * 0x9E3779B9u);
+        cl->bot_thinking = 0;
+        cl->bot_next_ms = bot_clock_ms() + (unsigned int)bot_level(cl->bot.level)->move_delay_ms;
+    }
+}
+
 static void remove_client_from_room(int client_idx) {
     int room_idx = clients[client_idx].room_idx;
     Room *room;
@@ -432,12 +638,19 @@ static void remove_client_from_room(int client_idx) {
     for (j = slot_idx; j < room->count - 1; j++) {
         room->client_ids[j] = room->client_ids[j + 1];
         room->is_spectator[j] = room->is_spectator[j + 1];
+        memcpy(room->rush_grids[j], room->rush_grids[j + 1], sizeof(room->rush_grids[j]));
+        room->rush_hashes[j] = room->rush_hashes[j + 1];
+        room->scores[j] = room->scores[j + 1];
+        room->streaks[j] = room->streaks[j + 1];
+        room->dealers[j] = room->dealers[j + 1];
+        memcpy(room->hands[j], room->hands[j + 1], sizeof(room->hands[j]));
     }
     room->count--;
     
     clients[client_idx].room_idx = -1;
     
-    if (room->count == 0) {
+    if (room_humans(room) == 0) {
+        release_room_bots(room);
         room->active = 0;
         printf("Room %s closed (empty)\n", room->code);
     } else if (client_idx == room->host_id) {
@@ -447,21 +660,20 @@ static void remove_client_from_room(int client_idx) {
             strcpy(pkt.text, "L'hote a quitte la partie!");
             broadcast_to_room(room_idx, &pkt);
             room->active = 0;
+            release_room_bots(room);
             
             for (i = 0; i < room->count; i++) {
                 clients[room->client_ids[i]].room_idx = -1;
             }
             printf("Room %s closed (host left during game)\n", room->code);
         } else {
+            room->host_id = -1;
             for (i = 0; i < room->count; i++) {
-                if (!room->is_spectator[i]) {
+                if (clients[room->client_ids[i]].is_bot) continue;
+                if (room->host_id < 0 || !room->is_spectator[i]) {
                     room->host_id = room->client_ids[i];
-                    break;
                 }
-            }
-            
-            if (i >= room->count) {
-                room->host_id = room->client_ids[0];
+                if (!room->is_spectator[i]) break;
             }
             send_room_update(room_idx);
             printf("Room %s: New host is %s\n", room->code, clients[room->host_id].pseudo);
@@ -476,6 +688,7 @@ static void remove_client_from_room(int client_idx) {
             strcpy(pkt.text, "Un joueur a quitte la partie!");
             broadcast_to_room(room_idx, &pkt);
             room->active = 0;
+            release_room_bots(room);
             
             for (i = 0; i < room->count; i++) {
                 clients[room->client_ids[i]].room_idx = -1;
@@ -535,6 +748,8 @@ static void process_packet(int client_idx, Packet *pkt) {
             room->count = 1;
             room->game_running = 0;
             room->current_turn = 0;
+            room->grid_size = GRID_DEFAULT;
+            room->ruleset = RULESET_CLASSIC;
             
             clients[client_idx].room_idx = room_idx;
             
@@ -603,6 +818,7 @@ static void process_packet(int client_idx, Packet *pkt) {
                     printf("%s kicked from room %s\n", clients[target_idx].pseudo, room->code);
                     
                     remove_client_from_room(target_idx);
+                    release_bot(target_idx);
                     break;
                 }
             }
@@ -628,21 +844,30 @@ static void process_packet(int client_idx, Packet *pkt) {
             }
             
             room->game_running = 1;
+            room->seed = generate_seed();
+            memset(room->scores, 0, sizeof(room->scores));
+            memset(room->streaks, 0, sizeof(room->streaks));
+            start_dealing(room);
+            start_bots(room);
             
             if (room->game_mode == GAME_MODE_RUSH) {
                 room->rush_start_time = time(NULL);
                 memset(room->rush_grids, 0, sizeof(room->rush_grids));
-                memset(room->rush_scores, 0, sizeof(room->rush_scores));
+                memset(room->rush_hashes, 0, sizeof(room->rush_hashes));
                 
                 memset(&reply, 0, sizeof(reply));
                 reply.type = MSG_START_GAME;
                 reply.game_mode = GAME_MODE_RUSH;
                 reply.time_remaining = room->rush_duration;
                 reply.timer_value = room->rush_duration;
+                reply.seed = room->seed;
+                reply.ruleset = room->ruleset;
+                reply.grid_size = room->grid_size;
                 
                 broadcast_to_room(room_idx, &reply);
                 
-                printf("Rush game started in room %s (duration: %d sec)\n", room->code, room->rush_duration);
+                printf("Rush game started in room %s (duration: %d sec, seed: %08X, scoring: %s)\n",
+                       room->code, room->rush_duration, room->seed, score_rules(room->ruleset)->name);
                 
                 send_rush_update(room_idx);
             } else {
@@ -653,16 +878,21 @@ static void process_packet(int client_idx, Packet *pkt) {
                 }
                 
                 memset(room->grid, 0, sizeof(room->grid));
+                room->grid_hash = 0;
+                bot_wait_turn(room);
                 
                 memset(&reply, 0, sizeof(reply));
                 reply.type = MSG_START_GAME;
                 reply.game_mode = GAME_MODE_CLASSIC;
-                memcpy(reply.grid_data, room->grid, sizeof(room->grid));
+                packet_put_grid(&reply, 0, room->grid, room->grid_size);
                 strcpy(reply.turn_pseudo, clients[room->client_ids[room->current_turn]].pseudo);
+                reply.seed = room->seed;
+                reply.ruleset = room->ruleset;
                 
                 broadcast_to_room(room_idx, &reply);
                 
-                printf("Classic game started in room %s\n", room->code);
+                printf("Classic game started in room %s (seed: %08X, scoring: %s)\n",
+                       room->code, room->seed, score_rules(room->ruleset)->name);
             }
             break;
         
@@ -684,28 +914,38 @@ static void process_packet(int client_idx, Packet *pkt) {
                 }
                 
                 if (player_idx >= 0) {
-                    memcpy(room->rush_grids[player_idx], pkt->grid_data, sizeof(room->rush_grids[0]));
-                    room->rush_scores[player_idx] = pkt->score;
-                    
+                    if (!apply_client_move(room, player_idx, pkt, client_idx)) {
+                        send_correction(room, player_idx, client_idx);
+                    }
                     send_rush_update(room_idx);
                 }
             } else {
-                if (room->client_ids[room->current_turn] != client_idx) break;
+                int seat = room->current_turn;
+                int ok;
                 
-                memcpy(room->grid, pkt->grid_data, sizeof(room->grid));
+                if (room->client_ids[seat] != client_idx) break;
                 
-                save_score(clients[client_idx].pseudo, pkt->score);
+                ok = apply_client_move(room, seat, pkt, client_idx);
+                
+                save_client_score(client_idx, room->scores[seat]);
                 
                 do {
                     room->current_turn = (room->current_turn + 1) % room->count;
                 } while (room->is_spectator[room->current_turn] && room->count > 1);
+                bot_wait_turn(room);
                 
                 memset(&reply, 0, sizeof(reply));
                 reply.type = MSG_UPDATE_GRID;
-                memcpy(reply.grid_data, room->grid, sizeof(room->grid));
+                packet_put_grid(&reply, 0, room->grid, room->grid_size);
                 strcpy(reply.turn_pseudo, clients[room->client_ids[room->current_turn]].pseudo);
+                strcpy(reply.text, clients[client_idx].pseudo);
+                reply.piece_id = pkt->piece_id;
+                reply.piece_row = pkt->piece_row;
+                reply.piece_col = pkt->piece_col;
                 
                 broadcast_to_room(room_idx, &reply);
+                
+                if (!ok) send_correction(room, seat, client_idx);
             }
             break;
         
@@ -758,9 +998,11 @@ static void process_packet(int client_idx, Packet *pkt) {
                 } else {
                     memset(&reply, 0, sizeof(reply));
                     reply.type = MSG_START_GAME;
-                    memcpy(reply.grid_data, room->grid, sizeof(room->grid));
+                    packet_put_grid(&reply, 0, room->grid, room->grid_size);
                     strcpy(reply.turn_pseudo, clients[room->client_ids[room->current_turn]].pseudo);
                     reply.game_mode = room->game_mode;
+                    reply.seed = room->seed;
+                    reply.ruleset = room->ruleset;
                     send_to_client(client_idx, &reply);
                 }
             }
@@ -809,6 +1051,64 @@ static void process_packet(int client_idx, Packet *pkt) {
             send_room_update(room_idx);
             break;
         
+        case MSG_SET_GRID_SIZE:
+            room_idx = clients[client_idx].room_idx;
+            if (room_idx < 0) break;
+            
+            room = &rooms[room_idx];
+            
+            if (client_idx != room->host_id) break;
+            if (room->game_running) break;
+            if (pkt->grid_size < GRID_MIN || pkt->grid_size > GRID_MAX) break;
+            
+            room->grid_size = pkt->grid_size;
+            
+            printf("Room %s grid set to: %dx%d\n", room->code, room->grid_size, room->grid_size);
+            send_room_update(room_idx);
+            break;
+        
+        case MSG_SET_RULESET:
+            room_idx = clients[client_idx].room_idx;
+            if (room_idx < 0) break;
+            
+            room = &rooms[room_idx];
+            
+            if (client_idx != room->host_id) break;
+            if (room->game_running) break;
+            if (pkt->ruleset < 0 || pkt->ruleset >= NUM_RULESETS) break;
+            
+            room->ruleset = pkt->ruleset;
+            
+            printf("Room %s scoring set to: %s\n", room->code, score_rules(room->ruleset)->name);
+            send_room_update(room_idx);
+            break;
+        
+        case MSG_ADD_BOT:
+            room_idx = clients[client_idx].room_idx;
+            if (room_idx < 0) break;
+            
+            room = &rooms[room_idx];
+            
+            if (client_idx != room->host_id) break;
+            if (room->game_running) break;
+            if (room->count >= 4) break;
+            
+            i = add_bot(room_idx, pkt->bot_level);
+            if (i < 0) {
+                memset(&reply, 0, sizeof(reply));
+                reply.type = MSG_ERROR;
+                strcpy(reply.text, "Serveur plein!");
+                send_to_client(client_idx, &reply);
+                break;
+            }
+            
+            room->client_ids[room->count] = i;
+            room->count++;
+            
+            printf("%s added to room %s\n", clients[i].pseudo, room->code);
+            send_room_update(room_idx);
+            break;
+        
         case MSG_GAME_OVER:
             room_idx = clients[client_idx].room_idx;
             if (room_idx < 0) break;
@@ -840,13 +1140,13 @@ static void process_packet(int client_idx, Packet *pkt) {
                 
                 if (winner_idx < 0) break;
                 
-                save_score(clients[client_idx].pseudo, pkt->score);
+                save_client_score(client_idx, room->scores[loser_idx]);
                 
                 memset(&reply, 0, sizeof(reply));
                 reply.type = MSG_GAME_END;
                 strcpy(reply.turn_pseudo, clients[room->client_ids[winner_idx]].pseudo);
                 strcpy(reply.text, clients[client_idx].pseudo);
-                reply.score = pkt->score;
+                reply.score = room->scores[loser_idx];
                 
                 broadcast_to_room(room_idx, &reply);
                 
@@ -864,6 +1164,86 @@ static void process_packet(int client_idx, Packet *pkt) {
     }
 }
 
+/* Plays the bot's move through the same path as a client packet, with the hash a client would send */
+static void bot_turn(int room_idx, int seat) {
+    Room *room = &rooms[room_idx];
+    int client_idx = room->client_ids[seat];
+    Client *cl = &clients[client_idx];
+    int rush = room->game_mode == GAME_MODE_RUSH;
+    Cell (*grid)[GRID_MAX] = rush ? room->rush_grids[seat] : room->grid;
+    int *hand = room->hands[seat];
+    SolverMove move;
+    Packet pkt;
+    
+    if (!cl->bot_thinking) {
+        BitBoard bb;
+        int available[3];
+        int i;
+        
+        bb_from_grid(&bb, grid, room->grid_size);
+        for (i = 0; i < 3; i++) {
+            available[i] = hand[i] >= 0;
+        }
+        bot_begin(&cl->bot, &bb, hand, available);
+        cl->bot_thinking = 1;
+    }
+    
+    if (!bot_think(&cl->bot, NULL, BOT_SLICE_MS, &move)) return;
+    
+    cl->bot_thinking = 0;
+    cl->bot_next_ms = bot_clock_ms() + (unsigned int)bot_level(cl->bot.level)->move_delay_ms;
+    memset(&pkt, 0, sizeof(pkt));
+    
+    if (move.piece_idx < 0) {
+        /* Out of moves: a classic game is lost, in Rush the bot waits for the clock */
+        if (!rush) {
+            pkt.type = MSG_GAME_OVER;
+            strcpy(pkt.text, cl->pseudo);
+            process_packet(client_idx, &pkt);
+        }
+        return;
+    }
+    
+    {
+        Cell next[GRID_MAX][GRID_MAX];
+        Piece placed = piece_make(hand[move.piece_idx]);
+        uint64_t hash = rush ? room->rush_hashes[seat] : room->grid_hash;
+        
+        memcpy(next, grid, sizeof(next));
+        rules_place(next, room->grid_size, &placed, move.row, move.col, &hash);
+        
+        pkt.type = MSG_PLACE_PIECE;
+        pkt.piece_id = placed.id;
+        pkt.piece_row = move.row;
+        pkt.piece_col = move.col;
+        pkt.state_hash = hash;
+        process_packet(client_idx, &pkt);
+    }
+}
+
+/* Returns 1 while a bot is seated in a running game, so the loop keeps ticking */
+static int run_bots(void) {
+    unsigned int now = bot_clock_ms();
+    int busy = 0;
+    int r, i;
+    
+    for (r = 0; r < MAX_ROOMS; r++) {
+        Room *room = &rooms[r];
+        
+        for (i = 0; i < room->count && room->active && room->game_running; i++) {
+            Client *cl = &clients[room->client_ids[i]];
+            
+            if (!cl->is_bot || room->is_spectator[i]) continue;
+            busy = 1;
+            if (room->game_mode != GAME_MODE_RUSH && i != room->current_turn) continue;
+            if ((int)(now - cl->bot_next_ms) < 0) continue;
+            bot_turn(r, i);
+        }
+    }
+    
+    return busy;
+}
+
 int main(int argc, char *argv[]) {
     SOCKET server_fd, new_socket;
     struct sockaddr_in address;
@@ -873,6 +1253,8 @@ int main(int argc, char *argv[]) {
     SOCKET max_sd;
     int i;
     int port = PORT;
+    int bots_busy = 0;
+    time_t last_rush_tick = 0;
     
     (void)argc;
     (void)argv;
@@ -962,12 +1344,14 @@ int main(int argc, char *argv[]) {
         struct timeval timeout;
         int activity;
         
+        bots_busy = run_bots();
+        
         FD_ZERO(&readfds);
         FD_SET(server_fd, &readfds);
         max_sd = server_fd;
         
         for (i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].active) {
+            if (clients[i].active && !clients[i].is_bot) {
                 FD_SET(clients[i].socket, &readfds);
                 if (clients[i].socket > max_sd) {
                     max_sd = clients[i].socket;
@@ -975,14 +1359,18 @@ int main(int argc, char *argv[]) {
             }
         }
         
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
+        timeout.tv_sec = bots_busy ? 0 : 1;
+        timeout.tv_usec = bots_busy ? BOT_TICK_MS * 1000 : 0;
         
         activity = select((int)(max_sd + 1), &readfds, NULL, NULL, &timeout);
         
-        for (i = 0; i < MAX_ROOMS; i++) {
-            if (rooms[i].active && rooms[i].game_running && rooms[i].game_mode == GAME_MODE_RUSH) {
-                send_rush_update(i);
+        /* Rush clocks tick once a second whatever wakes the loop */
+        if (time(NULL) != last_rush_tick) {
+            last_rush_tick = time(NULL);
+            for (i = 0; i < MAX_ROOMS; i++) {
+                if (rooms[i].active && rooms[i].game_running && rooms[i].game_mode == GAME_MODE_RUSH) {
+                    send_rush_update(i);
+                }
             }
         }
         
@@ -1004,6 +1392,7 @@ int main(int argc, char *argv[]) {
                         clients[i].active = 1;
                         clients[i].room_idx = -1;
                         clients[i].pseudo[0] = '\0';
+                        clients[i].rx.len = 0;
                         
                         printf("New client connected: %d\n", i);
                         break;
@@ -1018,9 +1407,16 @@ int main(int argc, char *argv[]) {
         }
         
         for (i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].active && FD_ISSET(clients[i].socket, &readfds)) {
-                Packet pkt;
-                int val = recv(clients[i].socket, (char *)&pkt, sizeof(Packet), 0);
+            if (clients[i].active && !clients[i].is_bot && FD_ISSET(clients[i].socket, &readfds)) {
+                PacketReader *rx = &clients[i].rx;
+                int need = packet_reader_need(rx);
+                int val = need > 0 ? recv(clients[i].socket, (char *)&rx->pkt + rx->len, need, 0) : -1;
+                
+                if (val > 0) {
+                    rx->len += val;
+                    need = packet_reader_need(rx);
+                    if (need < 0) val = -1;
+                }
                 
                 if (val <= 0) {
                     printf("Client %d disconnected (%s)\n", i, clients[i].pseudo);
@@ -1032,7 +1428,9 @@ int main(int argc, char *argv[]) {
                     closesocket(clients[i].socket);
                     clients[i].active = 0;
                     clients[i].socket = INVALID_SOCKET;
-                } else {
+                } else if (need == 0) {
+                    Packet pkt = rx->pkt;
+                    rx->len = 0;
                     process_packet(i, &pkt);
                 }
             }
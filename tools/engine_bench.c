@@ -0,0 +1,517 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "../client/game.h"
+#include "../common/rng.h"
+
+#define DEFAULT_BOARDS 1024
+#define DEFAULT_MIN_MS 200
+#define DEFAULT_SEED 0xB10CB1A5u
+#define MAX_BOARD_MOVES (3 * GRID_MAX * GRID_MAX)
+#define SOLVER_SAMPLE 64
+
+typedef struct {
+    int state_idx;
+    int piece_idx;
+    int row;
+    int col;
+} BenchMove;
+
+typedef struct {
+    BitBoard bb;
+    BBPiece pieces[3];
+} BenchBitBoard;
+
+typedef struct {
+    GameState *states;
+    BenchBitBoard *boards;
+    int count;
+    BenchMove *moves;
+    int move_count;
+    GameState scratch;
+    ThreadPool *threads;
+} BenchPool;
+
+typedef struct {
+    const char *name;
+    long long (*run)(BenchPool *pool);
+} BenchCase;
+
+typedef struct {
+    const char *name;
+    long long ops;
+    double total_ns;
+} BenchResult;
+
+static volatile long long bench_sink = 0;
+
+static double now_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static int collect_moves(GameState *gs, int state_idx, BenchMove *out) {
+    int i, r, c, n = 0;
+
+    for (i = 0; i < 3; i++) {
+        if (!gs->pieces_available[i]) continue;
+        for (r = 0; r < gs->grid_size; r++) {
+            for (c = 0; c < gs->grid_size; c++) {
+                if (can_place(gs, r, c, &gs->current_pieces[i])) {
+                    out[n].state_idx = state_idx;
+                    out[n].piece_idx = i;
+                    out[n].row = r;
+                    out[n].col = c;
+                    n++;
+                }
+            }
+        }
+    }
+
+    return n;
+}
+
+static void new_game(GameState *gs, unsigned int seed, int size) {
+    init_game_seeded(gs, seed);
+    if (size != gs->grid_size) {
+        game_set_size(gs, size);
+        game_sync_board(gs);
+    }
+}
+
+static void self_play_boards(BenchPool *pool, int wanted, unsigned int seed, int size) {
+    Rng policy;
+    BenchMove legal[MAX_BOARD_MOVES];
+    GameState *gs = &pool->scratch;
+    int game_idx = 0;
+
+    rng_seed(&policy, seed);
+    pool->count = 0;
+
+    while (pool->count < wanted) {
+        new_game(gs, seed + (unsigned int)game_idx++, size);
+
+        while (pool->count < wanted) {
+            int n, i, all_placed = 1;
+            BenchMove m;
+
+            pool->states[pool->count++] = *gs;
+
+            n = collect_moves(gs, 0, legal);
+            if (n == 0) break;
+
+            m = legal[rng_below(&policy, (unsigned int)n)];
+            place_piece_logic(gs, m.row, m.col, &gs->current_pieces[m.piece_idx]);
+            gs->pieces_available[m.piece_idx] = 0;
+            init_effects(&gs->effects);
+
+            for (i = 0; i < 3; i++) {
+                if (gs->pieces_available[i]) all_placed = 0;
+            }
+            if (all_placed) {
+                generate_pieces(gs);
+            }
+        }
+    }
+}
+
+static int load_boards(BenchPool *pool, const char *path, int wanted) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+
+    if (!f) {
+        fprintf(stderr, "Cannot open board file: %s\n", path);
+        return 0;
+    }
+
+    pool->count = 0;
+    while (pool->count < wanted && fgets(line, sizeof(line), f)) {
+        GameState *gs = &pool->states[pool->count];
+        unsigned int seed;
+        int r, c, n, ids[3], avail[3];
+        char cells[GRID_MAX * GRID_MAX + 1];
+
+        if (sscanf(line, "%u %d %d %d %d %d %d %256s", &seed, &ids[0], &ids[1], &ids[2],
+                   &avail[0], &avail[1], &avail[2], cells) != 8) {
+            continue;
+        }
+        /* The board size is implied by the cell count */
+        for (n = GRID_MIN; n <= GRID_MAX && n * n != (int)strlen(cells); n++) {
+        }
+        if (n > GRID_MAX) continue;
+
+        new_game(gs, seed, n);
+        for (r = 0; r < n; r++) {
+            for (c = 0; c < n; c++) {
+                gs->grid[r][c] = cells[r * n + c] == '1' ? CELL_BLUE : CELL_EMPTY;
+            }
+        }
+        for (r = 0; r < 3; r++) {
+            if (ids[r] < 0) continue;
+            set_piece_from_template(&gs->current_pieces[r], ids[r]);
+            gs->pieces_available[r] = avail[r];
+        }
+        game_sync_board(gs);
+        pool->count++;
+    }
+
+    fclose(f);
+    return pool->count > 0;
+}
+
+static int save_boards(BenchPool *pool, const char *path) {
+    FILE *f = fopen(path, "w");
+    int i, r, c;
+
+    if (!f) {
+        fprintf(stderr, "Cannot write board file: %s\n", path);
+        return 0;
+    }
+
+    for (i = 0; i < pool->count; i++) {
+        GameState *gs = &pool->states[i];
+        fprintf(f, "%u", gs->seed);
+        for (r = 0; r < 3; r++) {
+            fprintf(f, " %d", (int)gs->current_pieces[r].id);
+        }
+        for (r = 0; r < 3; r++) {
+            fprintf(f, " %d", gs->pieces_available[r]);
+        }
+        fputc(' ', f);
+        for (r = 0; r < gs->grid_size; r++) {
+            for (c = 0; c < gs->grid_size; c++) {
+                fputc(gs->grid[r][c] ? '1' : '0', f);
+            }
+        }
+        fputc('\n', f);
+    }
+
+    fclose(f);
+    return 1;
+}
+
+static long long bench_can_place(BenchPool *pool) {
+    long long ops = 0, hits = 0;
+    int i, p, r, c;
+
+    for (i = 0; i < pool->count; i++) {
+        GameState *gs = &pool->states[i];
+        for (p = 0; p < 3; p++) {
+            Piece *piece = &gs->current_pieces[p];
+            for (r = 0; r < gs->grid_size; r++) {
+                for (c = 0; c < gs->grid_size; c++) {
+                    hits += can_place(gs, r, c, piece);
+                    ops++;
+                }
+            }
+        }
+    }
+
+    bench_sink += hits;
+    return ops;
+}
+
+static long long bench_copy_state(BenchPool *pool) {
+    GameState *gs = &pool->scratch;
+    int i;
+
+    for (i = 0; i < pool->move_count; i++) {
+        BenchMove *m = &pool->moves[i];
+        memcpy(gs->grid, pool->states[m->state_idx].grid, sizeof(gs->grid));
+        init_effects(&gs->effects);
+        bench_sink += gs->grid[m->row][m->col];
+    }
+
+    return pool->move_count;
+}
+
+static long long bench_place_piece_logic(BenchPool *pool) {
+    GameState *gs = &pool->scratch;
+    int i;
+
+    for (i = 0; i < pool->move_count; i++) {
+        BenchMove *m = &pool->moves[i];
+        GameState *src = &pool->states[m->state_idx];
+        memcpy(gs->grid, src->grid, sizeof(gs->grid));
+        gs->grid_size = src->grid_size;
+        init_effects(&gs->effects);
+        place_piece_logic(gs, m->row, m->col, &src->current_pieces[m->piece_idx]);
+        bench_sink += gs->score;
+    }
+
+    return pool->move_count;
+}
+
+static long long bench_check_valid_moves_exist(BenchPool *pool) {
+    long long found = 0;
+    int i;
+
+    for (i = 0; i < pool->count; i++) {
+        found += check_valid_moves_exist(&pool->states[i]);
+    }
+
+    bench_sink += found;
+    return pool->count;
+}
+
+static long long bench_generate_pieces(BenchPool *pool) {
+    GameState *gs = &pool->scratch;
+    int i;
+
+    for (i = 0; i < pool->count; i++) {
+        generate_pieces(gs);
+        bench_sink += gs->current_pieces[0].id;
+    }
+
+    return pool->count;
+}
+
+static long long bench_bb_can_place(BenchPool *pool) {
+    long long ops = 0, hits = 0;
+    int i, p, r, c;
+
+    for (i = 0; i < pool->count; i++) {
+        BenchBitBoard *b = &pool->boards[i];
+        for (p = 0; p < 3; p++) {
+            for (r = 0; r < b->bb.size; r++) {
+                for (c = 0; c < b->bb.size; c++) {
+                    hits += bb_can_place(&b->bb, &b->pieces[p], r, c);
+                    ops++;
+                }
+            }
+        }
+    }
+
+    bench_sink += hits;
+    return ops;
+}
+
+static long long bench_bb_place(BenchPool *pool) {
+    int i;
+
+    for (i = 0; i < pool->move_count; i++) {
+        BenchMove *m = &pool->moves[i];
+        BenchBitBoard *b = &pool->boards[m->state_idx];
+        BitBoard bb = b->bb;
+        bench_sink += bb_place(&bb, &b->pieces[m->piece_idx], m->row, m->col, NULL, NULL);
+    }
+
+    return pool->move_count;
+}
+
+static long long bench_bb_move_map(BenchPool *pool) {
+    BBMoveMap map;
+    int i, p;
+
+    for (i = 0; i < pool->count; i++) {
+        BenchBitBoard *b = &pool->boards[i];
+        for (p = 0; p < 3; p++) {
+            bb_move_map(&b->bb, &b->pieces[p], &map);
+            bench_sink += map.count + map.clearing[0];
+        }
+    }
+
+    return (long long)pool->count * 3;
+}
+
+static long long run_solver(BenchPool *pool, ThreadPool *threads) {
+    SolverResult res;
+    int step = pool->count > SOLVER_SAMPLE ? pool->count / SOLVER_SAMPLE : 1;
+    long long ops = 0;
+    int i;
+
+    for (i = 0; i < pool->count && ops < SOLVER_SAMPLE; i += step) {
+        bench_sink += game_solve(&pool->states[i], threads, &res);
+        ops++;
+    }
+
+    return ops;
+}
+
+static long long bench_solver_solve(BenchPool *pool) {
+    return run_solver(pool, NULL);
+}
+
+static long long bench_solver_solve_mt(BenchPool *pool) {
+    return run_solver(pool, pool->threads);
+}
+
+static const BenchCase bench_cases[] = {
+    {"can_place", bench_can_place},
+    {"copy_state", bench_copy_state},
+    {"place_piece_logic", bench_place_piece_logic},
+    {"check_valid_moves_exist", bench_check_valid_moves_exist},
+    {"generate_pieces", bench_generate_pieces},
+    {"bb_can_place", bench_bb_can_place},
+    {"bb_place", bench_bb_place},
+    {"bb_move_map", bench_bb_move_map},
+    {"solver_solve", bench_solver_solve},
+    {"solver_solve_mt", bench_solver_solve_mt}
+};
+
+#define NUM_BENCH_CASES ((int)(sizeof(bench_cases) / sizeof(bench_cases[0])))
+
+static BenchResult run_case(const BenchCase *bc, BenchPool *pool, double min_ns) {
+    BenchResult res;
+    double start, elapsed;
+
+    res.name = bc->name;
+    res.ops = 0;
+
+    bc->run(pool);
+
+    start = now_ns();
+    do {
+        res.ops += bc->run(pool);
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ns);
+
+    res.total_ns = elapsed;
+    return res;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --boards N        number of board samples (default %d)\n", DEFAULT_BOARDS);
+    fprintf(stderr, "  --seed S          self-play seed (default %u)\n", DEFAULT_SEED);
+    fprintf(stderr, "  --size N          self-play board size, %d to %d (default %d)\n", GRID_MIN, GRID_MAX, GRID_DEFAULT);
+    fprintf(stderr, "  --min-ms MS       minimum run time per benchmark (default %d)\n", DEFAULT_MIN_MS);
+    fprintf(stderr, "  --filter TEXT     only run benchmarks whose name contains TEXT\n");
+    fprintf(stderr, "  --load FILE       read board samples from FILE instead of self-play\n");
+    fprintf(stderr, "  --save FILE       write the board samples used to FILE\n");
+    fprintf(stderr, "  --json            print JSON instead of CSV\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchPool pool;
+    BenchResult results[NUM_BENCH_CASES];
+    BenchMove legal[MAX_BOARD_MOVES];
+    int wanted = DEFAULT_BOARDS;
+    unsigned int seed = DEFAULT_SEED;
+    int size = GRID_DEFAULT;
+    int min_ms = DEFAULT_MIN_MS;
+    const char *filter = NULL;
+    const char *load_path = NULL;
+    const char *save_path = NULL;
+    int json = 0;
+    int i, n, result_count = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--boards") == 0 && i + 1 < argc) {
+            wanted = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+            if (size < GRID_MIN || size > GRID_MAX) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load_path = argv[++i];
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (wanted <= 0) wanted = DEFAULT_BOARDS;
+    if (min_ms <= 0) min_ms = DEFAULT_MIN_MS;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.states = (GameState *)malloc(sizeof(GameState) * (size_t)wanted);
+    pool.moves = (BenchMove *)malloc(sizeof(BenchMove) * (size_t)wanted * 4);
+    if (!pool.states || !pool.moves) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    if (load_path) {
+        if (!load_boards(&pool, load_path, wanted)) return 1;
+    } else {
+        self_play_boards(&pool, wanted, seed, size);
+    }
+
+    if (save_path && !save_boards(&pool, save_path)) return 1;
+
+    {
+        Rng pick;
+        rng_seed(&pick, seed ^ 0x5EEDu);
+        for (i = 0; i < pool.count; i++) {
+            int k;
+            n = collect_moves(&pool.states[i], i, legal);
+            for (k = 0; k < 4 && n > 0; k++) {
+                pool.moves[pool.move_count++] = legal[rng_below(&pick, (unsigned int)n)];
+            }
+        }
+    }
+
+    pool.boards = (BenchBitBoard *)malloc(sizeof(BenchBitBoard) * (size_t)pool.count);
+    if (!pool.boards) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    for (i = 0; i < pool.count; i++) {
+        game_to_bitboard(&pool.states[i], &pool.boards[i].bb, pool.boards[i].pieces);
+    }
+
+    new_game(&pool.scratch, seed, pool.states[0].grid_size);
+    pool.threads = thread_pool_create(0);
+
+    for (i = 0; i < NUM_BENCH_CASES; i++) {
+        if (filter && !strstr(bench_cases[i].name, filter)) continue;
+        results[result_count++] = run_case(&bench_cases[i], &pool, (double)min_ms * 1e6);
+    }
+
+    if (json) {
+        printf("{\"boards\":%d,\"moves\":%d,\"seed\":%u,\"results\":[", pool.count, pool.move_count, seed);
+        for (i = 0; i < result_count; i++) {
+            double ns_per_op = results[i].total_ns / (double)results[i].ops;
+            printf("%s{\"name\":\"%s\",\"ops\":%lld,\"ns_per_op\":%.3f,\"ops_per_sec\":%.0f}",
+                   i ? "," : "", results[i].name, results[i].ops, ns_per_op, 1e9 / ns_per_op);
+        }
+        printf("]}\n");
+    } else {
+        printf("benchmark,boards,ops,ns_per_op,ops_per_sec\n");
+        for (i = 0; i < result_count; i++) {
+            double ns_per_op = results[i].total_ns / (double)results[i].ops;
+            printf("%s,%d,%lld,%.3f,%.0f\n", results[i].name, pool.count, results[i].ops,
+                   ns_per_op, 1e9 / ns_per_op);
+        }
+    }
+
+    thread_pool_destroy(pool.threads);
+    free(pool.states);
+    free(pool.boards);
+    free(pool.moves);
+    return 0;
+}
@@ -0,0 +1,545 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "../client/game.h"
+#include "../common/rng.h"
+#include "../common/deal.h"
+#include "../common/bitboard.h"
+#include "../common/pieces.h"
+#include "../common/scoring.h"
+#include "../common/solver.h"
+#include "../common/bot.h"
+#include "../common/thread_pool.h"
+
+#define DEFAULT_GAMES 100000
+#define DEFAULT_SEED 0x5E1F9A7Eu
+#define DEFAULT_MAX_MOVES 4000
+#define MAX_CHUNKS 256
+#define SCORE_BIN_WIDTH 100
+#define SCORE_BINS 2000
+#define LENGTH_BINS 4000
+#define MAX_LINES_PER_MOVE 10
+#define MAX_HAND_MOVES (3 * GRID_MAX * GRID_MAX)
+
+typedef enum {
+    POLICY_RANDOM,
+    POLICY_GREEDY,
+    POLICY_SOLVER,
+    POLICY_BOT,
+    NUM_POLICIES
+} SimPolicy;
+
+static const char *policy_names[] = {"random", "greedy", "solver", "bot"};
+static const char *deal_names[] = {"uniform", "fair"};
+
+typedef struct {
+    long long dealt;
+    long long placed;
+    long long lines;
+    long long clearing_moves;
+    long long stuck;
+    long long stuck_alone;
+} TemplateStats;
+
+typedef struct {
+    long long games;
+    long long truncated;
+    long long placements;
+    long long lines;
+    long long board_clears;
+    long long hands;
+    long long redraws;
+    double score_sum;
+    double score_sq_sum;
+    int score_max;
+    int length_max;
+    long long score_hist[SCORE_BINS + 1];
+    long long length_hist[LENGTH_BINS + 1];
+    long long clear_hist[MAX_LINES_PER_MOVE + 1];
+    TemplateStats templates[NUM_PIECE_TEMPLATES];
+} SimStats;
+
+typedef struct {
+    SimPolicy policy;
+    int deal_mode;
+    int grid_size;
+    int ruleset;
+    int bot_level;
+    unsigned int seed;
+    long long games;
+    long long chunk_size;
+    int max_moves;
+    SimStats *chunks;
+} SimJob;
+
+typedef struct {
+    BitBoard bb;
+    int ids[3];
+    int available[3];
+    int score;
+    int streak;
+    int placed;
+    PieceDealer deal;
+    Rng policy;
+    SolverResult plan;
+    int plan_step;
+    Bot bot;
+} SimGame;
+
+typedef struct {
+    int piece_idx;
+    int row, col;
+    BBClear clear;
+} SimMove;
+
+static double now_sec(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* Same seed -> same piece sequence as init_game_seeded() in the client */
+static unsigned int game_seed(unsigned int base, long long index) {
+    uint32_t z = base ^ (uint32_t)(index * 0x9E3779B9u) ^ (uint32_t)((unsigned long long)index >> 32);
+    return rng_splitmix(&z);
+}
+
+static void deal_hand(SimGame *g, SimStats *st) {
+    int i;
+    st->hands++;
+    st->redraws += dealer_deal(&g->deal, &g->bb, g->ids);
+    for (i = 0; i < 3; i++) {
+        g->available[i] = 1;
+        st->templates[g->ids[i]].dealt++;
+    }
+    g->plan_step = -1;
+}
+
+/* Only the greedy policy needs the cleared lines, the random policy skips the move map */
+static int collect_moves(const SimGame *g, int with_clears, SimMove *out) {
+    BBClear none = {0, 0};
+    int i, r, n = 0;
+
+    for (i = 0; i < 3; i++) {
+        const BBPiece *p;
+        BBMoveMap map;
+        if (!g->available[i]) continue;
+        p = &piece_infos[g->ids[i]].bb;
+        if (with_clears) bb_move_map(&g->bb, p, &map);
+        for (r = 0; r + p->h <= g->bb.size; r++) {
+            uint16_t cols = with_clears ? map.legal[r] : bb_legal_cols(&g->bb, p, r);
+            while (cols) {
+                out[n].piece_idx = i;
+                out[n].row = r;
+                out[n].col = bb_lowest_bit(cols);
+                out[n].clear = with_clears ? bb_move_clear(&map, r, out[n].col) : none;
+                cols &= (uint16_t)(cols - 1);
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+static int choose_greedy(const SimGame *g, const SimMove *moves, int n) {
+    int best = 0, best_score = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        const BBPiece *p = &piece_infos[g->ids[moves[i].piece_idx]].bb;
+        BitBoard next = g->bb;
+        SolverOutcome outcome;
+        int score;
+
+        outcome.placed = 1;
+        outcome.lines = bb_apply(&next, p, moves[i].row, moves[i].col, &moves[i].clear);
+        outcome.cells = p->cells;
+        score = solver_weighted_heuristic(&next, &outcome, NULL);
+
+        if (i == 0 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    return best;
+}
+
+static int choose_move(SimPolicy policy, SimGame *g, SimMove *out) {
+    SimMove moves[MAX_HAND_MOVES];
+    int n;
+
+    if (policy == POLICY_BOT) {
+        SolverMove m;
+        bot_begin(&g->bot, &g->bb, g->ids, g->available);
+        while (!bot_think(&g->bot, NULL, 1000, &m)) {}
+        out->piece_idx = m.piece_idx;
+        out->row = m.row;
+        out->col = m.col;
+        return m.piece_idx >= 0;
+    }
+
+    if (policy == POLICY_SOLVER) {
+        if (g->plan_step < 0) {
+            BBPiece pieces[3];
+            int i;
+            for (i = 0; i < 3; i++) pieces[i] = piece_infos[g->ids[i]].bb;
+            solver_solve(&g->bb, pieces, g->available, NULL, NULL, &g->plan);
+            g->plan_step = 0;
+        }
+        if (g->plan_step < g->plan.count) {
+            const SolverMove *m = &g->plan.moves[g->plan_step++];
+            out->piece_idx = m->piece_idx;
+            out->row = m->row;
+            out->col = m->col;
+            return 1;
+        }
+        return 0;
+    }
+
+    n = collect_moves(g, policy == POLICY_GREEDY, moves);
+    if (n == 0) return 0;
+
+    if (policy == POLICY_GREEDY) {
+        *out = moves[choose_greedy(g, moves, n)];
+    } else {
+        *out = moves[rng_below(&g->policy, (unsigned int)n)];
+    }
+    return 1;
+}
+
+static void play_game(const SimJob *job, long long index, SimStats *st) {
+    const ScoreRules *rules = score_rules(job->ruleset);
+    SimGame g;
+    SimMove m;
+    int stuck_count = 0;
+    int i;
+
+    memset(&g, 0, sizeof(g));
+    bb_clear(&g.bb, job->grid_size);
+    dealer_init(&g.deal, game_seed(job->seed, index), job->deal_mode);
+    rng_seed(&g.policy, game_seed(job->seed ^ 0xA5A5A5A5u, index));
+    /* No time budget: every sample is searched, so results do not depend on the machine */
+    bot_init(&g.bot, job->bot_level, game_seed(job->seed ^ 0x5A5A5A5Au, index));
+    g.bot.budget_ms = 0;
+    deal_hand(&g, st);
+
+    while (g.placed < job->max_moves && choose_move(job->policy, &g, &m)) {
+        int id = g.ids[m.piece_idx];
+        TemplateStats *ts = &st->templates[id];
+        int lines = bb_place(&g.bb, &piece_infos[id].bb, m.row, m.col, NULL, NULL);
+        int board_clear = lines > 0 && bb_is_empty(&g.bb);
+
+        g.available[m.piece_idx] = 0;
+        g.placed++;
+        g.score += score_move(rules, piece_infos[id].bb.cells, lines, board_clear, &g.streak);
+        st->board_clears += board_clear;
+
+        ts->placed++;
+        ts->lines += lines;
+        if (lines > 0) ts->clearing_moves++;
+        st->clear_hist[lines > MAX_LINES_PER_MOVE ? MAX_LINES_PER_MOVE : lines]++;
+        st->lines += lines;
+
+        if (!g.available[0] && !g.available[1] && !g.available[2]) {
+            deal_hand(&g, st);
+        }
+    }
+
+    if (g.placed >= job->max_moves) {
+        st->truncated++;
+    } else {
+        for (i = 0; i < 3; i++) {
+            if (g.available[i]) stuck_count++;
+        }
+        for (i = 0; i < 3; i++) {
+            if (!g.available[i]) continue;
+            st->templates[g.ids[i]].stuck++;
+            if (stuck_count == 1) st->templates[g.ids[i]].stuck_alone++;
+        }
+    }
+
+    st->games++;
+    st->placements += g.placed;
+    st->score_sum += g.score;
+    st->score_sq_sum += (double)g.score * g.score;
+    if (g.score > st->score_max) st->score_max = g.score;
+    if (g.placed > st->length_max) st->length_max = g.placed;
+    st->score_hist[g.score / SCORE_BIN_WIDTH < SCORE_BINS ? g.score / SCORE_BIN_WIDTH : SCORE_BINS]++;
+    st->length_hist[g.placed < LENGTH_BINS ? g.placed : LENGTH_BINS]++;
+}
+
+static void run_chunk(void *ctx, int index) {
+    SimJob *job = (SimJob *)ctx;
+    SimStats *st = &job->chunks[index];
+    long long first = (long long)index * job->chunk_size;
+    long long last = first + job->chunk_size;
+    long long g;
+
+    if (last > job->games) last = job->games;
+
+    for (g = first; g < last; g++) {
+        play_game(job, g, st);
+    }
+}
+
+static void merge_stats(SimStats *dst, const SimStats *src) {
+    int i;
+
+    dst->games += src->games;
+    dst->truncated += src->truncated;
+    dst->placements += src->placements;
+    dst->lines += src->lines;
+    dst->board_clears += src->board_clears;
+    dst->hands += src->hands;
+    dst->redraws += src->redraws;
+    dst->score_sum += src->score_sum;
+    dst->score_sq_sum += src->score_sq_sum;
+    if (src->score_max > dst->score_max) dst->score_max = src->score_max;
+    if (src->length_max > dst->length_max) dst->length_max = src->length_max;
+
+    for (i = 0; i <= SCORE_BINS; i++) dst->score_hist[i] += src->score_hist[i];
+    for (i = 0; i <= LENGTH_BINS; i++) dst->length_hist[i] += src->length_hist[i];
+    for (i = 0; i <= MAX_LINES_PER_MOVE; i++) dst->clear_hist[i] += src->clear_hist[i];
+
+    for (i = 0; i < NUM_PIECE_TEMPLATES; i++) {
+        TemplateStats *d = &dst->templates[i];
+        const TemplateStats *s = &src->templates[i];
+        d->dealt += s->dealt;
+        d->placed += s->placed;
+        d->lines += s->lines;
+        d->clearing_moves += s->clearing_moves;
+        d->stuck += s->stuck;
+        d->stuck_alone += s->stuck_alone;
+    }
+}
+
+static int hist_percentile(const long long *hist, int bins, long long total, double q) {
+    long long target = (long long)ceil(q * (double)total);
+    long long seen = 0;
+    int i;
+
+    if (target < 1) target = 1;
+    for (i = 0; i <= bins; i++) {
+        seen += hist[i];
+        if (seen >= target) return i;
+    }
+    return bins;
+}
+
+static void print_report(const SimStats *st, const SimJob *job, int threads, double elapsed) {
+    double games = (double)st->games;
+    double mean_score = st->score_sum / games;
+    double var = st->score_sq_sum / games - mean_score * mean_score;
+    int i;
+
+    printf("policy=%s%s%s deal=%s size=%d scoring=%s games=%lld seed=%u threads=%d elapsed=%.2fs (%.0f games/s)\n",
+           policy_names[job->policy], job->policy == POLICY_BOT ? ":" : "",
+           job->policy == POLICY_BOT ? bot_level(job->bot_level)->name : "", deal_names[job->deal_mode], job->grid_size, score_rules(job->ruleset)->name,
+           st->games, job->seed, threads, elapsed, games / elapsed);
+    printf("truncated at %d moves: %lld\n", job->max_moves, st->truncated);
+    printf("\n");
+
+    printf("game length (placements): mean %.2f  p50 %d  p90 %d  p99 %d  max %d\n",
+           (double)st->placements / games,
+           hist_percentile(st->length_hist, LENGTH_BINS, st->games, 0.50),
+           hist_percentile(st->length_hist, LENGTH_BINS, st->games, 0.90),
+           hist_percentile(st->length_hist, LENGTH_BINS, st->games, 0.99),
+           st->length_max);
+    printf("score: mean %.1f  stddev %.1f  p50 %d  p90 %d  p99 %d  max %d  (percentiles to %d pts)\n",
+           mean_score, var > 0 ? sqrt(var) : 0.0,
+           hist_percentile(st->score_hist, SCORE_BINS, st->games, 0.50) * SCORE_BIN_WIDTH,
+           hist_percentile(st->score_hist, SCORE_BINS, st->games, 0.90) * SCORE_BIN_WIDTH,
+           hist_percentile(st->score_hist, SCORE_BINS, st->games, 0.99) * SCORE_BIN_WIDTH,
+           st->score_max, SCORE_BIN_WIDTH);
+    printf("lines per game: %.2f\n", (double)st->lines / games);
+    printf("board clears per game: %.4f\n", (double)st->board_clears / games);
+    if (job->deal_mode == DEAL_FAIR) {
+        printf("redraws per hand: %.4f\n", (double)st->redraws / (double)st->hands);
+    }
+
+    printf("lines per placement:");
+    for (i = 0; i <= MAX_LINES_PER_MOVE; i++) {
+        if (st->clear_hist[i] == 0) continue;
+        printf("  %d: %.3f%%", i, 100.0 * (double)st->clear_hist[i] / (double)st->placements);
+    }
+    printf("\n\n");
+
+    printf("template,cells,w,h,dealt,placed,lines_per_placement,clear_rate,stuck,stuck_alone,stuck_per_1000_games\n");
+    for (i = 0; i < NUM_PIECE_TEMPLATES; i++) {
+        const TemplateStats *t = &st->templates[i];
+        const BBPiece *p = &piece_infos[i].bb;
+        double placed = t->placed > 0 ? (double)t->placed : 1.0;
+        printf("%d,%d,%d,%d,%lld,%lld,%.4f,%.4f,%lld,%lld,%.2f\n",
+               i, p->cells, p->w, p->h, t->dealt, t->placed,
+               (double)t->lines / placed, (double)t->clearing_moves / placed,
+               t->stuck, t->stuck_alone, 1000.0 * (double)t->stuck / games);
+    }
+}
+
+static int same_name(const char *a, const char *b) {
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+/* Ruleset names are matched without case */
+static int find_ruleset(const char *arg) {
+    int r;
+
+    for (r = 0; r < NUM_RULESETS; r++) {
+        if (same_name(arg, score_rulesets[r].name)) return r;
+    }
+    return -1;
+}
+
+static int find_bot_level(const char *arg) {
+    int l;
+
+    for (l = 0; l < NUM_BOT_LEVELS; l++) {
+        if (same_name(arg, bot_levels[l].name)) return l;
+    }
+    return -1;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --games N         number of games (default %d)\n", DEFAULT_GAMES);
+    fprintf(stderr, "  --policy NAME     random, greedy, solver or bot (default random)\n");
+    fprintf(stderr, "  --bot NAME        bot level, facile, moyen, difficile or expert (default moyen)\n");
+    fprintf(stderr, "  --deal NAME       uniform or fair (default fair)\n");
+    fprintf(stderr, "  --size N          board size, %d to %d (default %d)\n", GRID_MIN, GRID_MAX, GRID_DEFAULT);
+    fprintf(stderr, "  --scoring NAME    scoring ruleset, classique, combo or serie (default classique)\n");
+    fprintf(stderr, "  --seed S          base seed (default %u)\n", DEFAULT_SEED);
+    fprintf(stderr, "  --threads N       worker threads, 0 = one per CPU (default 0)\n");
+    fprintf(stderr, "  --max-moves N     stop a game after N placements (default %d)\n", DEFAULT_MAX_MOVES);
+}
+
+int main(int argc, char *argv[]) {
+    SimJob job;
+    SimStats *total;
+    ThreadPool *pool;
+    int threads = 0;
+    int num_chunks;
+    double start, elapsed;
+    int i;
+
+    job.policy = POLICY_RANDOM;
+    job.deal_mode = DEAL_FAIR;
+    job.grid_size = GRID_DEFAULT;
+    job.ruleset = RULESET_CLASSIC;
+    job.bot_level = BOT_MEDIUM;
+    job.seed = DEFAULT_SEED;
+    job.games = DEFAULT_GAMES;
+    job.max_moves = DEFAULT_MAX_MOVES;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            job.games = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            int p;
+            for (p = 0; p < NUM_POLICIES; p++) {
+                if (strcmp(name, policy_names[p]) == 0) break;
+            }
+            if (p == NUM_POLICIES) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            job.policy = (SimPolicy)p;
+        } else if (strcmp(argv[i], "--deal") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, deal_names[DEAL_UNIFORM]) == 0) {
+                job.deal_mode = DEAL_UNIFORM;
+            } else if (strcmp(name, deal_names[DEAL_FAIR]) == 0) {
+                job.deal_mode = DEAL_FAIR;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            job.grid_size = atoi(argv[++i]);
+            if (job.grid_size < GRID_MIN || job.grid_size > GRID_MAX) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--scoring") == 0 && i + 1 < argc) {
+            job.ruleset = find_ruleset(argv[++i]);
+            if (job.ruleset < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc) {
+            job.bot_level = find_bot_level(argv[++i]);
+            if (job.bot_level < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            job.seed = (unsigned int)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-moves") == 0 && i + 1 < argc) {
+            job.max_moves = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (job.games <= 0) job.games = DEFAULT_GAMES;
+    if (job.max_moves <= 0) job.max_moves = DEFAULT_MAX_MOVES;
+
+    /* Chunking depends only on the game count, so results do not change with --threads */
+    num_chunks = job.games < MAX_CHUNKS ? (int)job.games : MAX_CHUNKS;
+    job.chunk_size = (job.games + num_chunks - 1) / num_chunks;
+    num_chunks = (int)((job.games + job.chunk_size - 1) / job.chunk_size);
+
+    job.chunks = (SimStats *)calloc((size_t)num_chunks, sizeof(SimStats));
+    total = (SimStats *)calloc(1, sizeof(SimStats));
+    pool = thread_pool_create(threads);
+    if (!job.chunks || !total || !pool) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+
+    start = now_sec();
+    thread_pool_run(pool, run_chunk, &job, num_chunks);
+    elapsed = now_sec() - start;
+
+    for (i = 0; i < num_chunks; i++) {
+        merge_stats(total, &job.chunks[i]);
+    }
+
+    print_report(total, &job, thread_pool_size(pool), elapsed);
+
+    thread_pool_destroy(pool);
+    free(job.chunks);
+    free(total);
+    return 0;
+}